@@ -359,7 +359,20 @@ void AppHostCX::pre_read() {
     _dum("AppHostCX::pre_read[%s]: === end",c_type());
 }
 
-bool AppHostCX::inside_detect_ranges() {
+bool AppHostCX::needs_payload() const {
+
+    switch (mode()) {
+        case mode_t::NONE:
+            return false;
+        case mode_t::CONTINUOUS:
+            return true;
+        default:
+            // leaving detection ranges could still switch us to continuous mode
+            return inside_detect_ranges() or config::opt_switch_to_continuous;
+    }
+}
+
+bool AppHostCX::inside_detect_ranges() const {
 
     auto bytes_total = meter_write_bytes + meter_read_bytes;
     bool inside_detect_range = bytes_total <= config::max_detect_bytes;
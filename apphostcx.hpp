@@ -71,12 +71,15 @@ public:
     // create pairs of results and pointers to (somewhere, already created) signatures.
     static int make_sig_states(std::shared_ptr<sensorType> sig_states, std::shared_ptr<sensorType> source_signatures);
     
+    // detection and continuous mode need to see the payload
+    bool needs_payload() const override;
+
     inline duplexFlow& flow() { return appflow_; }
     inline duplexFlow const& flow() const { return appflow_; }
 
 protected:
 
-    bool inside_detect_ranges();
+    bool inside_detect_ranges() const;
     bool inside_detect_on_continue();
 
     // detection mode is done in "post" phase
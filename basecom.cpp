@@ -23,6 +23,7 @@
 #include <vars.hpp>
 
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <linux/in6.h>
 #include <linux/netfilter_ipv4.h>
 #include <linux/netfilter_ipv6.h>
@@ -299,6 +300,22 @@ int baseCom::poll() {
 }
 
 
+void baseCom::shutdown_write(int _fd) {
+    if(_fd > 0 and ::shutdown(_fd, SHUT_WR) < 0) {
+        _dia("baseCom::shutdown_write[%d]: error: %s", _fd, string_error().c_str());
+    }
+}
+
+bool baseCom::idle_alive(int _fd) {
+    if(_fd <= 0) return false;
+
+    unsigned char b = 0;
+    auto r = ::recv(_fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    // nothing to read and not closed
+    return r < 0 and (errno == EAGAIN or errno == EWOULDBLOCK);
+}
+
 void baseCom::close(int _fd) {
     //really close the socket! Beware, from this point it can be reused!
     if(_fd > 0) {
@@ -364,6 +381,22 @@ int baseCom::so_quickack(int sock) const {
     return sso;
 }
 
+int baseCom::so_zerocopy(int sock) const {
+    constexpr int optval = 1;
+    int sso = setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval);
+    if(sso != 0) err_errno(string_format("baseCom::so_zerocopy: setsockopt[%d]", sock).c_str(),
+                           "SOL_SOCKET/SO_ZEROCOPY", sso);
+    return sso;
+}
+
+int baseCom::so_udp_gro(int sock) const {
+    constexpr int optval = 1;
+    int sso = setsockopt(sock, SOL_UDP, UDP_GRO, &optval, sizeof optval);
+    if(sso != 0) err_errno(string_format("baseCom::so_udp_gro: setsockopt[%d]", sock).c_str(),
+                           "SOL_UDP/UDP_GRO", sso);
+    return sso;
+}
+
 int baseCom::so_transparent_v4(int sock) const {
     constexpr int optval = 1;
     int sso = setsockopt(sock, SOL_IP, IP_TRANSPARENT, &optval, sizeof(optval));
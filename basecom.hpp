@@ -34,6 +34,7 @@
 #include <unistd.h>
 
 #include <epoll.hpp>
+#include <buffer.hpp>
 #include <log/logger.hpp>
 
 
@@ -171,8 +172,20 @@ public:
     virtual ssize_t read(int _fd, void* _buf, size_t _n, int _flags) = 0;
     virtual ssize_t peek(int _fd, void* _buf, size_t _n, int _flags) = 0;
     virtual ssize_t write(int _fd, const void* _buf, size_t _n, int _flags) = 0;
+
+    /// @brief zerocopy send support: return true if next write of 'len' bytes should use MSG_ZEROCOPY
+    virtual bool zerocopy_wanted(int _fd, std::size_t len) { return false; }
+    /// @brief take over buffer sent by last write, until kernel reports it doesn't need it anymore
+    virtual void zerocopy_pin(buffer&& sent) {}
+    /// @brief read completion notifications and release pinned buffers. Returns number of released buffers.
+    virtual std::size_t zerocopy_reap(int _fd) { return 0; }
+
     virtual void shutdown(int _fd) = 0;
     virtual void close(int _fd);
+    /// @brief half-close: nothing more will be written, reading is still possible
+    virtual void shutdown_write(int _fd);
+    /// @brief connection is alive and has nothing unread (ie. parked in CxPool)
+    virtual bool idle_alive(int _fd);
     virtual int bind(unsigned short _port) = 0;
     virtual int bind(const char* _path) = 0;
 
@@ -187,6 +200,8 @@ public:
     int so_broadcast(int sock) const;
     int so_nodelay(int sock) const;
     int so_quickack(int sock) const;
+    int so_zerocopy(int sock) const;
+    int so_udp_gro(int sock) const;
     int so_transparent_v4(int sock) const;
     int so_transparent_v6(int sock) const;
     int so_transparent(int sock) const;
@@ -248,6 +263,19 @@ public:
     // sometimes do writes on themselves and another read is necessary
     virtual bool readable(int s) { return true; };
     virtual bool writable(int s) { return true; };
+
+    // true if payload can be moved between sockets by kernel (splice), without passing this Com
+    virtual bool spliceable() const { return false; }
+    // socket's TLS records are decrypted by kernel (kTLS RX): non-data records refuse to be spliced from it
+    virtual bool ktls_rx() const { return false; }
+
+    // send out writes queued by this Com (batching coms), returns bytes sent
+    virtual ssize_t flush_writes() { return 0; }
+
+    // true if connect() is still waiting for hostname resolution and socket is not usable yet
+    virtual bool resolving() { return false; }
+    // socket is not ready to be monitored for writing (ie. it's a placeholder): EPOLLOUT is replaced by EPOLLIN
+    virtual bool write_monitor_deferred(int s) const { return false; }
     
     // check if socket is changed
     virtual bool in_readset(int s) { return master()->poller.in_read_set(s); };
@@ -294,6 +322,7 @@ public:
             master()->poller.del(s);
             master()->poller.cancel_rescan_in(s);
             master()->poller.cancel_rescan_out(s);
+            master()->poller.errqueue_unwatch(s);
         } 
     };    
     inline void set_write_monitor(int xs) {
@@ -306,7 +335,7 @@ public:
         }
 
         if (s > 0 ) { 
-            master()->poller.modify(s,EPOLLIN|EPOLLOUT); 
+            master()->poller.modify(s, write_monitor_deferred(xs) ? EPOLLIN : EPOLLIN|EPOLLOUT);
         } 
     }
     inline void set_write_monitor_only(int xs) {
@@ -319,7 +348,7 @@ public:
         }
 
         if (s > 0 ) { 
-            master()->poller.modify(s,EPOLLOUT); 
+            master()->poller.modify(s, write_monitor_deferred(xs) ? EPOLLIN : EPOLLOUT);
         } 
     }    
 
@@ -332,6 +361,10 @@ public:
             _deb("   virtual socket, translated to real %d", s);
         }
 
+        if(write_monitor_deferred(xs) and (new_mode & EPOLLOUT)) {
+            new_mode = (new_mode & ~EPOLLOUT) | EPOLLIN;
+        }
+
         if (s > 0 ) { 
             master()->poller.modify(s, new_mode);
         } 
@@ -16,6 +16,7 @@
     License along with this library.
 */
 
+#include <array>
 #include <vector>
 #include <string>
 #include <unistd.h>
@@ -149,10 +150,39 @@ void baseProxy::rdaadd(baseHostCX* cs) {
 }
 
 void baseProxy::drop_cx(baseHostCX* cx) {
+    forget_deferred_write(cx);
     cx->peer(nullptr);
     trashcan.emplace_back(cx);
 }
 
+baseHostCX* baseProxy::pool_acquire(const char* host, const char* port, std::string const& tag) {
+
+    if(not params_t::pool_enabled) return nullptr;
+
+    auto cx = CxPool::pool().acquire(host, port, tag);
+    if(cx) {
+        cx->com()->master(com()->master());
+    }
+    return cx.release();
+}
+
+bool baseProxy::pool_release(baseHostCX* cx) {
+
+    auto it = std::find(right_sockets.begin(), right_sockets.end(), cx);
+    if(it == right_sockets.end()) return false;
+    right_sockets.erase(it);
+    forget_deferred_write(cx);
+
+    auto ptr = std::unique_ptr<baseHostCX>(cx);
+    if(params_t::pool_enabled and CxPool::pool().release(ptr)) {
+        return true;
+    }
+
+    ptr->shutdown();
+    drop_cx(ptr.release());
+    return false;
+}
+
 void baseProxy::left_shutdown() {
 	auto lb = left_bind_sockets.size();
 	auto ls = left_sockets.size();
@@ -183,6 +213,14 @@ void baseProxy::left_shutdown() {
 
 
 void baseProxy::right_shutdown() {
+
+    if(params_t::pool_enabled) {
+        auto reusable = right_sockets;
+        for(auto* cx: reusable) {
+            if(cx->reusable()) pool_release(cx);
+        }
+    }
+
 	auto rb = right_bind_sockets.size();
 	auto rs = right_sockets.size();
 	auto rp = right_pc_cx.size();
@@ -258,8 +296,11 @@ bool baseProxy::run_timers () {
 
     if(clicker_.reset_timer()) {
 
+        if(params_t::pool_enabled) CxPool::pool().expire();
+
         auto cx_check = [&](auto* cx, bool idle_check=false) {
             on_cx_timer(cx);
+            cx->adjust_buffers();
             if(idle_check && cx->idle_timeout()) {
                 state().dead(true);
 
@@ -365,34 +406,22 @@ bool baseProxy::handle_cx_read(unsigned char side, baseHostCX* cx) {
     
     if (proceed) {
         _ext("%c in R fdset and readable: %d", side, cx->socket());
-        int red = cx->read();
+        int red = spliced() ? splice_read(side, cx) : cx->read();
         
         if (red == 0) {
-            cx->shutdown();
-            //left_sockets.erase(i);
-
-
-            if(side == 'l' || side == 'x') {
-                handle_last_status |= HANDLE_LEFT_ERROR;
-                state().error_on_left_read = true;
-            } else {
-                handle_last_status |= HANDLE_RIGHT_ERROR;
-                state().error_on_right_read = true;
-            }
-
-
-            if     (side == 'l') { on_left_error(cx); }
-            else if(side == 'r') { on_right_error(cx); }
-            else if(side == 'x')  { on_left_pc_error(cx); }
-            else if(side == 'y')  { on_right_pc_error(cx); }
-           
-            _deb("baseProxy::handle_cx_read[%c]: error processed", side);
-           
+            on_read_closed(side, cx);
             return false;
         }
         
         if (red > 0) {
             stats_.last_read += red;
+
+            if(spliced()) {
+                // nothing in readbuf, bytes are already on their way to the peer
+                _deb("baseProxy::handle_cx_read[%c]: %d bytes spliced", side, red);
+                return true;
+            }
+
             if     (side == 'l') { on_left_bytes(cx); }
             else if(side == 'r') { on_right_bytes(cx); }
             else if(side == 'x')  { on_left_bytes(cx); }
@@ -405,6 +434,26 @@ bool baseProxy::handle_cx_read(unsigned char side, baseHostCX* cx) {
     return true;
 }
 
+void baseProxy::on_read_closed(unsigned char side, baseHostCX* cx) {
+
+    cx->shutdown();
+
+    if(side == 'l' || side == 'x') {
+        handle_last_status |= HANDLE_LEFT_ERROR;
+        state().error_on_left_read = true;
+    } else {
+        handle_last_status |= HANDLE_RIGHT_ERROR;
+        state().error_on_right_read = true;
+    }
+
+    if     (side == 'l') { on_left_error(cx); }
+    else if(side == 'r') { on_right_error(cx); }
+    else if(side == 'x')  { on_left_pc_error(cx); }
+    else if(side == 'y')  { on_right_pc_error(cx); }
+
+    _deb("baseProxy::on_read_closed[%c]: error processed", side);
+}
+
 bool baseProxy::handle_cx_write(unsigned char side, baseHostCX* cx) {
     
     _ext("baseProxy::handle_cx_write[%c]: in write fdset: %d",side, cx->socket());
@@ -417,7 +466,7 @@ bool baseProxy::handle_cx_write(unsigned char side, baseHostCX* cx) {
     
     if (proceed) {
         _ext("baseProxy::handle_cx_write[%c]: writable: %d", side, cx->socket());
-        int wrt = cx->write();
+        int wrt = spliced() ? splice_write(side, cx) : cx->write();
         if (wrt < 0) {
             cx->shutdown();
             //left_sockets.erase(i);
@@ -442,13 +491,7 @@ bool baseProxy::handle_cx_write(unsigned char side, baseHostCX* cx) {
             stats_.last_write += wrt;
 
             if(wrt > 0 and stats_.do_rate_meter) {
-                if (stats_.do_rate_meter) {
-                    if (side == 'l' or side == 'x') {
-                        stats_.mtr_down.update(wrt);
-                    } else if (side == 'r' or side == 'y') {
-                        stats_.mtr_up.update(wrt);
-                    }
-                }
+                update_rate_meters(side, wrt);
                 _deb("baseProxy::handle_cx_write[%c]: %d bytes processed", side, wrt);
             }
         }
@@ -457,6 +500,200 @@ bool baseProxy::handle_cx_write(unsigned char side, baseHostCX* cx) {
     return true;
 }
 
+void baseProxy::update_rate_meters(unsigned char side, int bytes) {
+    if (stats_.do_rate_meter) {
+        if (side == 'l' or side == 'x') {
+            stats_.mtr_down.update(bytes);
+        } else if (side == 'r' or side == 'y') {
+            stats_.mtr_up.update(bytes);
+        }
+    }
+}
+
+bool baseProxy::splice_eligible() const {
+
+    // already active, or previous attempt failed
+    if(splice_ and not splice_->stopped) return false;
+
+    if(not splice_allowed()) return false;
+
+    // exactly one plain client socket on each side
+    if(left_sockets.size() != 1 or right_sockets.size() != 1) return false;
+    if(not left_pc_cx.empty() or not right_pc_cx.empty()) return false;
+    if(not left_delayed_accepts.empty() or not right_delayed_accepts.empty()) return false;
+
+    auto* l = left_sockets.front();
+    auto* r = right_sockets.front();
+
+    // let detection see the session start, the same threshold as for buffer swapping
+    if(l->meter_read_bytes + r->meter_read_bytes <= baseHostCX::params_t::fast_copy_start) return false;
+
+    auto cx_ok = [](baseHostCX const* cx) {
+        return cx->com() and cx->com()->spliceable() and cx->socket() > 0
+               and not cx->opening() and not cx->error() and not cx->io_disabled()
+               and not cx->close_after_write()
+               and cx->readbuf()->empty() and cx->writebuf()->empty()
+               and not cx->needs_payload();
+    };
+
+    return cx_ok(l) and cx_ok(r);
+}
+
+bool baseProxy::splice_start() {
+
+    // pipes were drained by splice_stop()
+    if(splice_ and splice_->stopped) {
+        splice_->stopped = false;
+        splice_->left_closed = false;
+        splice_->right_closed = false;
+        splice_->active = true;
+        _dia("baseProxy::splice_start: forwarding switched to splice again");
+
+        return true;
+    }
+
+    splice_ = std::make_unique<splice_state>();
+
+    if(not splice_->to_right.init() or not splice_->to_left.init()) {
+        _err("baseProxy::splice_start: cannot create pipes, session stays in userspace");
+        return false;
+    }
+
+    splice_->active = true;
+    _dia("baseProxy::splice_start: forwarding switched to splice");
+
+    return true;
+}
+
+void baseProxy::splice_stop() {
+
+    if(not spliced()) return;
+
+    // bytes already in pipes go to peers from their writebufs
+    auto drain = [](Splicer& splicer, baseHostCX* target) {
+        std::array<unsigned char, 16384> chunk {};
+
+        while(splicer.pending() > 0) {
+            auto r = splicer.drain(chunk.data(), chunk.size());
+            if(r <= 0) {
+                target->error(true);
+                return;
+            }
+            target->writebuf()->append(chunk.data(), static_cast<std::size_t>(r));
+        }
+
+        if(not target->writebuf()->empty()) {
+            target->com()->set_write_monitor(target->socket());
+        }
+    };
+
+    auto* l = left_sockets.front();
+    auto* r = right_sockets.front();
+
+    drain(splice_->to_right, r);
+    drain(splice_->to_left, l);
+
+    // pipes are kept: once SSL_read consumed the control record and buffers are empty, session is eligible again
+    splice_->active = false;
+    splice_->stopped = true;
+
+    for(auto* cx: { l, r }) {
+        if(cx->socket() > 0 and not cx->error()) cx->com()->set_monitor(cx->socket());
+    }
+
+    _dia("baseProxy::splice_stop: forwarding switched back to userspace");
+}
+
+int baseProxy::splice_read(unsigned char side, baseHostCX* cx) {
+
+    bool from_left = (side == 'l' or side == 'x');
+    auto& splicer = from_left ? splice_->to_right : splice_->to_left;
+    auto* target = from_left ? right_sockets.front() : left_sockets.front();
+    unsigned char target_side = from_left ? 'r' : 'l';
+
+    // -1: nothing to read, or pipe is full and target is not draining it
+    auto pulled = splicer.pull(cx->socket(), cx->com()->ktls_rx());
+
+    if(pulled == -3) {
+        splice_stop();
+        return cx->read();
+    }
+
+    if(pulled > 0) {
+        cx->on_splice_read(static_cast<std::size_t>(pulled));
+    }
+
+    auto pushed = splicer.push(target->socket());
+    if(pushed < 0) {
+        target->error(true);
+    }
+    else if(pushed > 0) {
+        target->on_splice_write(static_cast<std::size_t>(pushed));
+        stats_.last_write += static_cast<int>(pushed);
+        update_rate_meters(target_side, static_cast<int>(pushed));
+    }
+
+    if(splicer.pending() > 0 and not target->error()) {
+        // target is full: stop reading until it drains the pipe
+        _dia("baseProxy::splice_read[%c]: %d bytes pending, pausing read", side, splicer.pending());
+        cx->com()->unset_monitor(cx->socket());
+        target->com()->set_write_monitor(target->socket());
+
+        if(pulled == 0 or pulled < -1) {
+            // source is done: deliver the rest first, splice_write() closes the session then
+            _dia("baseProxy::splice_read[%c]: source closed, flushing pipe first", side);
+            (from_left ? splice_->left_closed : splice_->right_closed) = true;
+            return -1;
+        }
+    }
+
+    if(pulled == -1) return -1;
+
+    // eof or error with nothing left to deliver
+    if(pulled < -1) cx->error(true);
+    if(pulled <= 0) return 0;
+
+    return static_cast<int>(pulled);
+}
+
+int baseProxy::splice_write(unsigned char side, baseHostCX* cx) {
+
+    bool to_left = (side == 'l' or side == 'x');
+    auto& splicer = to_left ? splice_->to_left : splice_->to_right;
+    auto* source = to_left ? right_sockets.front() : left_sockets.front();
+    auto& source_closed = to_left ? splice_->right_closed : splice_->left_closed;
+
+    if(splicer.pending() == 0) {
+        // something could have been still queued in userspace (ie. by the proxy itself)
+        if(not cx->writebuf()->empty()) return cx->write();
+
+        return 0;
+    }
+
+    auto pushed = splicer.push(cx->socket());
+    if(pushed < 0) return -1;
+
+    if(pushed > 0) {
+        cx->on_splice_write(static_cast<std::size_t>(pushed));
+    }
+
+    if(splicer.pending() > 0) {
+        cx->com()->set_write_monitor(cx->socket());
+    } else if(source_closed) {
+        // everything is delivered: pass the close on
+        _dia("baseProxy::splice_write[%c]: pipe drained, closing", side);
+        source_closed = false;
+        cx->com()->shutdown_write(cx->socket());
+        cx->com()->set_monitor(cx->socket());
+        on_read_closed(to_left ? 'r' : 'l', source);
+    } else if(source->socket() > 0) {
+        _dia("baseProxy::splice_write[%c]: pipe drained, resuming read", side);
+        source->com()->set_monitor(source->socket());
+    }
+
+    return static_cast<int>(pushed);
+}
+
 bool baseProxy::handle_cx_read_once(unsigned char side, baseCom* xcom, baseHostCX* cx) {
 
     bool ret = true;
@@ -603,6 +840,15 @@ unsigned int baseProxy::change_side_monitoring(unsigned char side, bool ifread,
 
 bool baseProxy::handle_cx_write_once(unsigned char side, baseCom* xcom, baseHostCX* cx) {
 
+    // let the rest of this iteration add to writebuf, data are sent by flush_deferred_writes()
+    if(baseHostCX::params_t::write_coalesce and not flushing_writes_) {
+        auto queued = std::any_of(deferred_writes_.begin(), deferred_writes_.end(),
+                                  [cx](auto const& d) { return d.cx == cx; });
+        if(not queued) deferred_writes_.push_back({ side, xcom, cx });
+
+        return true;
+    }
+
     if(cx->socket() == 0) {
         _dia("baseProxy::handle_cx_write_once[%c]: monitored socket changed to zero - terminating.",side);
         cx->error(true);
@@ -685,6 +931,42 @@ bool baseProxy::handle_cx_write_once(unsigned char side, baseCom* xcom, baseHost
 }
 
 
+void baseProxy::flush_deferred_writes() {
+
+    if(deferred_writes_.empty()) return;
+
+    auto pending = std::move(deferred_writes_);
+    deferred_writes_.clear();
+
+    flushing_writes_ = true;
+    for(auto const& d: pending) {
+
+        _ext("baseProxy::flush_deferred_writes[%c]: writing socket %d", d.side, d.cx->socket());
+
+        // same as in write loops: error handling could have changed sockets, stop here
+        if(not handle_cx_write_once(d.side, d.xcom, d.cx)) {
+            if(d.side == 'x') {
+                handle_last_status |= HANDLE_LEFT_PC_ERROR;
+                state().error_on_left_write = true;
+                on_left_pc_error(d.cx);
+            }
+            else if(d.side == 'y') {
+                handle_last_status |= HANDLE_RIGHT_PC_ERROR;
+                state().error_on_right_write = true;
+                on_right_pc_error(d.cx);
+            }
+            break;
+        }
+    }
+    flushing_writes_ = false;
+}
+
+void baseProxy::forget_deferred_write(baseHostCX const* cx) {
+    deferred_writes_.erase(std::remove_if(deferred_writes_.begin(), deferred_writes_.end(),
+                                          [cx](auto const& d) { return d.cx == cx; }), deferred_writes_.end());
+}
+
+
 bool baseProxy::handle_sockets_accept(unsigned char side, baseCom* xcom, baseHostCX* thiscx) {
     
     sockaddr_storage clientInfo{};
@@ -735,6 +1017,9 @@ int baseProxy::handle_sockets_once(baseCom* xcom) {
     state().error_on_right_read = false;
     state().error_on_right_write = false;
 
+    if(not spliced() and splice_eligible()) {
+        splice_start();
+    }
 
     if ( xcom->poll_result >= 0) {
 
@@ -876,6 +1161,18 @@ int baseProxy::handle_sockets_once(baseCom* xcom) {
             }
         }
         
+        // writes coalesced during this iteration are sent now, once per socket
+        flush_deferred_writes();
+
+        // datagrams queued by batching coms during this iteration
+        if(UDPCom::config_t::tx_batch) {
+            for(auto const& cx_vec: { &left_sockets, &right_sockets, &left_pc_cx, &right_pc_cx }) {
+                for(auto* cx: *cx_vec) {
+                    cx->com()->flush_writes();
+                }
+            }
+        }
+
 		// no socket is really ready to be processed; while it make sense to check 'connecting' sockets, it makes
 		// no sense to loop through bound sockets.
 		
@@ -1081,7 +1378,7 @@ auto baseProxy::run_poll_socket_null_handler(int cur_socket, epoll::set_type& re
 
             // sometimes UDPCom leaves in_virt_set with orphaned virtual socket - make cleanup
             auto udpc = UDPCom::datagram_com_static();
-            auto lc_ = std::scoped_lock(udpc->lock, udpc->in_virt_set.get_lock());
+            auto lc_ = std::scoped_lock(udpc->in_virt_set.get_lock());
             udpc->in_virt_set.erase(cur_socket);
 
         }else {
@@ -1184,7 +1481,7 @@ int baseProxy::run_poll() {
     if(is_udp) {
         {
             auto udpc = UDPCom::datagram_com_static();
-            auto lc_ = std::scoped_lock(udpc->lock, udpc->in_virt_set.get_lock());
+            auto lc_ = std::scoped_lock(udpc->in_virt_set.get_lock());
 
             sets[socket_set_type::VIRTSET] = &udpc->in_virt_set;
         }
@@ -1408,7 +1705,7 @@ std::string baseProxy::to_string(int verbosity) const {
 
 	if(verbosity > DIA) {
         ret_ss << "\n";
-        ret_ss << string_format("    parent id: 0x%x, poll_root: %d", parent(), pollroot());
+        ret_ss << string_format("    parent id: 0x%x, poll_root: %d, spliced: %d", parent(), pollroot(), spliced());
     }
 	
 	return ret_ss.str();
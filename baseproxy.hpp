@@ -32,6 +32,8 @@
 #include <hostcx.hpp>
 #include <mpstd.hpp>
 #include <sobject.hpp>
+#include <splicer.hpp>
+#include <cxpool.hpp>
 
 /*
 TCPProxy: proxy left<->right socket bytes
@@ -199,11 +201,44 @@ protected:
     };
     metering stats_;
 
+    // kernel forwarding of both directions, created once session is eligible
+    struct splice_state {
+        bool active = false;
+        bool stopped = false;   // switched back to userspace by splice_stop(), can be started again
+        Splicer to_right;   // left socket -> right socket
+        Splicer to_left;    // right socket -> left socket
+
+        // source is closed, but its pipe still holds bytes for the target
+        bool left_closed = false;
+        bool right_closed = false;
+    };
+    std::unique_ptr<splice_state> splice_;
+
+    // write coalescing: sockets to be written once, after all reads of this loop iteration
+    struct deferred_write {
+        unsigned char side;
+        baseCom* xcom;
+        baseHostCX* cx;
+    };
+    vector_type<deferred_write> deferred_writes_;
+    bool flushing_writes_ = false;
+    void flush_deferred_writes();
+    // cx leaving this proxy must not be written by the flush
+    void forget_deferred_write(baseHostCX const* cx);
+
     unsigned int handle_last_status = 0;
         
     bool pollroot_ = false;    
 
 public:
+    struct params_t {
+        // forward plain TCP sessions by kernel once nothing needs to see their payload
+        static inline std::atomic_bool splice_enabled = false;
+        // park reusable upstream connections in per-worker CxPool on shutdown
+        static inline std::atomic_bool pool_enabled = false;
+    };
+    static inline params_t params {};
+
     metering const& stats() const { return stats_; }
     proxy_state& state() { return status_; }
 
@@ -277,6 +312,12 @@ public:
 
 
     void drop_cx(baseHostCX* cx);
+
+    // upstream connection pool: take already connected cx (to be radd()-ed), or nullptr
+    baseHostCX* pool_acquire(const char* host, const char* port, std::string const& tag = {});
+    // remove cx from right side and park it in pool. If pool refuses, cx is shut down and dropped.
+    bool pool_release(baseHostCX* cx);
+
     // shutdown utils, deletes HostCX
     virtual void left_shutdown();
     virtual void right_shutdown();
@@ -344,6 +385,14 @@ public:
     virtual bool run_timers ();
 
 
+    // override to return false if payload is needed by the proxy itself (ie. traffic is logged)
+    virtual bool splice_allowed() const { return params_t::splice_enabled; }
+    bool splice_eligible() const;
+    bool splice_start();
+    // return to userspace forwarding until session is eligible again, ie. kTLS control record arrived
+    void splice_stop();
+    [[nodiscard]] inline bool spliced() const { return splice_ and splice_->active; }
+
     unsigned int change_monitor_for_cx_vec(std::vector<baseHostCX*>* cx_vec, bool ifread, bool ifwrite,int pause_read, int pause_write);
     unsigned int change_side_monitoring(unsigned char side, bool ifread, bool ifwrite, int pause_read, int pause_write);
 
@@ -365,6 +414,12 @@ protected:
 
     bool on_cx_timer(baseHostCX*);
 
+    void update_rate_meters(unsigned char side, int bytes);
+    // peer closed (or read failed): shut cx down and run error handlers
+    void on_read_closed(unsigned char side, baseHostCX* cx);
+    int splice_read(unsigned char side, baseHostCX* cx);
+    int splice_write(unsigned char side, baseHostCX* cx);
+
 public:
     // implement advanced logging
     TYPENAME_BASE("baseProxy")
@@ -398,6 +398,26 @@ bool buffer::capacity (size_type c)
     return true;
 }
 
+bool buffer::shrink (size_type c)
+{
+    // not owning memory, nothing to gain, or data won't fit
+    if (not free_ or capacity_ <= c or size_ > c)
+        return false;
+
+    buffer smaller(c);
+
+    // pool may round up to the same size class
+    if(smaller.capacity() >= capacity_)
+        return false;
+
+    if (size_ != 0)
+        std::memcpy (smaller.data_, data_, size_);
+    smaller.size_ = size_;
+
+    swap(smaller);
+    return true;
+}
+
 bool buffer::empty () const
 {
     return size_ == 0;
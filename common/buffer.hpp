@@ -141,6 +141,7 @@ public:
 
   bool size (size_type);
   bool capacity (size_type);
+  bool shrink (size_type);   // reallocate to smaller capacity, if data fits
   void clear ();
 
   unsigned char* data ();
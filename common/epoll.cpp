@@ -47,6 +47,16 @@ int epoll::process_epoll_events(int nfds) {
         int socket = events[i].data.fd;
         uint32_t eventset = events[i].events;
 
+        if(eventset & EPOLLERR and errqueue_set.find(socket)) {
+            _dia("epoll::wait: error queue event for socket %d", socket);
+
+            // read event will pick up also real socket errors
+            eventset &= ~static_cast<uint32_t>(EPOLLERR);
+            if(not (eventset & (EPOLLIN | EPOLLOUT | EPOLLHUP))) {
+                eventset |= EPOLLIN;
+            }
+        }
+
         if(eventset & EPOLLIN) {
             if (socket == hint_socket()) {
                 _dia("epoll::wait: hint triggered %d", socket);
@@ -436,6 +446,14 @@ bool epoll::click_timer_now () {
     return false;
 }
 
+void epoll::errqueue_watch(int check) {
+    errqueue_set.insert(check);
+}
+
+void epoll::errqueue_unwatch(int check) {
+    errqueue_set.erase(check);
+}
+
 void epoll::set_idle_watch(int check){
     idle_watched_pre.insert(check);
 }
@@ -652,6 +670,22 @@ void epoller::clear_idle_watch(int check){
     }
 }
 
+void epoller::errqueue_watch(int check) {
+    init_if_null();
+
+    if(poller) {
+        poller->errqueue_watch(check);
+    }
+}
+
+void epoller::errqueue_unwatch(int check) {
+    init_if_null();
+
+    if(poller) {
+        poller->errqueue_unwatch(check);
+    }
+}
+
 epoll_handler* epoller::get_handler(int check) {
 
     auto lc_ = std::shared_lock(lock_);
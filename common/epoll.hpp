@@ -139,6 +139,12 @@ struct epoll {
     bool in_read_set(int check);
     bool in_write_set(int check);
 
+    // sockets expecting MSG_ERRQUEUE notifications (ie. zerocopy completions). EPOLLERR on them is not fatal,
+    // it's translated to read event, so handler gets a chance to read the error queue.
+    set_type errqueue_set;
+    void errqueue_watch(int check);
+    void errqueue_unwatch(int check);
+
 
     // idle timeout
     int idle_timeout_ms = 1000;
@@ -271,6 +277,9 @@ struct epoller {
     void set_idle_watch(int check);
     void clear_idle_watch(int check);
 
+    void errqueue_watch(int check);
+    void errqueue_unwatch(int check);
+
     ~epoller();
 
     logan_lite log = logan_lite("com.epoll");
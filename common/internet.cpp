@@ -1,35 +1,55 @@
+#include <fcntl.h>
+#include <poll.h>
+
 #include <internet.hpp>
 #include <log/logger.hpp>
 #include <epoll.hpp>
+#include <resolver.hpp>
 
 namespace inet {
 
     std::vector<std::string> dns_lookup (const std::string &host_name, int ipv)
     {
-        std::vector<std::string> output;
-
         auto const& log = Factory::log();
 
-        addrinfo hints{};
-        addrinfo* res = nullptr;
+        auto& cache = DnsCache::get();
+        if(auto cached = cache.lookup(host_name, ipv); cached.has_value()) {
+            _deb("inet::dns_lookup: %s ipv: %d cached %d addresses", host_name.c_str(), ipv, cached->size());
+            return cached.value();
+        }
 
-        int status, ai_family;
-        char ip_address[INET6_ADDRSTRLEN];
+        addrinfo hints = DnsCache::hints(ipv);
+        addrinfo* res = nullptr;
 
-        ai_family = ipv == 6 ? AF_INET6 : AF_INET; //v4 vs v6?
-        ai_family = ipv == 0 ? AF_UNSPEC : ai_family; // AF_UNSPEC (any), or chosen
-        memset(&hints, 0, sizeof hints);
-        hints.ai_family = ai_family;
-        hints.ai_socktype = SOCK_STREAM;
+        int status;
 
         if ((status = getaddrinfo(host_name.c_str(), nullptr, &hints, &res)) != 0) {
             _err("inet::dns_lookup: getaddrinfo: %s", gai_strerror(status));
-            return output;
+
+            // negative caching only when name doesn't exist, not on temporary errors
+            if(status == EAI_NONAME or status == EAI_NODATA) {
+                cache.store(host_name, ipv, {});
+            }
+            return {};
         }
 
         _deb("inet::dns_lookup: %s ipv: %d", host_name.c_str(), ipv);
 
-        for (auto* p = res; p != nullptr; p = p->ai_next) {
+        auto output = to_ip_strings(res);
+        freeaddrinfo(res); // free the linked list
+
+        cache.store(host_name, ipv, output);
+        return output;
+    }
+
+    std::vector<std::string> to_ip_strings(addrinfo const* res) {
+
+        auto const& log = Factory::log();
+
+        std::vector<std::string> output;
+        char ip_address[INET6_ADDRSTRLEN];
+
+        for (auto const* p = res; p != nullptr; p = p->ai_next) {
             void *addr;
             if (p->ai_family == AF_INET) { // IPv4
                 auto* ipv4 = reinterpret_cast<sockaddr_in*>(p->ai_addr);
@@ -46,8 +66,6 @@ namespace inet {
             output.emplace_back(ip_address);
         }
 
-        freeaddrinfo(res); // free the linked list
-
         return output;
     }
 
@@ -61,7 +79,51 @@ namespace inet {
         return inet_pton(AF_INET, str.c_str(), &(sa.sin_addr)) != 0;
     }
 
-    int socket_connect (std::string const& ip_address, unsigned short port) {
+    bool cancelled(int cancel_fd) {
+        if(cancel_fd < 0) return false;
+
+        pollfd p { cancel_fd, POLLIN, 0 };
+        return ::poll(&p, 1, 0) > 0;
+    }
+
+    // connect(), which doesn't block longer than timeout (seconds) and gives up once cancel_fd is readable.
+    // Plain blocking connect if neither is set. Sets errno on failure.
+    static int bounded_connect(int sd, sockaddr const* sa, socklen_t len, int timeout, int cancel_fd) {
+
+        if(timeout <= 0 and cancel_fd < 0) return ::connect(sd, sa, len);
+
+        auto const flags = ::fcntl(sd, F_GETFL);
+        ::fcntl(sd, F_SETFL, flags | O_NONBLOCK);
+
+        int ret = ::connect(sd, sa, len);
+        if(ret != 0 and errno == EINPROGRESS) {
+            pollfd p[2] = { { sd, POLLOUT, 0 }, { cancel_fd, POLLIN, 0 } };
+            int const nfds = cancel_fd >= 0 ? 2 : 1;
+
+            int r = 0;
+            while((r = ::poll(p, nfds, timeout > 0 ? timeout * 1000 : -1)) < 0 and errno == EINTR) {}
+
+            int err = ETIMEDOUT;
+            if(nfds > 1 and p[1].revents) {
+                err = ECANCELED;
+            }
+            else if(r > 0) {
+                socklen_t sl = sizeof(err);
+                ::getsockopt(sd, SOL_SOCKET, SO_ERROR, &err, &sl);
+            }
+
+            ret = err == 0 ? 0 : -1;
+            errno = err;
+        }
+
+        auto const saved = errno;
+        ::fcntl(sd, F_SETFL, flags);
+        errno = saved;
+
+        return ret;
+    }
+
+    int socket_connect (std::string const& ip_address, unsigned short port, int timeout, int cancel_fd) {
 
         auto const& log = Factory::log();
 
@@ -90,7 +152,7 @@ namespace inet {
 
         int sd = ::socket(family, SOCK_STREAM, 0);
         if (sd >= 0) {
-            auto connect_err = ::connect(sd, (struct sockaddr *) &final_sa, sizeof(final_sa));
+            auto connect_err = bounded_connect(sd, (struct sockaddr *) &final_sa, sizeof(final_sa), timeout, cancel_fd);
 
             if (connect_err == 0) {
                 // success - connected
@@ -108,7 +170,7 @@ namespace inet {
         }
     }
 
-    int download (const std::string &url, buffer &buf, int timeout, int ipv) {
+    int download (const std::string &url, buffer &buf, int timeout, int ipv, int cancel_fd) {
 
         auto const& log = Factory::log();
         _dia("inet::download: getting file %s", url.c_str());
@@ -145,7 +207,8 @@ namespace inet {
             path.reserve(path.length() + 1 + query.length());
             path.append("?").append(query);
         }
-        if(protocol.length() > 0) {
+        // explicit port in URL wins over protocol default
+        if(protocol.length() > 0 and pos3 == std::string::npos) {
             if(protocol == "http") {
                 url_port = "80";
             }
@@ -180,9 +243,9 @@ namespace inet {
             std::string request = "GET " + path + " HTTP/1.0\r\n";
             request += "Host: " + domain + "\r\n\r\n";
 
-            for (int i = 0, r = 0, ix = ip_addresses.size(); i < ix && r == 0; i++) {
+            for (int i = 0, r = 0, ix = ip_addresses.size(); i < ix && r == 0 && not cancelled(cancel_fd); i++) {
                 _deb("inet::download: GETting %s at IP:%s PORT: %d, timeout %d", request.c_str(), ip_addresses[i].c_str(), port, timeout);
-                r = http_get(request, ip_addresses[i], port, buf, timeout);
+                r = http_get(request, ip_addresses[i], port, buf, timeout, cancel_fd);
                 _dia("inet::download: finished");
                 ret = r;
                 if (ret > 0) {
@@ -218,7 +281,7 @@ namespace inet {
         return r;
     }
 
-    int http_get (const std::string &request, const std::string &ip_address, int port, buffer &buf, int timeout) {
+    int http_get (const std::string &request, const std::string &ip_address, int port, buffer &buf, int timeout, int cancel_fd) {
 
 
         auto const& log = Factory::log();
@@ -244,11 +307,12 @@ namespace inet {
         };
 
 
-        auto receive_response = [&log, &request](auto sd, auto timeout, auto& buf) -> int{
+        auto receive_response = [&log, &request, cancel_fd](auto sd, auto timeout, auto& buf) -> int{
 
             epoll e;
             e.init();
             e.add(sd, EPOLLIN);
+            if(cancel_fd >= 0) e.add(cancel_fd, EPOLLIN);
 
 
             std::string header;
@@ -267,6 +331,12 @@ namespace inet {
 
                 int nfds = e.wait(1000);
 
+                if (nfds > 0 and cancel_fd >= 0 and e.in_read_set(cancel_fd)) {
+                    _dia("internet::http_get(%s): cancelled", request.c_str());
+                    bytes_sofar = -1;
+                    break;
+                }
+
                 if (nfds > 0 and e.in_read_set(sd)) {
                     /* Don't rely on the value of tv now! */
                     bytes_received = ::recv(sd, recv_buffer, sizeof(recv_buffer), 0);
@@ -332,7 +402,7 @@ namespace inet {
 
 
         int response_size = 0;
-        int sd = socket_connect(ip_address, port);
+        int sd = socket_connect(ip_address, port, cancel_fd >= 0 ? timeout : 0, cancel_fd);
         if (sd >= 0) {
 
             if(send_request(sd) < static_cast<int>(request.length())) {
@@ -50,30 +50,39 @@ namespace inet {
     /// @param host_name 'host_name' to resolve to IP address list
     /// @param ipv 'ipv' specify IP version. Can be 4 or 6. Anything else implies IPv4.
     /// @return list of strings with IP addresses of desired IP family.
+    /// @note results are cached in DnsCache, including failures.
     std::vector<std::string> dns_lookup(const std::string &host_name, int ipv = 4);
 
+    /// @brief convert getaddrinfo() result list to IP address strings
+    std::vector<std::string> to_ip_strings(addrinfo const* res);
+
 
     /// @brief download resource via HTTP/1.0. All magic included.
     /// @param url 'url' full resource URL
     /// @param buf 'buf' buffer where to save the content. Note: buffer doesn't have to be pre-allocated.
     /// @param ipv 'ipv' specify IP version. Can be 4 or 6. Anything else implies IPv4.
     /// @param timout 'timeout' timeout of the operation
+    /// @param cancel_fd 'cancel_fd' download is aborted once this fd becomes readable (ie. eventfd), -1 if not used
     /// @return returns the size of retrieved content bytes (not size of data received on socket). Negative on error.
-    int download(const std::string& url, buffer& buf, int timout, int ipv = 4);
+    int download(const std::string& url, buffer& buf, int timout, int ipv = 4, int cancel_fd = -1);
 
     /// @brief Opens a socket to IP address and sends raw bytes. Expects HTTP response.
     /// @param request 'request' raw string with request body
     /// @param port 'port' port number to connect to
     /// @param buf 'buf' buffer where to save the content. Note: buffer doesn't have to be pre-allocated.
     /// @param timout 'timeout' timeout of the operation
+    /// @param cancel_fd 'cancel_fd' request is aborted once this fd becomes readable, -1 if not used
     /// @return returns the size of retrieved content bytes (not size of data received on socket). Negative on error.
-    int http_get(const std::string& request, const std::string& ip_address, int port, buffer& buf, int timout=10);
+    int http_get(const std::string& request, const std::string& ip_address, int port, buffer& buf, int timout=10, int cancel_fd = -1);
 
     /// @brief is it IPv4?
     bool is_ipv4_address(const std::string& str);
     /// @brief is it IPv6?
     bool is_ipv6_address(const std::string& str);
-    int socket_connect(std::string const& ip_address, unsigned short port);
+    /// @brief connected socket, negative on error. Connect is blocking, unless timeout (seconds) or cancel_fd is set.
+    int socket_connect(std::string const& ip_address, unsigned short port, int timeout = 0, int cancel_fd = -1);
+    /// @brief true if cancel_fd is set and readable
+    bool cancelled(int cancel_fd);
 
     /// @brief convert conveniently sockaddr_storage pointer to sockaddr_in pointer
     inline sockaddr_in* to_sockaddr_in(sockaddr_storage* st) { return reinterpret_cast<sockaddr_in*>(st); }
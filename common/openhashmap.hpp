@@ -0,0 +1,132 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef OPENHASHMAP_HPP
+#define OPENHASHMAP_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Open addressing (linear probing) hash map for small trivially hashable keys.
+// Entries are stored inline in one vector, erase uses backward shift, so there are no tombstones
+// and lookups stay short even under heavy insert/erase churn.
+// Not thread safe - callers lock.
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+class open_hash_map {
+
+    struct slot_t {
+        bool used = false;
+        K key {};
+        V value {};
+    };
+
+    std::vector<slot_t> slots_;
+    std::size_t size_ = 0;
+
+    // std::hash of integers is identity, spread bits before masking (murmur3 finalizer)
+    static std::size_t mix(std::size_t h) {
+        h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    std::size_t mask() const { return slots_.size() - 1; }
+    std::size_t ideal(K const& k) const { return mix(Hash{}(k)) & mask(); }
+
+    // index of key, or of empty slot where it would be inserted
+    std::size_t probe(K const& k) const {
+        auto i = ideal(k);
+        while(slots_[i].used and not (slots_[i].key == k)) i = (i + 1) & mask();
+        return i;
+    }
+
+    void grow() {
+        std::vector<slot_t> old;
+        old.swap(slots_);
+        slots_.resize(old.empty() ? 16 : old.size() * 2);
+
+        for(auto& s: old) {
+            if(not s.used) continue;
+            slots_[probe(s.key)] = std::move(s);
+        }
+    }
+
+public:
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    V* find(K const& k) {
+        if(slots_.empty()) return nullptr;
+
+        auto& s = slots_[probe(k)];
+        return s.used ? &s.value : nullptr;
+    }
+    V const* find(K const& k) const { return const_cast<open_hash_map*>(this)->find(k); }
+
+    // returns true if new entry was created
+    bool insert_or_assign(K const& k, V v) {
+        // keep load factor under 1/2, probe sequences are short then
+        if((size_ + 1) * 2 > slots_.size()) grow();
+
+        auto& s = slots_[probe(k)];
+        bool created = not s.used;
+
+        s.used = true;
+        s.key = k;
+        s.value = std::move(v);
+        if(created) ++size_;
+
+        return created;
+    }
+
+    std::size_t erase(K const& k) {
+        if(slots_.empty()) return 0;
+
+        auto i = probe(k);
+        if(not slots_[i].used) return 0;
+
+        // backward shift: pull following entries of the cluster which would not be found after the hole
+        for(auto j = (i + 1) & mask(); slots_[j].used; j = (j + 1) & mask()) {
+            auto h = ideal(slots_[j].key);
+
+            bool stays = (i < j) ? (h > i and h <= j) : (h > i or h <= j);
+            if(not stays) {
+                slots_[i] = std::move(slots_[j]);
+                i = j;
+            }
+        }
+
+        slots_[i] = slot_t();
+        --size_;
+        return 1;
+    }
+
+    void clear() { slots_.clear(); size_ = 0; }
+
+    template <typename F>
+    void for_each(F&& fn) const {
+        for(auto const& s: slots_) if(s.used) fn(s.key, s.value);
+    }
+};
+
+#endif //OPENHASHMAP_HPP
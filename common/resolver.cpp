@@ -0,0 +1,195 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+    
+    See the GNU Lesser General Public License for more details.
+    
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <resolver.hpp>
+#include <internet.hpp>
+#include <mempool/mempool.hpp>
+#include <log/logger.hpp>
+
+namespace inet {
+
+    Resolver::request_t::request_t(std::string h, std::string p, addrinfo const& hi) :
+            host(std::move(h)), port(std::move(p)), hints(hi) {
+        notify_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    Resolver::request_t::~request_t() {
+        if(result) freeaddrinfo(result);
+        if(notify_fd_ >= 0) ::close(notify_fd_);
+    }
+
+    Resolver::~Resolver() {
+        {
+            auto l_ = std::scoped_lock(lock_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+
+        for(auto& t: workers_) {
+            if(t.joinable()) t.join();
+        }
+    }
+
+    void Resolver::start() {
+        // called with lock_ held
+        if(not workers_.empty()) return;
+
+        auto n = std::max(1U, params_t::threads.load());
+        for(unsigned int i = 0; i < n; ++i) {
+            workers_.emplace_back([this]() { worker(); });
+        }
+        _dia("Resolver::start: %d threads", n);
+    }
+
+    Resolver::request_ptr Resolver::submit(std::string const& host, std::string const& port, addrinfo const& hints,
+                                           std::function<void(request_t const&)> on_done) {
+
+        auto req = std::make_shared<request_t>(host, port, hints);
+        req->on_done = std::move(on_done);
+
+        if(req->notify_fd_ < 0) {
+            _err("Resolver::submit[%s]: cannot create eventfd", host.c_str());
+            return nullptr;
+        }
+
+        {
+            auto l_ = std::scoped_lock(lock_);
+            start();
+            queue_.push_back(req);
+        }
+        cv_.notify_one();
+
+        _deb("Resolver::submit[%s:%s]: queued", host.c_str(), port.c_str());
+        return req;
+    }
+
+    void Resolver::lookup(request_t& req) {
+
+        int gai = getaddrinfo(req.host.c_str(), req.port.empty() ? nullptr : req.port.c_str(), &req.hints, &req.result);
+        if(gai != 0) {
+            _dia("Resolver::lookup[%s]: getaddrinfo: %s", req.host.c_str(), gai_strerror(gai));
+            req.gai_error = gai;
+            req.result = nullptr;
+            req.state = request_t::state_t::FAILED;
+        }
+        else {
+            req.state = request_t::state_t::DONE;
+        }
+
+        if(req.on_done) req.on_done(req);
+
+        eventfd_write(req.notify_fd_, 1);
+    }
+
+    void Resolver::worker() {
+
+        while(true) {
+            request_ptr req;
+            {
+                auto l_ = std::unique_lock(lock_);
+                cv_.wait(l_, [this]() { return stop_ or not queue_.empty(); });
+
+                if(stop_) return;
+
+                req = queue_.front();
+                queue_.pop_front();
+            }
+
+            // nobody waits for the result anymore
+            if(req.use_count() == 1 and not req->on_done) continue;
+
+            lookup(*req);
+        }
+    }
+
+
+    DnsCache::DnsCache() : cache_("dns", params_t::max_size, true, entry_t::is_expired) {
+        // entries are released into memPool: it must be destroyed after this cache
+        memPool::pool();
+    }
+
+    addrinfo DnsCache::hints(int ipv) {
+        addrinfo h {};
+        h.ai_family = ipv == 6 ? AF_INET6 : AF_INET;
+        h.ai_family = ipv == 0 ? AF_UNSPEC : h.ai_family;
+        h.ai_socktype = SOCK_STREAM;
+        return h;
+    }
+
+    std::optional<std::vector<std::string>> DnsCache::lookup(std::string const& name, int ipv) {
+
+        std::shared_ptr<entry_t> e;
+        time_t expires = 0;
+        std::vector<std::string> ret;
+        {
+            // entry could be replaced by prefetch meanwhile
+            auto l_ = std::scoped_lock(cache_.getlock());
+            e = cache_.get(key(name, ipv));
+            if(e) {
+                ret = e->value();
+                expires = e->expired_at();
+            }
+        }
+
+        if(not e) {
+            ++stats_.misses;
+            return std::nullopt;
+        }
+
+        ++stats_.hits;
+        if(ret.empty()) ++stats_.negative_hits;
+
+        if(not ret.empty() and expires - ::time(nullptr) <= static_cast<time_t>(params_t::prefetch_before)) {
+            prefetch(name, ipv);
+        }
+
+        return ret;
+    }
+
+    void DnsCache::store(std::string const& name, int ipv, std::vector<std::string> const& addresses) {
+        auto ttl = addresses.empty() ? params_t::negative_ttl.load() : params_t::ttl.load();
+        if(ttl == 0) return;
+
+        _deb("DnsCache::store[%s]: %d addresses for %ds", name.c_str(), addresses.size(), ttl);
+        cache_.set(key(name, ipv), std::make_shared<entry_t>(addresses, ttl));
+    }
+
+    void DnsCache::prefetch(std::string const& name, int ipv) {
+        auto k = key(name, ipv);
+        {
+            auto l_ = std::scoped_lock(prefetch_lock_);
+            if(not prefetching_.insert(k).second) return;
+        }
+
+        ++stats_.prefetches;
+        _dia("DnsCache::prefetch[%s]: refreshing", name.c_str());
+
+        Resolver::get().submit(name, "", hints(ipv), [this, name, ipv, k](Resolver::request_t const& req) {
+            // don't replace still valid entry with temporary failure
+            if(req.state == Resolver::request_t::state_t::DONE) {
+                store(name, ipv, to_ip_strings(req.result));
+            }
+
+            auto l_ = std::scoped_lock(prefetch_lock_);
+            prefetching_.erase(k);
+        });
+    }
+}
@@ -0,0 +1,167 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+    
+    See the GNU Lesser General Public License for more details.
+    
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+
+#include <netdb.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <ptr_cache.hpp>
+#include <log/logan.hpp>
+
+namespace inet {
+
+    //! Asynchronous getaddrinfo() resolver.
+    /*!
+     *  Lookups are executed by a small pool of threads, so resolving a hostname never blocks the event loop.
+     *  Each request carries an eventfd which becomes readable when result is ready: it can be monitored by the
+     *  same epoll instance as sockets waiting for the result.
+     */
+    class Resolver {
+    public:
+        struct params_t {
+            static inline std::atomic<unsigned int> threads = 2;
+        };
+
+        struct request_t {
+            enum class state_t { PENDING, DONE, FAILED };
+
+            request_t(std::string h, std::string p, addrinfo const& hints);
+            ~request_t();
+
+            request_t(request_t const&) = delete;
+            request_t& operator=(request_t const&) = delete;
+
+            std::string const host;
+            std::string const port;
+            addrinfo const hints;
+
+            std::atomic<state_t> state = state_t::PENDING;
+            int gai_error = 0;
+
+            addrinfo* result = nullptr;    // valid once state is DONE, owned by request
+
+            // optional, called from resolver thread once lookup finished
+            std::function<void(request_t const&)> on_done;
+
+            [[nodiscard]] int notify_fd() const { return notify_fd_; }
+            [[nodiscard]] bool ready() const { return state != state_t::PENDING; }
+
+        private:
+            friend class Resolver;
+            int notify_fd_ = -1;          // eventfd, readable when request is not PENDING anymore
+        };
+        using request_ptr = std::shared_ptr<request_t>;
+
+        static Resolver& get() {
+            static Resolver r;
+            return r;
+        }
+
+        /// @brief queue lookup. Returned request notify_fd() becomes readable once lookup finished.
+        request_ptr submit(std::string const& host, std::string const& port, addrinfo const& hints,
+                           std::function<void(request_t const&)> on_done = nullptr);
+
+        ~Resolver();
+
+        Resolver(Resolver const&) = delete;
+        Resolver& operator=(Resolver const&) = delete;
+
+    private:
+        Resolver() = default;
+
+        void start();
+        void worker();
+        void lookup(request_t& req);
+
+        std::mutex lock_;
+        std::condition_variable cv_;
+        std::deque<request_ptr> queue_;
+        std::vector<std::thread> workers_;
+        bool stop_ = false;
+
+        logan_lite log {"inet.resolver"};
+    };
+
+
+    //! Process-wide cache of hostname lookups, shared by all workers.
+    /*!
+     *  Keyed by name and IP version (as used by dns_lookup()). Failed lookups are cached too, for shorter time.
+     *  Entries close to expiry are refreshed in background by Resolver while cached value is still served.
+     */
+    class DnsCache {
+    public:
+        struct params_t {
+            static inline std::atomic<unsigned int> ttl = 60;              // lifetime of resolved entries
+            static inline std::atomic<unsigned int> negative_ttl = 10;     // lifetime of failed lookups
+            static inline std::atomic<unsigned int> prefetch_before = 5;   // refresh entries expiring in less seconds
+            static inline unsigned int max_size = 2000;                    // applied when cache is created
+        };
+
+        struct stats_t {
+            std::atomic<std::size_t> hits {0};
+            std::atomic<std::size_t> negative_hits {0};
+            std::atomic<std::size_t> misses {0};
+            std::atomic<std::size_t> prefetches {0};
+        };
+
+        // empty list indicates failed lookup
+        using entry_t = expiring<std::vector<std::string>>;
+
+        static DnsCache& get() {
+            static DnsCache c;
+            return c;
+        }
+
+        /// @brief cached addresses (empty if name is known not to resolve), nullopt if not cached
+        std::optional<std::vector<std::string>> lookup(std::string const& name, int ipv);
+        void store(std::string const& name, int ipv, std::vector<std::string> const& addresses);
+        void clear() { cache_.clear(); }
+
+        [[nodiscard]] stats_t const& stats() const { return stats_; }
+
+        static addrinfo hints(int ipv);
+        static std::string key(std::string const& name, int ipv) { return std::to_string(ipv) + "/" + name; }
+
+    private:
+        DnsCache();
+        void prefetch(std::string const& name, int ipv);
+
+        ptr_cache<std::string, entry_t> cache_;
+        stats_t stats_;
+
+        std::mutex prefetch_lock_;
+        std::unordered_set<std::string> prefetching_;
+
+        logan_lite log {"inet.dnscache"};
+    };
+}
+
+#endif //RESOLVER_HPP
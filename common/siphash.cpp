@@ -0,0 +1,87 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <cstring>
+#include <random>
+
+#include <siphash.hpp>
+
+namespace socle::tools {
+
+    namespace {
+        inline uint64_t rotl(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+        inline void sipround(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+            v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+            v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+            v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+            v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+        }
+
+        inline uint64_t load64(const unsigned char* p) {
+            uint64_t r;
+            std::memcpy(&r, p, sizeof(r));
+            return r;
+        }
+    }
+
+    uint64_t siphash::compute(key_type const& key, const void* data, size_t len) {
+
+        auto const* in = static_cast<const unsigned char*>(data);
+
+        uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+        uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+        uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+        uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+
+        auto const* end = in + (len - (len % 8));
+        for(; in != end; in += 8) {
+            uint64_t m = load64(in);
+            v3 ^= m;
+            sipround(v0, v1, v2, v3);
+            sipround(v0, v1, v2, v3);
+            v0 ^= m;
+        }
+
+        // last block: remaining bytes and message length in the top byte
+        uint64_t b = static_cast<uint64_t>(len) << 56;
+        for(size_t i = 0; i < (len % 8); ++i) {
+            b |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+
+        v3 ^= b;
+        sipround(v0, v1, v2, v3);
+        sipround(v0, v1, v2, v3);
+        v0 ^= b;
+
+        v2 ^= 0xff;
+        for(int i = 0; i < 4; ++i) sipround(v0, v1, v2, v3);
+
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    siphash::key_type const& siphash::process_key() {
+        static const key_type key = []() {
+            std::random_device rd;
+            auto r64 = [&rd]() { return (static_cast<uint64_t>(rd()) << 32) | rd(); };
+            return key_type { r64(), r64() };
+        }();
+
+        return key;
+    }
+}
@@ -0,0 +1,41 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SIPHASH_HPP
+#define SIPHASH_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace socle::tools {
+
+    // SipHash-2-4 keyed hash (Aumasson, Bernstein). Keyed with a secret it's safe to use for hashing
+    // attacker controlled data (ie. packet headers) into tables - hash flooding is not possible.
+    struct siphash {
+        using key_type = std::array<uint64_t, 2>;
+
+        static uint64_t compute(key_type const& key, const void* data, size_t len);
+
+        // random key generated once per process
+        static key_type const& process_key();
+        static uint64_t compute(const void* data, size_t len) { return compute(process_key(), data, len); }
+    };
+}
+
+#endif //SIPHASH_HPP
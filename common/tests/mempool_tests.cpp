@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <mempool/mempool.hpp>
+#include <buffer.hpp>
 
 
 
@@ -125,3 +126,21 @@ TEST(Mempool,MixedConcurrencyRealloc) {
 
     rinse_threads(s);
 }
+
+
+TEST(Mempool,BufferShrink) {
+
+    buffer b(1024*1024);
+    b.append("hello", 5);
+
+    // won't fit
+    ASSERT_FALSE(b.shrink(4));
+
+    ASSERT_TRUE(b.shrink(2048));
+    ASSERT_LT(b.capacity(), 1024*1024);
+    ASSERT_EQ(b.size(), 5);
+    ASSERT_EQ(b.string_view(), "hello");
+
+    // capacity already small enough
+    ASSERT_FALSE(b.shrink(b.capacity()));
+}
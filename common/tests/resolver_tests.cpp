@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <resolver.hpp>
+
+#include <poll.h>
+#include <cstring>
+
+
+// wait until request's eventfd signals completion
+static bool wait_done(inet::Resolver::request_ptr const& req, int timeout_ms = 5000) {
+    pollfd p {};
+    p.fd = req->notify_fd();
+    p.events = POLLIN;
+
+    return ::poll(&p, 1, timeout_ms) == 1 and req->ready();
+}
+
+static addrinfo stream_hints() {
+    addrinfo hints {};
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    return hints;
+}
+
+TEST(Resolver, ResolveLocalhost) {
+
+    auto req = inet::Resolver::get().submit("localhost", "80", stream_hints());
+    ASSERT_TRUE(req);
+    ASSERT_TRUE(wait_done(req));
+
+    ASSERT_EQ(req->state, inet::Resolver::request_t::state_t::DONE);
+    ASSERT_NE(req->result, nullptr);
+}
+
+TEST(Resolver, ResolveInvalid) {
+
+    // .invalid TLD is guaranteed not to resolve (RFC 2606)
+    auto req = inet::Resolver::get().submit("no-such-host.invalid", "80", stream_hints());
+    ASSERT_TRUE(req);
+    ASSERT_TRUE(wait_done(req, 30000));
+
+    ASSERT_EQ(req->state, inet::Resolver::request_t::state_t::FAILED);
+    ASSERT_EQ(req->result, nullptr);
+}
+
+TEST(Resolver, ManyInParallel) {
+
+    std::vector<inet::Resolver::request_ptr> reqs;
+    for(int i = 0; i < 32; ++i) {
+        reqs.push_back(inet::Resolver::get().submit("localhost", std::to_string(1000 + i), stream_hints()));
+    }
+    for(auto const& r: reqs) {
+        ASSERT_TRUE(wait_done(r));
+        ASSERT_EQ(r->state, inet::Resolver::request_t::state_t::DONE);
+    }
+}
+
+TEST(DnsCache, PositiveAndNegative) {
+
+    auto& cache = inet::DnsCache::get();
+    cache.clear();
+
+    auto misses = cache.stats().misses.load();
+    auto hits = cache.stats().hits.load();
+
+    ASSERT_FALSE(cache.lookup("cached.example", 4).has_value());
+    ASSERT_EQ(cache.stats().misses, misses + 1);
+
+    cache.store("cached.example", 4, { "192.0.2.1" });
+    auto pos = cache.lookup("cached.example", 4);
+    ASSERT_TRUE(pos.has_value());
+    ASSERT_EQ(pos->front(), "192.0.2.1");
+
+    // different IP version is different entry
+    ASSERT_FALSE(cache.lookup("cached.example", 6).has_value());
+
+    cache.store("missing.example", 4, {});
+    auto neg = cache.lookup("missing.example", 4);
+    ASSERT_TRUE(neg.has_value());
+    ASSERT_TRUE(neg->empty());
+
+    ASSERT_EQ(cache.stats().hits, hits + 2);
+    ASSERT_GE(cache.stats().negative_hits, 1);
+}
+
+TEST(DnsCache, PrefetchNearExpiry) {
+
+    auto& cache = inet::DnsCache::get();
+    cache.clear();
+
+    // entry expires sooner than prefetch threshold: lookup serves it and refreshes it in background
+    inet::DnsCache::params_t::ttl = 2;
+    cache.store("localhost", 4, { "192.0.2.1" });
+    inet::DnsCache::params_t::ttl = 60;
+
+    auto prefetches = cache.stats().prefetches.load();
+    ASSERT_EQ(cache.lookup("localhost", 4)->front(), "192.0.2.1");
+    ASSERT_EQ(cache.stats().prefetches, prefetches + 1);
+
+    for(int i = 0; i < 100; ++i) {
+        auto cur = cache.lookup("localhost", 4);
+        if(cur and cur->front() == "127.0.0.1") break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    ASSERT_EQ(cache.lookup("localhost", 4)->front(), "127.0.0.1");
+}
@@ -0,0 +1,120 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <cxpool.hpp>
+#include <display.hpp>
+
+
+bool CxPool::healthy(baseHostCX const* cx) {
+
+    if(not cx or not cx->com() or cx->socket() <= 0 or cx->error()) return false;
+
+    // ask com: TLS connection receives records which are not data (ie. session tickets)
+    return cx->com()->idle_alive(cx->socket());
+}
+
+std::unique_ptr<baseHostCX> CxPool::acquire(std::string const& host, std::string const& port, std::string const& tag) {
+
+    auto it = idle_.find(key(host, port, tag));
+
+    if(it != idle_.end()) {
+        auto& q = it->second;
+        auto const now = time(nullptr);
+
+        // most recently parked are most likely still alive
+        while(not q.empty()) {
+            auto e = std::move(q.back());
+            q.pop_back();
+
+            if(now - e.since > static_cast<time_t>(params_t::max_idle_sec)) {
+                ++stats_.expired;
+                continue;
+            }
+            if(not healthy(e.cx.get())) {
+                _dia("CxPool::acquire[%s:%s]: dropping unhealthy connection", host.c_str(), port.c_str());
+                ++stats_.unhealthy;
+                continue;
+            }
+
+            if(q.empty()) idle_.erase(it);
+
+            ++stats_.hits;
+            e.cx->pool_reset();
+            _dia("CxPool::acquire[%s:%s/%s]: reusing socket %d", host.c_str(), port.c_str(), tag.c_str(), e.cx->socket());
+            return std::move(e.cx);
+        }
+        idle_.erase(it);
+    }
+
+    ++stats_.misses;
+    return nullptr;
+}
+
+bool CxPool::release(std::unique_ptr<baseHostCX>& cx) {
+
+    if(not cx) return false;
+
+    bool clean = cx->readbuf()->empty() and cx->writebuf()->empty() and not cx->opening() and healthy(cx.get());
+    auto const k = key(cx->host(), cx->port(), cx->pool_tag());
+    auto& q = idle_[k];
+
+    if(not clean or q.size() >= params_t::max_per_key) {
+        _deb("CxPool::release[%s]: refused (%s)", cx->c_type(), clean ? "full" : "not clean");
+        ++stats_.refused;
+        if(q.empty()) idle_.erase(k);
+        return false;
+    }
+
+    // parked socket must not be handled by anybody
+    cx->com()->unset_monitor(cx->socket());
+    cx->com()->set_poll_handler(cx->socket(), nullptr);
+    cx->peer(nullptr);
+    cx->parent_proxy(nullptr, '-');
+    cx->pool_reset();
+
+    _dia("CxPool::release[%s]: socket %d parked", cx->c_type(), cx->socket());
+    q.push_back({ std::move(cx), time(nullptr) });
+    ++stats_.parked;
+
+    return true;
+}
+
+void CxPool::expire() {
+
+    auto const now = time(nullptr);
+    if(now == last_expire_) return;
+    last_expire_ = now;
+
+    for(auto it = idle_.begin(); it != idle_.end(); ) {
+        auto& q = it->second;
+
+        // entries are ordered by park time, oldest first
+        while(not q.empty() and now - q.front().since > static_cast<time_t>(params_t::max_idle_sec)) {
+            q.pop_front();
+            ++stats_.expired;
+        }
+
+        it = q.empty() ? idle_.erase(it) : std::next(it);
+    }
+}
+
+std::size_t CxPool::size() const {
+    std::size_t ret = 0L;
+    for(auto const& [ k, q ]: idle_) ret += q.size();
+    return ret;
+}
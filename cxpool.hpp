@@ -0,0 +1,96 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef CXPOOL_HPP
+#define CXPOOL_HPP
+
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <hostcx.hpp>
+#include <log/logan.hpp>
+
+
+//! Pool of idle, already connected upstream connections.
+/*!
+ *  Sessions which are done with their upstream (right side) connection can park it here, instead of closing it,
+ *  if application knows the connection is at a clean message boundary (see baseHostCX::reusable()).
+ *  Connection is parked including its Com, therefore TLS connections are pooled already handshaked.
+ *
+ *  Pool is per worker thread: parked connections keep Com's master, which belongs to the worker.
+ *  Entries are keyed by upstream host, port and application tag (ie. SNI). Connections are checked before
+ *  handing them out: closed by server, receiving unexpected data or idle for too long are dropped.
+ */
+class CxPool {
+public:
+    struct params_t {
+        static inline std::atomic<unsigned int> max_idle_sec = 30;   // drop connections idle longer than this
+        static inline std::atomic<std::size_t> max_per_key = 8;      // maximum parked connections to single target
+    };
+
+    struct stats_t {
+        std::size_t hits = 0L;
+        std::size_t misses = 0L;
+        std::size_t parked = 0L;
+        std::size_t refused = 0L;     // not parked: pool full or connection not clean
+        std::size_t expired = 0L;
+        std::size_t unhealthy = 0L;   // closed by peer or unexpected data found on reuse
+    };
+
+    // per worker (thread) pool
+    static CxPool& pool() {
+        thread_local CxPool p;
+        return p;
+    }
+
+    static std::string key(std::string const& host, std::string const& port, std::string const& tag) {
+        return host + ":" + port + "/" + tag;
+    }
+
+    /// @brief take connected cx to given target, or nullptr if there is none usable
+    std::unique_ptr<baseHostCX> acquire(std::string const& host, std::string const& port, std::string const& tag = {});
+
+    /// @brief park cx, which must be already removed from its proxy. On refusal cx is left untouched and false is returned.
+    bool release(std::unique_ptr<baseHostCX>& cx);
+
+    /// @brief drop idle connections; cheap to call often, does the work at most once a second
+    void expire();
+
+    /// @brief check if socket is still connected and has nothing unread
+    static bool healthy(baseHostCX const* cx);
+
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] stats_t const& stats() const { return stats_; }
+
+private:
+    struct entry_t {
+        std::unique_ptr<baseHostCX> cx;
+        time_t since = 0;
+    };
+
+    std::unordered_map<std::string, std::deque<entry_t>> idle_;
+    time_t last_expire_ = 0;
+    stats_t stats_;
+
+    logan_lite log {"proxy.pool"};
+};
+
+#endif //CXPOOL_HPP
@@ -356,11 +356,111 @@ void baseHostCX::grow_buffer() {
     }
 }
 
+void baseHostCX::adjust_buffers() {
+
+    unsigned int const idle_limit = params_t::shrink_idle;
+    if(idle_limit == 0) return;
+
+    std::size_t const initial = params_t::buffsize;
+    auto const now = time(nullptr);
+    bool const idle = now - std::max(r_activity, w_activity) >= static_cast<time_t>(idle_limit);
+
+    // expected need: twice the average read rounded up to power of 2, but never under initial size
+    std::size_t target = initial;
+    if(not idle) {
+        while(target < read_ewma_ * 2) target *= 2;
+    }
+    std::size_t const limit = idle ? target : target * params_t::shrink_ratio;
+
+    auto shrink_one = [&](lockbuffer& b, const char* which) {
+        auto l_ = std::scoped_lock(b.lock_);
+
+        if(b.capacity() <= limit or b.size() > target) return;
+
+        auto old_cap = b.capacity();
+        if(b.shrink(target)) {
+            ++buffer_shrinks_;
+            _dia("baseHostCX::adjust_buffers[%s]: %s buffer shrunk %d -> %d bytes (%s, avg read %dB)", c_type(), which,
+                 old_cap, b.capacity(), idle ? "idle" : "busy", read_ewma_);
+        }
+    };
+
+    shrink_one(readbuf_, "read");
+    shrink_one(writebuf_, "write");
+
+    if(idle) read_ewma_ = 0L;
+}
+
+bool baseHostCX::flow_read_paused() {
+
+    if(not peer()) return false;
+
+    auto queued = peer()->writebuf()->size();
+
+    if(flow_paused_) {
+        if(queued > params_t::write_low) {
+            // someone re-armed EPOLLIN meanwhile, remove it again
+            flow_pause();
+            return true;
+        }
+
+        flow_resume();
+        return false;
+    }
+
+    if(queued > params_t::write_full) {
+        flow_pause();
+        return true;
+    }
+
+    return false;
+}
+
+void baseHostCX::flow_pause() {
+
+    // resume is triggered by peer's write(), which is possible only if it knows us
+    if(peer()->peer() != this) {
+        com()->rescan_read(socket());
+        return;
+    }
+
+    if(not flow_paused_) {
+        flow_paused_ = true;
+        ++flow_pauses_;
+        _dia("baseHostCX::flow_pause[%s]: peer has %dB queued, reading paused", c_type(), peer()->writebuf()->size());
+    }
+
+    com()->change_monitor(socket(), flow_write_interest());
+}
+
+int baseHostCX::flow_write_interest() const {
+    return (rescan_out_flag_ or opening() or not writebuf_.empty()) ? static_cast<int>(EPOLLOUT) : 0;
+}
+
+void baseHostCX::flow_resume() {
+
+    if(not flow_paused_) return;
+
+    flow_paused_ = false;
+
+    // reading is paused also by proxy or by io_disabled, EPOLLIN is up to them
+    if(read_waiting_for_peercom_ or io_disabled()) {
+        _dia("baseHostCX::flow_resume[%s]: peer drained, but reading is still paused", c_type());
+        return;
+    }
+
+    _dia("baseHostCX::flow_resume[%s]: peer drained, reading resumed", c_type());
+    com()->change_monitor(socket(), EPOLLIN | flow_write_interest());
+}
+
 void baseHostCX::after_read(std::size_t buffer_written_len) {
     meter_read_bytes += buffer_written_len;
     meter_read_count++;
     r_activity = time(nullptr);
 
+    // weight 1/8 of the new sample
+    read_ewma_ = read_ewma_ - read_ewma_/8 + buffer_written_len/8;
+
     // claim opening socket already opened
     if (opening()) {
         _dia("baseHostCX::read[%s]: connection established", c_type());
@@ -401,14 +501,16 @@ int baseHostCX::read() {
         _war("io is disabled, but read() called");
     }
 
+    // zerocopy completions are signalled as read events too: reap them, or they would fire again on idle socket
+    com()->zerocopy_reap(socket());
+
     if(read_waiting_for_peercom()) {
         _deb("baseHostCX::read[%s]: read operation is waiting_for_peercom, returning -1",c_type());
         return -1;
     }
 
-    if(peer() && peer()->writebuf()->size() > baseHostCX::params_t::write_full) {
+    if(flow_read_paused()) {
         _deb("baseHostCX::read[%d]: deferring read operation",socket());
-        com()->rescan_read(socket());
         return -1;
     }
 
@@ -554,6 +656,8 @@ int baseHostCX::write() {
         _war("io is disabled, but write() called");
     }
 
+    // release buffers of previous zerocopy writes kernel is done with
+    com()->zerocopy_reap(socket());
 
     if(write_waiting_for_peercom()) {
         _deb("baseHostCX::write[%s]: write operation is waiting_for_peercom, returning 0", c_type());
@@ -595,7 +699,10 @@ int baseHostCX::write() {
     }
 
     // process_out can actually extend bytes, so we cannot rely on tx_size
-    ssize_t l = io_write(writebuf_.data(), std::min(writebuf_.size(), processed_out_), MSG_NOSIGNAL);
+    auto tx_len = std::min(writebuf_.size(), processed_out_);
+    bool zerocopy = com()->zerocopy_wanted(socket(), tx_len);
+
+    ssize_t l = io_write(writebuf_.data(), tx_len, zerocopy ? MSG_NOSIGNAL|MSG_ZEROCOPY : MSG_NOSIGNAL);
 
     if (l > 0) {
         meter_write_bytes += static_cast<std::size_t>(l);
@@ -633,7 +740,24 @@ int baseHostCX::write() {
             }
         }
 
-        writebuf_.flush(static_cast<std::size_t>(l));
+        if(zerocopy) {
+            // kernel still reads sent bytes: hand over whole buffer to com and keep only the unsent tail
+            buffer sent;
+            sent.swap(writebuf_);
+
+            writebuf_.capacity(sent.capacity());
+            writebuf_.append(sent.data() + l, sent.size() - static_cast<std::size_t>(l));
+
+            com()->zerocopy_pin(std::move(sent));
+        }
+        else {
+            writebuf_.flush(static_cast<std::size_t>(l));
+        }
+
+        // we drained enough, let our peer read again
+        if(peer() and peer()->flow_paused_ and writebuf_.size() <= params_t::write_low) {
+            peer()->flow_resume();
+        }
 
         if(baseCom::debug_log_data_crc) {
             _deb("baseHostCX::write[%s]: after: buffer crc = %X", c_type(),
@@ -664,6 +788,41 @@ int baseHostCX::write() {
 void baseHostCX::pre_write() {
 }
 
+void baseHostCX::pool_reset() {
+    // next session must mark it reusable again on its own
+    reusable_ = false;
+
+    meter_read_count = 0;
+    meter_write_count = 0;
+    meter_read_bytes = 0L;
+    meter_write_bytes = 0L;
+
+    // keep processed counters consistent with meters, or process_in/out wouldn't be called
+    processed_in_total_ = 0L;
+    processed_out_total_ = 0L;
+}
+
+void baseHostCX::on_splice_read(std::size_t bytes) {
+    meter_read_bytes += bytes;
+    meter_read_count++;
+    r_activity = time(nullptr);
+
+    // nobody will see those bytes, but keep processed counters consistent with meters
+    processed_in_total_ += bytes;
+
+    _ext("baseHostCX::on_splice_read[%s]: %d bytes", c_type(), bytes);
+}
+
+void baseHostCX::on_splice_write(std::size_t bytes) {
+    meter_write_bytes += bytes;
+    meter_write_count++;
+    w_activity = time(nullptr);
+
+    processed_out_total_ += bytes;
+
+    _ext("baseHostCX::on_splice_write[%s]: %d bytes", c_type(), bytes);
+}
+
 
 void baseHostCX::post_write() {
 }
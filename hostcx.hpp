@@ -183,9 +183,13 @@ public:
         // allow these as tunables
         static inline std::atomic<std::size_t> buffsize = 2048;        // initial buffer size
         static inline std::atomic<std::size_t> buffsize_maxmul = 1024; // maximum size as a multiple of initial
-        static inline std::atomic<std::size_t> write_full = 200000;    // when to slightly delay our reads if this bytes is queued from their writing
+        static inline std::atomic<std::size_t> write_full = 200000;    // high watermark: stop reading if this bytes is queued from their writing
+        static inline std::atomic<std::size_t> write_low = 50000;      // low watermark: peer draining its writebuf under this resumes our reading
         static inline uint16_t com_not_ready_slowdown = 20;            // when handshakes are not finished, how aggressive checking (higher, more aggressive)
         static inline std::atomic<std::size_t> fast_copy_start = 20*1024;      // how many bytes copy before moving whole buffers (too low may break detection)
+        static inline std::atomic<unsigned int> shrink_idle = 10;      // seconds without I/O after which buffers drop back to initial size, 0 disables
+        static inline std::atomic<unsigned int> shrink_ratio = 4;      // shrink busy buffers only if capacity exceeds this multiple of expected need
+        static inline std::atomic_bool write_coalesce = false;         // proxy writes each socket once, at the end of loop iteration
     };
 
     static inline params_t params {};
@@ -226,6 +230,9 @@ private:
 	lockbuffer readbuf_;  //!< read buffer
 	lockbuffer writebuf_; //!< write buffer
 	
+	std::size_t read_ewma_ = 0L;       //!< moving average of bytes received by a single read, drives buffer sizing
+	unsigned int buffer_shrinks_ = 0;  //!< how many times buffers were shrunk
+
 	std::size_t processed_in_total_ = 0L;
 	std::size_t processed_out_total_ = 0L;
 
@@ -254,6 +261,10 @@ private:
     // after writing all data into the socket we should shutdown the socket
     bool close_after_write_ = false;
 
+    // connection is at message boundary and can be parked in upstream pool instead of closing
+    bool reusable_ = false;
+    std::string pool_tag_;
+
     // larval connection facility
     bool opening_ = false;
 
@@ -272,6 +283,10 @@ protected:
 
     bool rescan_out_flag_ = false;
 
+    // flow control: EPOLLIN removed because peer's writebuf is over high watermark
+    bool flow_paused_ = false;
+    unsigned int flow_pauses_ = 0;
+
     LOGAN_LITE("proxy");
 public:
 
@@ -412,9 +427,16 @@ public:
 	inline lockbuffer const* readbuf() const { return &readbuf_; }
 
 	inline lockbuffer* writebuf() { return &writebuf_; }
-    inline lockbuffer const* writebuf() const { return &readbuf_; }
+    inline lockbuffer const* writebuf() const { return &writebuf_; }
 	
 	inline void send(buffer& b) { writebuf_.append(b); }
+
+    // payload is forwarded by kernel (see Splicer), only meters and activity timestamps are updated
+    void on_splice_read(std::size_t bytes);
+    void on_splice_write(std::size_t bytes);
+
+    // return true if payload must pass through readbuf/writebuf (ie. it's inspected), which prevents kernel forwarding
+    virtual bool needs_payload() const { return false; }
 	inline std::size_t peek(buffer& b) const
     {
         auto r = com()->peek(this->socket(), b.data(), b.capacity(), 0);
@@ -449,6 +471,18 @@ public:
 
 	int read();
 	void grow_buffer();
+	// watermark flow control: returns true if reading should wait until peer drains its writebuf
+	bool flow_read_paused();
+	void flow_pause();
+	void flow_resume();
+	// EPOLLOUT this cx still needs while its reading is paused: pending data, partial write or connect in progress
+	int flow_write_interest() const;
+	bool flow_paused() const { return flow_paused_; }
+	unsigned int flow_pauses() const { return flow_pauses_; }
+	// shrink oversized buffers if connection is idle, or traffic doesn't need them. Called periodically by proxy timer.
+	void adjust_buffers();
+	std::size_t read_ewma() const { return read_ewma_; }
+	unsigned int buffer_shrinks() const { return buffer_shrinks_; }
 	ssize_t io_read(void* where, size_t len, int flags) const;
 	void after_read(std::size_t bytes);
 
@@ -467,6 +501,13 @@ public:
     virtual void to_write(const std::string&);
 	virtual void to_write(unsigned char* c, unsigned int l); 
 	inline bool close_after_write() const { return close_after_write_; };
+	inline bool reusable() const { return reusable_; }
+	inline void reusable(bool b) { reusable_ = b; }
+	// distinguishes pooled connections to the same host:port, ie. by SNI
+	inline std::string const& pool_tag() const { return pool_tag_; }
+	inline void pool_tag(std::string const& t) { pool_tag_ = t; }
+	// forget state of previous session: called when cx is parked in and taken from CxPool
+	void pool_reset();
 	inline void close_after_write(bool b) { close_after_write_ = b; };
 	
 	virtual lockbuffer& to_read();
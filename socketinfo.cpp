@@ -17,7 +17,9 @@
 */
 
 #include <fcntl.h>
-#include <random>
+#include <array>
+#include <cstring>
+#include <siphash.hpp>
 
 #include <socketinfo.hpp>
 #include <common/internet.hpp>
@@ -92,56 +94,60 @@ uint32_t SocketInfo::create_session_key(bool negative) {
     }
 }
 
-uint32_t SocketInfo::create_session_key4(sockaddr_storage* from, sockaddr_storage* orig, bool negative) {
-
-    uint32_t s = inet::to_sockaddr_in(from)->sin_addr.s_addr;
-    uint32_t d = inet::to_sockaddr_in(orig)->sin_addr.s_addr;
-    uint32_t sp = ntohs(inet::to_sockaddr_in(from)->sin_port);
-    uint32_t sd = ntohs(inet::to_sockaddr_in(orig)->sin_port);
-
-    std::seed_seq seed1{ s, d, sp, sd };
-    std::mt19937 e(seed1);
-    std::uniform_int_distribution<> dist;
-
-    uint32_t mirand = dist(e);
-
-
+uint32_t SocketInfo::session_key_sign(uint32_t key, bool negative) {
     if(negative)
-        mirand |= (1UL << 31); //this will produce negative number, which should determine  if it's normal socket or not
+        key |= (1UL << 31); //this will produce negative number, which should determine  if it's normal socket or not
     else
-        mirand &= ~(1UL << 31); //this will explicitly remove sign bit
+        key &= ~(1UL << 31); //this will explicitly remove sign bit
 
+    return key; // however we return it as the key, therefore cast to unsigned int
+}
 
-    return mirand; // however we return it as the key, therefore cast to unsigned int
+uint32_t SocketInfo::next_session_key(uint32_t key) {
+    return session_key_sign(key + 1, key & (1UL << 31));
 }
 
-uint32_t SocketInfo::create_session_key6(sockaddr_storage* from, sockaddr_storage* orig, bool negative) {
+uint32_t SocketInfo::create_session_key4(sockaddr_storage* from, sockaddr_storage* orig, bool negative) {
+
+    std::array<uint32_t, 3> tuple {
+        inet::to_sockaddr_in(from)->sin_addr.s_addr,
+        inet::to_sockaddr_in(orig)->sin_addr.s_addr,
+        (static_cast<uint32_t>(inet::to_sockaddr_in(from)->sin_port) << 16) | inet::to_sockaddr_in(orig)->sin_port
+    };
 
-    uint32_t s0 = ((uint32_t*)&inet::to_sockaddr_in6(from)->sin6_addr)[0];
-    uint32_t s1 = ((uint32_t*)&inet::to_sockaddr_in6(from)->sin6_addr)[1];
-    uint32_t s2 = ((uint32_t*)&inet::to_sockaddr_in6(from)->sin6_addr)[2];
-    uint32_t s3 = ((uint32_t*)&inet::to_sockaddr_in6(from)->sin6_addr)[3];
+    auto h = static_cast<uint32_t>(socle::tools::siphash::compute(tuple.data(), sizeof(tuple)));
+    return session_key_sign(h, negative);
+}
 
-    uint32_t d0 = ((uint32_t*)&inet::to_sockaddr_in6(orig)->sin6_addr)[0];
-    uint32_t d1 = ((uint32_t*)&inet::to_sockaddr_in6(orig)->sin6_addr)[1];
-    uint32_t d2 = ((uint32_t*)&inet::to_sockaddr_in6(orig)->sin6_addr)[2];
-    uint32_t d3 = ((uint32_t*)&inet::to_sockaddr_in6(orig)->sin6_addr)[3];
+uint32_t SocketInfo::create_session_key6(sockaddr_storage* from, sockaddr_storage* orig, bool negative) {
 
-    uint32_t sp = ntohs(inet::to_sockaddr_in6(from)->sin6_port);
-    uint32_t dp = ntohs(inet::to_sockaddr_in6(orig)->sin6_port);
+    std::array<uint32_t, 9> tuple {};
+    std::memcpy(&tuple[0], &inet::to_sockaddr_in6(from)->sin6_addr, sizeof(in6_addr));
+    std::memcpy(&tuple[4], &inet::to_sockaddr_in6(orig)->sin6_addr, sizeof(in6_addr));
+    tuple[8] = (static_cast<uint32_t>(inet::to_sockaddr_in6(from)->sin6_port) << 16) | inet::to_sockaddr_in6(orig)->sin6_port;
 
-    std::seed_seq seed1{ s0, d0, s1, d1, s2, d2, s3, d3, sp, dp };
-    std::mt19937 e(seed1);
-    std::uniform_int_distribution<> dist;
+    auto h = static_cast<uint32_t>(socle::tools::siphash::compute(tuple.data(), sizeof(tuple)));
+    return session_key_sign(h, negative);
+}
 
-    uint32_t mirand = dist(e);
+bool SockOps::ss_same(const sockaddr_storage* a, const sockaddr_storage* b) {
 
-    if(negative)
-        mirand |= (1 << 31); //this will produce negative number, which should determine  if it's normal socket or not
-    else
-        mirand &= ~(1UL << 31); //this will explicitly remove sign bit
+    if(a->ss_family != b->ss_family) return false;
 
-    return mirand; // however we return it as the key, therefore cast to unsigned int
+    switch(a->ss_family) {
+        case AF_INET: {
+            auto const* a4 = reinterpret_cast<const sockaddr_in*>(a);
+            auto const* b4 = reinterpret_cast<const sockaddr_in*>(b);
+            return a4->sin_port == b4->sin_port and a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+        }
+        case AF_INET6: {
+            auto const* a6 = reinterpret_cast<const sockaddr_in6*>(a);
+            auto const* b6 = reinterpret_cast<const sockaddr_in6*>(b);
+            return a6->sin6_port == b6->sin6_port and 0 == std::memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(in6_addr));
+        }
+        default:
+            return false;
+    }
 }
 
 int SockOps::socket_create(int family ,int l4proto, int protocol) {
@@ -47,6 +47,9 @@ struct SockOps {
     // returns sockaddr_storage in human readable string description
     static std::string ss_str(const sockaddr_storage *s);
 
+    // true if both are the same family, address and port
+    static bool ss_same(const sockaddr_storage *a, const sockaddr_storage *b);
+
     static void socket_transparent(int fd, int family);
     static int socket_create(int family ,int l4proto, int protocol);
 };
@@ -92,9 +95,13 @@ struct SocketInfo {
 
     // create pseudo-unique session id. If @negative is true, returning value is "signed" (most significant bit set to 1)
     // Note: return value is uint
+    // Key is keyed (siphash) hash of the 4-tuple, so it can't be predicted and flooded, but it can collide:
+    // users must check stored src/dst and probe with next_session_key() if it doesn't match.
     uint32_t create_session_key(bool negative=false);
     static uint32_t create_session_key4(sockaddr_storage *from, sockaddr_storage* orig,  bool negative=false);
     static uint32_t create_session_key6(sockaddr_storage *from, sockaddr_storage* orig, bool negative=false);
+    static uint32_t next_session_key(uint32_t key);
+    static uint32_t session_key_sign(uint32_t key, bool negative);
 
     // convert socket family to human-readable string. ie: AF_INET into "ip4"
 
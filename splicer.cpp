@@ -0,0 +1,124 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+
+#include <splicer.hpp>
+#include <display.hpp>
+
+
+Splicer::~Splicer() {
+    if(pipe_[0] >= 0) ::close(pipe_[0]);
+    if(pipe_[1] >= 0) ::close(pipe_[1]);
+}
+
+bool Splicer::init() {
+
+    if(valid()) return true;
+
+    if(::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) != 0) {
+        _err("Splicer::init: cannot create pipe: %s", string_error().c_str());
+        pipe_[0] = -1;
+        pipe_[1] = -1;
+        return false;
+    }
+
+    if(params_t::pipe_size > 0) {
+        if(::fcntl(pipe_[1], F_SETPIPE_SZ, static_cast<int>(params_t::pipe_size)) < 0) {
+            _dia("Splicer::init: cannot set pipe size to %d: %s", params_t::pipe_size, string_error().c_str());
+        }
+    }
+
+    _deb("Splicer::init: pipe %d -> %d created", pipe_[1], pipe_[0]);
+    return true;
+}
+
+ssize_t Splicer::pull(int from_fd, bool ktls_rx) {
+
+    auto r = ::splice(from_fd, nullptr, pipe_[1], nullptr, params_t::max_chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if(r > 0) {
+        pending_ += static_cast<std::size_t>(r);
+        pulled_total_ += static_cast<std::size_t>(r);
+        _ext("Splicer::pull[%d]: %d bytes, pending %d", from_fd, r, pending_);
+        return r;
+    }
+    else if(r == 0) {
+        _dia("Splicer::pull[%d]: eof", from_fd);
+        return 0;
+    }
+
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+        return -1;
+    }
+
+    // kTLS socket refuses to splice non-data record (alert, post-handshake message)
+    if(ktls_rx and errno == EINVAL) {
+        _dia("Splicer::pull[%d]: record not spliceable", from_fd);
+        return -3;
+    }
+
+    _dia("Splicer::pull[%d]: error: %s", from_fd, string_error().c_str());
+    return -2;
+}
+
+ssize_t Splicer::push(int to_fd) {
+
+    ssize_t total = 0;
+
+    while(pending_ > 0) {
+        auto r = ::splice(pipe_[0], nullptr, to_fd, nullptr, pending_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if(r > 0) {
+            pending_ -= static_cast<std::size_t>(r);
+            pushed_total_ += static_cast<std::size_t>(r);
+            total += r;
+            continue;
+        }
+
+        if(r < 0 and errno != EAGAIN and errno != EWOULDBLOCK) {
+            _dia("Splicer::push[%d]: error: %s", to_fd, string_error().c_str());
+            return -2;
+        }
+
+        // target is full
+        break;
+    }
+
+    _ext("Splicer::push[%d]: %d bytes, pending %d", to_fd, total, pending_);
+    return total;
+}
+
+ssize_t Splicer::drain(unsigned char* buf, std::size_t len) {
+
+    if(pending_ == 0) return 0;
+
+    auto r = ::read(pipe_[0], buf, std::min(len, pending_));
+    if(r <= 0) {
+        _dia("Splicer::drain: error: %s", string_error().c_str());
+        return -2;
+    }
+
+    pending_ -= static_cast<std::size_t>(r);
+    _deb("Splicer::drain: %d bytes, pending %d", r, pending_);
+
+    return r;
+}
@@ -0,0 +1,81 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SPLICER_HPP
+#define SPLICER_HPP
+
+#include <cstddef>
+#include <sys/types.h>
+
+#include <log/logan.hpp>
+
+
+//! Kernel-side forwarding of one direction of a stream session.
+/*!
+ *  Splicer owns a non-blocking pipe which is used as an intermediate kernel buffer: pull() moves bytes
+ *  from a socket into the pipe, push() moves them from the pipe into another socket. Payload never enters
+ *  userspace, therefore it can be used only if nobody needs to see the data (no inspection, no logging).
+ *
+ *  Bytes which could not be pushed yet (target socket is full) are accounted in pending() and must be
+ *  flushed with push() once the target becomes writable.
+ */
+class Splicer {
+public:
+    Splicer() = default;
+    ~Splicer();
+
+    Splicer(Splicer const&) = delete;
+    Splicer& operator=(Splicer const&) = delete;
+
+    struct params_t {
+        static inline std::size_t pipe_size = 0;          // requested pipe capacity, 0 keeps the kernel default
+        static inline std::size_t max_chunk = 256*1024;   // maximum bytes moved by a single splice() call
+    };
+
+    /// @brief create the pipe. Returns false if pipe couldn't be created (ie. fd exhaustion).
+    bool init();
+    [[nodiscard]] bool valid() const noexcept { return pipe_[0] >= 0 and pipe_[1] >= 0; }
+
+    /// @brief move bytes from socket into the pipe. Set ktls_rx if socket's records are decrypted by kernel TLS.
+    /// @return number of bytes moved, 0 on EOF, -1 on EAGAIN (or full pipe), -2 on error,
+    ///         -3 if ktls_rx and next data can't be spliced (kernel TLS control record) and must be read by userspace
+    ssize_t pull(int from_fd, bool ktls_rx = false);
+
+    /// @brief move pending bytes from the pipe into socket.
+    /// @return number of bytes moved, 0 if target is not writable or nothing is pending, -2 on error
+    ssize_t push(int to_fd);
+
+    /// @brief read pending bytes back into userspace, used when splicing is abandoned.
+    /// @return number of bytes read, 0 if nothing is pending, -2 on error
+    ssize_t drain(unsigned char* buf, std::size_t len);
+
+    [[nodiscard]] std::size_t pending() const noexcept { return pending_; }
+    [[nodiscard]] std::size_t pulled_total() const noexcept { return pulled_total_; }
+    [[nodiscard]] std::size_t pushed_total() const noexcept { return pushed_total_; }
+
+private:
+    int pipe_[2] = { -1, -1 };
+    std::size_t pending_ = 0L;
+
+    std::size_t pulled_total_ = 0L;
+    std::size_t pushed_total_ = 0L;
+
+    logan_lite log {"com.splice"};
+};
+
+#endif //SPLICER_HPP
@@ -0,0 +1,220 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <sslcertdisk.hpp>
+#include <display.hpp>
+#include <log/logger.hpp>
+
+
+namespace {
+    constexpr uint32_t max_field_size = 64 * 1024;
+
+    bool pread_all(int fd, void* buf, std::size_t n, off_t offset) {
+        return ::pread(fd, buf, n, offset) == static_cast<ssize_t>(n);
+    }
+}
+
+CertDiskCache::~CertDiskCache() {
+    if(fd_ >= 0) ::close(fd_);
+}
+
+bool CertDiskCache::open() {
+    // called with lock_ held
+    if(opened_) return fd_ >= 0;
+    opened_ = true;
+
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(fd_ < 0) {
+        _err("CertDiskCache::open: cannot open %s: %s", path_.c_str(), string_error().c_str());
+        return false;
+    }
+
+    std::array<char, magic_sz> m {};
+    uint32_t gen_len = 0;
+    std::string gen;
+
+    if(pread_all(fd_, m.data(), magic_sz, 0)
+       and ::memcmp(m.data(), magic, magic_sz) == 0
+       and pread_all(fd_, &gen_len, sizeof(gen_len), magic_sz)
+       and gen_len == generation_.size()) {
+
+        gen.resize(gen_len);
+        if(pread_all(fd_, gen.data(), gen_len, magic_sz + sizeof(gen_len)) and gen == generation_) {
+            return scan();
+        }
+    }
+
+    _dia("CertDiskCache::open: %s: new file or different generation", path_.c_str());
+    return reset();
+}
+
+bool CertDiskCache::reset() {
+
+    ++stats_t::resets;
+    index_.clear();
+
+    std::string header(magic, magic_sz);
+    auto gen_len = static_cast<uint32_t>(generation_.size());
+    header.append(reinterpret_cast<char const*>(&gen_len), sizeof(gen_len));
+    header.append(generation_);
+
+    if(::ftruncate(fd_, 0) != 0 or ::pwrite(fd_, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+        _err("CertDiskCache::reset: cannot write %s: %s", path_.c_str(), string_error().c_str());
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    end_ = static_cast<off_t>(header.size());
+    return true;
+}
+
+bool CertDiskCache::scan() {
+
+    struct stat st {};
+    ::fstat(fd_, &st);
+
+    off_t offset = static_cast<off_t>(magic_sz + sizeof(uint32_t) + generation_.size());
+    std::string key;
+
+    while(true) {
+        lengths_t lens {};
+        if(not pread_all(fd_, lens.data(), sizeof(lens), offset)) break;
+
+        auto const [ key_len, der_len, pkey_len ] = lens;
+        if(key_len > max_field_size or der_len > max_field_size or pkey_len > max_field_size) break;
+
+        auto const next = offset + static_cast<off_t>(sizeof(lens) + key_len + der_len + pkey_len);
+        if(next > st.st_size) break;
+
+        key.resize(key_len);
+        if(not pread_all(fd_, key.data(), key_len, offset + static_cast<off_t>(sizeof(lens)))) break;
+
+        index_[key] = { offset + static_cast<off_t>(sizeof(lens) + key_len), der_len, pkey_len };
+        offset = next;
+    }
+
+    // drop incomplete record (ie. process was killed while writing)
+    if(offset < st.st_size) {
+        _not("CertDiskCache::scan: %s: dropping %d bytes of damaged tail", path_.c_str(), st.st_size - offset);
+        if(::ftruncate(fd_, offset) != 0) {
+            _err("CertDiskCache::scan: cannot truncate %s: %s", path_.c_str(), string_error().c_str());
+        }
+    }
+
+    end_ = offset;
+    _dia("CertDiskCache::scan: %s: %d records", path_.c_str(), index_.size());
+
+    return true;
+}
+
+X509* CertDiskCache::load(std::string const& key, EVP_PKEY** pkey) {
+
+    *pkey = nullptr;
+
+    auto l_ = std::scoped_lock(lock_);
+    if(not open()) return nullptr;
+
+    auto it = index_.find(key);
+    if(it == index_.end()) {
+        ++stats_t::misses;
+        return nullptr;
+    }
+
+    auto const& rec = it->second;
+    std::vector<unsigned char> der(rec.size + rec.pkey_size);
+    if(not pread_all(fd_, der.data(), der.size(), rec.offset)) {
+        ++stats_t::misses;
+        return nullptr;
+    }
+
+    unsigned char const* p = der.data();
+    X509* cert = d2i_X509(nullptr, &p, static_cast<long>(rec.size));
+
+    if(cert and rec.pkey_size > 0) {
+        p = der.data() + rec.size;
+        *pkey = d2i_AutoPrivateKey(nullptr, &p, static_cast<long>(rec.pkey_size));
+        if(not *pkey) {
+            X509_free(cert);
+            cert = nullptr;
+        }
+    }
+
+    if(cert and X509_cmp_current_time(X509_get0_notAfter(cert)) <= 0) {
+        _dia("CertDiskCache::load: '%s' expired", key.c_str());
+        X509_free(cert);
+        cert = nullptr;
+        EVP_PKEY_free(*pkey);
+        *pkey = nullptr;
+    }
+
+    if(not cert) {
+        index_.erase(it);
+        ++stats_t::misses;
+        return nullptr;
+    }
+
+    ++stats_t::hits;
+    return cert;
+}
+
+bool CertDiskCache::store(std::string const& key, X509* cert, EVP_PKEY* pkey) {
+
+    int der_len = i2d_X509(cert, nullptr);
+    int pkey_len = pkey ? i2d_PrivateKey(pkey, nullptr) : 0;
+
+    if(der_len <= 0 or pkey_len < 0 or key.size() > max_field_size
+       or static_cast<uint32_t>(der_len) > max_field_size or static_cast<uint32_t>(pkey_len) > max_field_size) return false;
+
+    lengths_t lens { static_cast<uint32_t>(key.size()), static_cast<uint32_t>(der_len), static_cast<uint32_t>(pkey_len) };
+
+    std::vector<unsigned char> rec(sizeof(lens) + key.size() + lens[1] + lens[2]);
+    ::memcpy(rec.data(), lens.data(), sizeof(lens));
+    ::memcpy(rec.data() + sizeof(lens), key.data(), key.size());
+
+    unsigned char* p = rec.data() + sizeof(lens) + key.size();
+    i2d_X509(cert, &p);
+    if(pkey) i2d_PrivateKey(pkey, &p);
+
+    auto l_ = std::scoped_lock(lock_);
+    if(not open()) return false;
+
+    if(static_cast<std::size_t>(end_) + rec.size() > params_t::max_file_size and not reset()) {
+        return false;
+    }
+
+    // single write: record is either complete, or dropped by the next scan
+    if(::pwrite(fd_, rec.data(), rec.size(), end_) != static_cast<ssize_t>(rec.size())) {
+        _err("CertDiskCache::store: cannot write %s: %s", path_.c_str(), string_error().c_str());
+        return false;
+    }
+
+    index_[key] = { end_ + static_cast<off_t>(sizeof(lens) + key.size()), lens[1], lens[2] };
+    end_ += static_cast<off_t>(rec.size());
+    ++stats_t::stored;
+
+    return true;
+}
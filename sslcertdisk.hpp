@@ -0,0 +1,95 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLCERTDISK_HPP
+#define SSLCERTDISK_HPP
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include <log/logan.hpp>
+
+//! Append-only file of spoofed certificates, surviving restarts.
+/*!
+ *  Records are DER encoded certificates (and their private key, if it's not the default one) stored under a string key. File header carries a generation
+ *  string (fingerprints of CA and of default server certificate): if it doesn't match the current one,
+ *  file is truncated and all records are gone. Index of records is built at the first use; certificate
+ *  itself is read and parsed only when it's looked up. Later record of the same key wins.
+ */
+class CertDiskCache {
+public:
+    struct params_t {
+        static inline std::atomic<std::size_t> max_file_size = 64 * 1024 * 1024;   // file is reset when exceeded
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> hits {0};
+        static inline std::atomic<std::size_t> misses {0};
+        static inline std::atomic<std::size_t> stored {0};
+        static inline std::atomic<std::size_t> resets {0};    // invalidated, or size limit reached
+    };
+
+    CertDiskCache(std::string path, std::string generation) : path_(std::move(path)), generation_(std::move(generation)) {};
+    ~CertDiskCache();
+
+    CertDiskCache(CertDiskCache const&) = delete;
+    CertDiskCache& operator=(CertDiskCache const&) = delete;
+
+    /// @brief return new certificate reference, or nullptr if not stored (or expired).
+    ///        Key is set to stored private key, or nullptr if default key should be used.
+    X509* load(std::string const& key, EVP_PKEY** pkey);
+    bool store(std::string const& key, X509* cert, EVP_PKEY* pkey = nullptr);
+
+    std::size_t size() { auto l_ = std::scoped_lock(lock_); open(); return index_.size(); }
+    std::string const& path() const { return path_; }
+
+private:
+    static constexpr const char* magic = "SOCLEMC2";
+    static constexpr std::size_t magic_sz = 8;
+
+    // record: key length, cert length, private key length, key, cert, private key
+    using lengths_t = std::array<uint32_t, 3>;
+
+    struct record_t {
+        off_t offset;           // of the certificate
+        uint32_t size;
+        uint32_t pkey_size;     // private key follows the certificate
+    };
+
+    bool open();
+    bool reset();
+    bool scan();
+
+    std::mutex lock_;
+    std::string const path_;
+    std::string const generation_;
+    int fd_ = -1;
+    bool opened_ = false;
+    off_t end_ = 0;
+    std::unordered_map<std::string, record_t> index_;
+
+    logan_lite log {"pki.store.disk"};
+};
+
+#endif //SSLCERTDISK_HPP
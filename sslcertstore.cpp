@@ -21,10 +21,14 @@
 #include <regex>
 #include <array>
 #include <filesystem>
+#include <utility>
 
 #include <display.hpp>
 #include <sslcertstore.hpp>
 #include <sslmitmcom.hpp>
+#include <sslkeypool.hpp>
+#include <sslcrlfetch.hpp>
+#include <mempool/mempool.hpp>
 
 #include <openssl/ssl.h>
 #include <openssl/ct.h>
@@ -69,7 +73,10 @@ bool SSLFactory::load_from_files() {
     
     OpenSSL_add_all_algorithms();
     
-    serial += time(nullptr);
+    serial_ += time(nullptr);
+
+    // CA or default key could change
+    mitm_disk_.reset();
 
     if (not (load_ca_cert() and load_def_cl_cert() and load_def_sr_cert())) {
         _dia("SSLFactory::load: key/certs: ca(%x/%x) def_cl(%x/%x) def_sr(%x/%x)", ca_key,ca_cert,
@@ -146,6 +153,31 @@ bool SSLFactory::update_ssl_ctx(CertificateChainCtx& chain, std::string_view iss
     return build_chain > 0;
 }
 
+// replace issuers with the chain built in chain's context and release the context
+void SSLFactory::take_ctx_chain(CertificateChainCtx& chain) {
+
+    STACK_OF(X509)* built = nullptr;
+    SSL_CTX_get0_chain_certs(chain.ctx, &built);
+
+    // built chain doesn't contain the root
+    if(built) {
+        for(auto& issuer: chain.chain.issuers) {
+            X509_free(issuer);
+            issuer = nullptr;
+        }
+
+        auto n = std::min(static_cast<std::size_t>(sk_X509_num(built)), CertificateChain::ISSUERS_SZ);
+        for(std::size_t i = 0; i < n; ++i) {
+            auto* x = sk_X509_value(built, static_cast<int>(i));
+            X509_up_ref(x);
+            chain.chain.issuers[i] = x;
+        }
+    }
+
+    SSL_CTX_free(chain.ctx);
+    chain.ctx = nullptr;
+}
+
 bool SSLFactory::load_certs_from(const char* sub_dir, const char* cache_key_prefix) {
     auto const& log = get_log();
     std::string const sub_path = certs_path() + sub_dir;
@@ -164,9 +196,11 @@ bool SSLFactory::load_certs_from(const char* sub_dir, const char* cache_key_pref
             auto path = entry.path().string();
             auto cert_pair = load_cert_pair(path + "/key.pem", path + "/cert.pem", nullptr);
             if (cert_pair) {
+                // context is needed only to check and order the chain, entry is applied per connection
                 cert_pair.value().ctx = server_ctx_setup(nullptr, nullptr);
 
                 update_ssl_ctx(cert_pair.value(), path + "/issuer.pem", path + "/issuer2.pem", path + "/issuer3.pem");
+                take_ctx_chain(cert_pair.value());
 
                 std::string key = cache_key_prefix;
                 key += entry.path().filename();
@@ -350,6 +384,12 @@ SSL_CTX* SSLFactory::client_ctx_setup(const char* ciphers) {
     SSL_CTX_set_options(ctx, ctx_options); //used to be also SSL_OP_NO_TICKET+
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_NO_INTERNAL);
 
+    if(upstream_sessions_) {
+        // pass every received session (each TLS 1.3 ticket) to the callback
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT|SSL_SESS_CACHE_NO_INTERNAL);
+        _dia("SSLFactory::client_ctx_setup: upstream session store on");
+    }
+
     SSL_CTX_sess_set_new_cb(ctx, SSLCom::new_session_callback);
 
     #ifdef USE_OPENSSL111
@@ -428,6 +468,16 @@ SSL_CTX* SSLFactory::server_ctx_setup(EVP_PKEY* priv, X509* cert, const char* ci
     // set server callback on internal cache miss
     SSL_CTX_sess_set_get_cb(ctx, SSLCom::server_get_session_callback);
 
+    if(shared_sessions_) {
+        // new sessions are passed to the callback only in server cache mode
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER|SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_sess_set_remove_cb(ctx, SSLCom::remove_session_callback);
+#ifdef USE_OPENSSL300
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, SSLCom::ticket_key_callback);
+#endif
+        _dia("SSLFactory::server_ctx_setup: shared session cache on");
+    }
+
     _deb("SSLCom::server_ctx_setup: loading default key/cert");
     priv == nullptr ? SSL_CTX_use_PrivateKey(ctx, def_sr_key) : SSL_CTX_use_PrivateKey(ctx,priv);
     cert == nullptr ? SSL_CTX_use_certificate(ctx, def_sr_cert) : SSL_CTX_use_certificate(ctx,cert);
@@ -596,6 +646,18 @@ SSLFactory& SSLFactory::init () {
         exit(3);
     }
 
+    if(options::shared_sessions) {
+        fac.shared_sessions_ = std::make_unique<SharedSessionCache>();
+        if(not fac.shared_sessions_->attach()) {
+            _err("SSLFactory::init: shared session cache not available");
+            fac.shared_sessions_.reset();
+        }
+    }
+
+    if(options::upstream_sessions) {
+        fac.upstream_sessions_ = std::make_unique<ResumptionStore>();
+    }
+
     fac.def_cl_ctx = fac.client_ctx_setup();
     fac.def_dtls_cl_ctx = fac.client_dtls_ctx_setup();
 
@@ -617,6 +679,8 @@ void SSLFactory::destroy() {
     auto lc_ = std::scoped_lock(lock());
     auto const& log = get_log();
 
+    mitm_disk_.reset();
+
     if(ca_cert) {
         _deb("SSLFactory::destroy: ca_cert");
 
@@ -686,7 +750,7 @@ bool SSLFactory::add_to_cache(SSLFactory::X509_CACHE &cache, std::string const&
     bool op_status = true;
 
     if (parek.chain.key == nullptr || parek.chain.cert == nullptr) {
-        _dia("SSLFactory::add_to_cache<%s>[%X]: one of about to be stored components is nullptr", cache.info.c_str() ,serial);
+        _dia("SSLFactory::add_to_cache<%s>[%X]: one of about to be stored components is nullptr", cache.info.c_str() ,serial_.load());
 
         return false;
     }
@@ -998,7 +1062,7 @@ std::optional<X509_REQ*> SSLFactory::sign_csr(X509_REQ*&& corpus) const {
     EVP_MD const* digest = EVP_sha256();
 
     if (!(X509_REQ_sign( own_corpus, pkey, digest))) {
-        _err("SSLFactory::spoof[%X]: error signing request", serial);
+        _err("SSLFactory::spoof[%X]: error signing request", serial_.load());
         return std::nullopt;
     }
 
@@ -1013,16 +1077,16 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
     auto* tmp = a_tmp.data();
 
 
-    _deb("SSLFactory::spoof[%X]: about to spoof certificate!", serial);
+    _deb("SSLFactory::spoof[%X]: about to spoof certificate!", serial_.load());
 
     if(self_sign) {
-        _dia("SSLFactory::spoof[%X]: about to spoof certificate (self-signed)!", serial);
+        _dia("SSLFactory::spoof[%X]: about to spoof certificate (self-signed)!", serial_.load());
     }
     if(additional_sans != nullptr && ! additional_sans->empty()) {
-        _dia("SSLFactory::spoof[%X]: about to spoof certificate (+sans):", serial);
+        _dia("SSLFactory::spoof[%X]: about to spoof certificate (+sans):", serial_.load());
         std::vector<std::string>const & sans = *additional_sans;
         for (auto const& san: sans) {
-            _dia("SSLFactory::spoof[%X]:  SAN: %s", serial, san.c_str());
+            _dia("SSLFactory::spoof[%X]:  SAN: %s", serial_.load(), san.c_str());
         }
     }
 
@@ -1034,7 +1098,7 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
     std::string subject(tmp);
 
 
-    _deb("SSLFactory::spoof[%X]: generating CSR for '%s'", serial, subject.c_str());
+    _deb("SSLFactory::spoof[%X]: generating CSR for '%s'", serial_.load(), subject.c_str());
 
     auto* copy = X509_REQ_new();
     X509_NAME* copy_subj = X509_NAME_new();
@@ -1045,12 +1109,12 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
     EVP_PKEY_free(pub_sr_cert);
 
     if( not copy) {
-        _err("SSLFactory::spoof[%X]: cannot init request", serial);
+        _err("SSLFactory::spoof[%X]: cannot init request", serial_.load());
         return std::nullopt;
     }
 
     if (not copy_subj) {
-        _err("SSLFactory::spoof[%X]: cannot init subject for request", serial);
+        _err("SSLFactory::spoof[%X]: cannot init subject for request", serial_.load());
         return std::nullopt;
     }
 
@@ -1064,7 +1128,7 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
     });
 
     if (X509_REQ_set_subject_name(copy, n_dup) != 1) {
-        _err("SSLFactory::spoof[%X]: error copying subject to request", serial);
+        _err("SSLFactory::spoof[%X]: error copying subject to request", serial_.load());
         return std::nullopt;
     }
 
@@ -1082,7 +1146,7 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
     std::string san_add;
     if(additional_sans != nullptr and not additional_sans->empty()) {
         san_add = string_csv(*additional_sans);
-        _dia("SSLFactory::spoof[%X]: additional sans = '%s'", serial, san_add.c_str());
+        _dia("SSLFactory::spoof[%X]: additional sans = '%s'", serial_.load(), san_add.c_str());
     }
 
     bool san_added = false;
@@ -1095,23 +1159,23 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
             for (int i=0; i < num_of_exts; i++) {
                 X509_EXTENSION *ex = sk_X509_EXTENSION_value(exts, i);
                 if(!ex) {
-                    _err("SSLFactory::spoof[%X]: error obtaining certificate extension [%d] value ", serial, i);
+                    _err("SSLFactory::spoof[%X]: error obtaining certificate extension [%d] value ", serial_.load(), i);
                     continue;
                 }
                 ASN1_OBJECT *obj = X509_EXTENSION_get_object(ex);
                 if(!obj) {
-                    _err("SSLFactory::spoof[%X]: unable to extract ASN1 object from extension [%d]", serial, i);
+                    _err("SSLFactory::spoof[%X]: unable to extract ASN1 object from extension [%d]", serial_.load(), i);
                     continue;
                 }
 
                 unsigned nid = OBJ_obj2nid(obj);
                 if(nid == NID_subject_alt_name) {
-                    _deb("SSLFactory::spoof[%X]: adding subjAltName to extensions", serial);
+                    _deb("SSLFactory::spoof[%X]: adding subjAltName to extensions", serial_.load());
 
 #ifdef USE_OPENSSL11
                     // it'ext_stack easier to get san list with different call, instead of diging it out from here.
                     std::string san = get_sans_csv(cert_orig);
-                    _deb("SSLFactory::spoof[%X]: original cert sans to be added: %ext_stack", serial, san.c_str());
+                    _deb("SSLFactory::spoof[%X]: original cert sans to be added: %ext_stack", serial_.load(), san.c_str());
 
 #else
 
@@ -1138,7 +1202,7 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
                     }
 
                     int a_r = add_ext(ext_stack, NID_subject_alt_name, san.data());
-                    _deb("SSLFactory::spoof[%X]: add_ext returned %d", serial, a_r);
+                    _deb("SSLFactory::spoof[%X]: add_ext returned %d", serial_.load(), a_r);
 
                     san_added = true;
                 }
@@ -1148,15 +1212,15 @@ std::optional<X509_REQ*> SSLFactory::create_csr_from(X509* cert_orig, bool self_
         if(not san_added) {
 
             int a_r = add_ext(ext_stack, NID_subject_alt_name, san_add.data());
-            _dum("SSLFactory::spoof[%X]: add_ext returned %d", serial, a_r);
+            _dum("SSLFactory::spoof[%X]: add_ext returned %d", serial_.load(), a_r);
 
         }
 
         int r = X509_REQ_add_extensions(copy, ext_stack);
-        _dum("SSLFactory::spoof[%X]: X509_REQ_add_extensions returned %d", serial, r);
+        _dum("SSLFactory::spoof[%X]: X509_REQ_add_extensions returned %d", serial_.load(), r);
     }
 
-    _deb("SSLFactory::spoof[%X]: generating CSR finished", serial);
+    _deb("SSLFactory::spoof[%X]: generating CSR finished", serial_.load());
 
     return sign_csr(std::move(copy));
 }
@@ -1166,19 +1230,19 @@ bool SSLFactory::validate_spoof_requirements(X509 const* cert, X509_NAME const*
 
     // init new certificate
     if (not cert) {
-        _err("SSLFactory::spoof[%X]: validate - error creating X509 object", serial);
+        _err("SSLFactory::spoof[%X]: validate - error creating X509 object", serial_.load());
         return false;
     }
     if (not cert_name) {
-        _err("SSLFactory::spoof[%X]: validate - subjectName cannot be extracted from CSR", serial);
+        _err("SSLFactory::spoof[%X]: validate - subjectName cannot be extracted from CSR", serial_.load());
         return false;
     }
     if (not issuer_name) {
-        _cri("SSLFactory::spoof[%X]: validate - subjectName cannot be extracted from CA!",  serial);
+        _cri("SSLFactory::spoof[%X]: validate - subjectName cannot be extracted from CA!",  serial_.load());
         return false;
     }
     if (not pkey) {
-        _err("SSLFactory::spoof[%X]: validate - error getting public key from request", serial);
+        _err("SSLFactory::spoof[%X]: validate - error getting public key from request", serial_.load());
         return false;
     }
 
@@ -1189,7 +1253,7 @@ std::optional<CertificateChainCtx> SSLFactory::spoof(X509* cert_orig, bool self_
 
     auto const& log = get_log();
 
-    ++serial;
+    long const serial = ++serial_;
     auto copy = create_csr_from(cert_orig, self_sign, additional_sans);
     if(not copy) {
 
@@ -1213,6 +1277,12 @@ std::optional<CertificateChainCtx> SSLFactory::spoof(X509* cert_orig, bool self_
             X509_REQ_free(copy.value());
     });
 
+    // own key for this certificate if pool has one ready, default server key otherwise
+    EVP_PKEY* leaf_key = options::unique_keys ? KeyPool::get().take() : nullptr;
+    auto g_leaf_key = raw::guard([&leaf_key]{
+        if(leaf_key) EVP_PKEY_free(leaf_key);
+    });
+
 
     // set version number for the certificate (X509v3) and then serial #
     if (X509_set_version (cert, 2L) != 1) {
@@ -1248,7 +1318,7 @@ std::optional<CertificateChainCtx> SSLFactory::spoof(X509* cert_orig, bool self_
         
     }
     // set public key in the certificate 
-    if ((X509_set_pubkey( cert, pkey)) != 1) {
+    if ((X509_set_pubkey( cert, leaf_key ? leaf_key : pkey)) != 1) {
         _err("SSLFactory::spoof[%X]: error setting public key of the certificate", serial);
         return std::nullopt;
     }
@@ -1296,7 +1366,7 @@ std::optional<CertificateChainCtx> SSLFactory::spoof(X509* cert_orig, bool self_
     EVP_PKEY* sign_key = ca_key;
     if(self_sign) {
       X509_set_issuer_name(cert, X509_get_subject_name(cert));
-      sign_key = def_sr_key;
+      sign_key = leaf_key ? leaf_key : def_sr_key;
     }
 
 
@@ -1306,10 +1376,61 @@ std::optional<CertificateChainCtx> SSLFactory::spoof(X509* cert_orig, bool self_
         return std::nullopt;
     }
 
+    if(leaf_key) {
+        return CertificateChainCtx(std::exchange(leaf_key, nullptr), cert);
+    }
+
+    EVP_PKEY_up_ref(def_sr_key);
     return CertificateChainCtx(def_sr_key, cert);
 }
 
 
+CertDiskCache* SSLFactory::mitm_disk() {
+
+    auto lc_ = std::scoped_lock(lock());
+
+    if(not mitm_disk_ and ca_cert and def_sr_cert) {
+        // spoofed certificates are signed by CA and most of them carry default server key
+        auto generation = fingerprint(ca_cert) + ":" + fingerprint(def_sr_cert);
+        mitm_disk_ = std::make_unique<CertDiskCache>(certs_path() + config_t::MITM_CACHE_F, generation);
+    }
+
+    return mitm_disk_.get();
+}
+
+std::optional<CertificateChainCtx> SSLFactory::spoof_or_load(std::string const& store_key, X509* cert_orig, bool self_sign, std::vector<std::string>* additional_sans) {
+
+    if(not options::disk_cache) return spoof(cert_orig, self_sign, additional_sans);
+
+    auto const& log = get_log();
+    auto* disk = mitm_disk();
+
+    // the same subject could be presented with a new certificate
+    auto const disk_key = store_key + "+fp:" + fingerprint(cert_orig);
+
+    if(disk) {
+        EVP_PKEY* key = nullptr;
+        if(auto* cert = disk->load(disk_key, &key); cert) {
+            _dia("SSLFactory::spoof_or_load: '%s' loaded from disk", store_key.c_str());
+
+            if(not key) {
+                key = def_sr_key;
+                EVP_PKEY_up_ref(key);
+            }
+            return CertificateChainCtx(key, cert);
+        }
+    }
+
+    auto ret = spoof(cert_orig, self_sign, additional_sans);
+    if(ret and disk) {
+        auto const& chain = ret.value().chain;
+        disk->store(disk_key, chain.cert, chain.key != def_sr_key ? chain.key : nullptr);
+    }
+
+    return ret;
+}
+
+
 int SSLFactory::convert_ASN1TIME(ASN1_TIME *t, char* buf, size_t len) {
     int rc;
     BIO *b = BIO_new(BIO_s_mem());
@@ -1552,7 +1673,14 @@ std::string SSLFactory::print_cert(X509* x, int indent, bool add_cr) {
             
 }
 
+SSLFactory::SSLFactory() {
+    // caches release their entries into memPool: it must be destroyed after the factory
+    memPool::pool();
+}
+
 SSLFactory::~SSLFactory() {
+    // background downloads fill crl_cache()
+    CrlFetcher::shutdown();
     destroy();
 }
 
@@ -33,12 +33,16 @@
 #include <ptr_cache.hpp>
 #include <mpstd.hpp>
 #include <sslcertval.hpp>
+#include <sslcertdisk.hpp>
+#include <sslsessionshm.hpp>
+#include <sslresume.hpp>
 #include <socle_size.hpp>
 
 #include <regex>
 #include <thread>
 #include <string>
 #include <optional>
+#include <memory>
 
 struct session_holder;
 
@@ -191,6 +195,8 @@ public:
         constexpr static const char* CA_CERTF = "ca-cert.pem";
         constexpr static const char* CA_KEYF =  "ca-key.pem";
 
+        constexpr static const char* MITM_CACHE_F = "mitm-cache.db";
+
         constexpr static const char* SNI_DIR =  "sni/";
         constexpr static const char* IP_DIR =  "ip/";
 
@@ -253,7 +259,8 @@ private:
     void is_ct_available(bool n) { is_ct_available_ = n; };
     bool is_ct_available_ = false;
     
-    long serial = 0xCABA1AL;
+    // spoofing may run concurrently in SpoofPool threads
+    std::atomic<long> serial_ = 0xCABA1AL;
     
     X509*     ca_cert = nullptr; // ca certificate
     EVP_PKEY* ca_key = nullptr;  // ca key to self-sign 
@@ -277,6 +284,7 @@ private:
     bool load_def_sr_cert();
     bool load_certs_from(const char* sub_dir, const char* cache_key_prefix);
     bool update_ssl_ctx(CertificateChainCtx& chain, std::string_view issuer1, std::string_view issuer2, std::string_view issuer3);
+    void take_ctx_chain(CertificateChainCtx& chain);
 
     std::regex re_hostname = std::regex("^[a-zA-Z0-9-]+\\.");
 
@@ -293,9 +301,19 @@ private:
 
     X509_STORE* trust_store_ = nullptr;
 
+    // spoofed certificates persisted in certs_path, created at first use
+    std::unique_ptr<CertDiskCache> mitm_disk_;
+    CertDiskCache* mitm_disk();
+
+    // server sessions and ticket keys shared with other workers, attached in init()
+    std::unique_ptr<SharedSessionCache> shared_sessions_;
+
+    // client sessions per destination, created in init()
+    std::unique_ptr<ResumptionStore> upstream_sessions_;
+
     mutable std::recursive_mutex mutex_cache_write_;
 
-    SSLFactory() = default;
+    SSLFactory();
 
 public:
     // avoid having copies of SSLFactory
@@ -352,6 +370,9 @@ public:
     session_cache_t& session_cache() { return session_cache_; }
     session_cache_t const& session_cache() const { return session_cache_; }
 
+    SharedSessionCache* shared_sessions() { return shared_sessions_.get(); }
+    ResumptionStore* upstream_sessions() { return upstream_sessions_.get(); }
+
 
     [[nodiscard]] inline SSL_CTX* default_tls_server_cx() const  { return def_sr_ctx; }
     [[nodiscard]] inline SSL_CTX* default_tls_client_cx() const  { return def_cl_ctx; }
@@ -364,9 +385,12 @@ public:
     // create CSR from original certificate
     std::optional<X509_REQ*> create_csr_from(X509* cert_orig, bool self_sign=false, std::vector<std::string>* additional_sans=nullptr);
 
-    // our killer feature here
+    // our killer feature here. Result holds a reference of both cert and key.
     [[nodiscard]] // discarding result will leak memory
     std::optional<CertificateChainCtx> spoof(X509* cert_orig, bool self_sign=false, std::vector<std::string>* additional_sans=nullptr);
+    // spoof, or load certificate spoofed before restart from disk cache (if enabled). Result is same as with spoof().
+    [[nodiscard]]
+    std::optional<CertificateChainCtx> spoof_or_load(std::string const& store_key, X509* cert_orig, bool self_sign=false, std::vector<std::string>* additional_sans=nullptr);
     bool validate_spoof_requirements(X509 const* cert, X509_NAME const* cert_name, X509_NAME const* issuer_name, EVP_PKEY const* pkey) const;
      
     static int convert_ASN1TIME(ASN1_TIME*, char*, size_t);
@@ -402,6 +426,15 @@ public:
         static inline int ocsp_status_ttl = 1800;
         static inline int crl_status_ttl = 86400;
         static inline bool ktls = true;
+        static inline bool ktls_splice = false;      // allow baseProxy splice between sessions offloaded to kernel TLS
+        static inline bool dynamic_records = true;   // record size by RecordSizer, otherwise always full records
+        static inline bool async_spoof = false;      // create missing spoofed certificates in SpoofPool
+        static inline bool disk_cache = false;       // persist spoofed certificates in certs_path
+        static inline bool unique_keys = false;      // spoofed certificate gets its own key from KeyPool
+        static inline bool shared_sessions = false;  // server sessions and ticket keys in SharedSessionCache
+        static inline bool upstream_sessions = false;  // client sessions (all received tickets) in ResumptionStore
+        static inline bool crl_async = false;        // download CRLs in CrlFetcher, status is unknown until done
+        static inline bool ocsp_cache = false;       // OCSP status in OcspCache: by certificate ID, single query per certificate, prefetch
     };
     static inline SSLFactory::options options_;
 
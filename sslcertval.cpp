@@ -22,6 +22,7 @@
 #include <sslcertstore.hpp>
 #include <log/logger.hpp>
 #include <buffer.hpp>
+#include <internet.hpp>
 #include <biostring.hpp>
 #include <socle.hpp>
 
@@ -229,6 +230,18 @@ namespace inet {
             return list;
         }
 
+        // responder address usable by BIO_new_connect(): resolved via shared DNS cache (any IP version),
+        // IPv6 in brackets so it's not confused with port. Empty if host cannot be resolved.
+        static std::string connect_address (std::string const& host) {
+            std::string ip = host;
+            if(not inet::is_ipv4_address(ip) and not inet::is_ipv6_address(ip)) {
+                auto ips = inet::dns_lookup(host, 0);
+                if(ips.empty()) return {};
+                ip = ips.front();
+            }
+            return inet::is_ipv6_address(ip) ? "[" + ip + "]" : ip;
+        }
+
 
         int ocsp_prepare_request (OCSP_REQUEST **req, X509 *cert, const EVP_MD *cert_id_md, X509 *issuer,
                                   STACK_OF(OCSP_CERTID) *ids) {
@@ -369,7 +382,11 @@ namespace inet {
                                           int req_timeout) {
             BIO *cbio = nullptr;
             OCSP_RESPONSE *resp = nullptr;
-            cbio = BIO_new_connect(host);
+
+            // resolve via shared DNS cache, Host header still carries the name
+            std::string target = connect_address(host);
+            if(target.empty()) target = host;
+            cbio = BIO_new_connect(target.c_str());
 
             auto const& log = OcspFactory::log();
 
@@ -737,7 +754,13 @@ namespace inet {
                     continue;
                 }
 
-                std::string host_port = ocsp_host;
+                // resolve via shared DNS cache, Host header still carries the name
+                std::string host_port = connect_address(ocsp_host);
+                if(host_port.empty()) {
+                    _dia("OcspQuery::do_prepare_target[0x%lx]: cannot resolve %s", ref_id, ocsp_host.c_str());
+                    continue;
+                }
+
                 if (!ocsp_port.empty()) {
                     //BIO_set_conn_port(conn_bio, ocsp_port.c_str());
                     host_port += ":" + ocsp_port;
@@ -37,6 +37,9 @@
 #include <tcpcom.hpp>
 #include <udpcom.hpp>
 #include <sslcertstore.hpp>
+#include <sslcrlfetch.hpp>
+#include <sslocspcache.hpp>
+#include <sslrecord.hpp>
 #include <sslcertval.hpp>
 #include <log/logger.hpp>
 
@@ -258,6 +261,7 @@ protected:
     X509*     sslcom_pref_cert = nullptr;
     EVP_PKEY* sslcom_pref_key  = nullptr;
     SSL_CTX * sslcom_pref_ctx  = nullptr;
+    CertificateChain::array_issuers sslcom_pref_issuers {};   // sent along with preferred cert, not owned
 
 #ifndef USE_OPENSSL300
     //ECDH parameters
@@ -278,6 +282,13 @@ protected:
     //handshake pending flag
 	bool sslcom_waiting=true;
 
+    // directions offloaded to kernel TLS, as found when handshake finished
+    unsigned int ktls_dirs_ = 0;
+
+    RecordSizer record_sizer_;
+    // length of SSL_write_ex which didn't complete, its retry must not be shorter
+    std::size_t write_retry_len_ = 0;
+
     // fatal signalling - no SSL_Shutdown must be called
     bool sslcom_fatal=false;
     
@@ -430,11 +441,38 @@ public:
     void log_profiling_stats(unsigned int level);
     
 	virtual bool check_cert(const char*);
+    // true while server certificate is not ready yet (it's being spoofed), handshake doesn't start meanwhile;
+    // implementation wakes up the proxy once the certificate is ready
+    virtual bool cert_pending() { return false; }
     virtual bool store_session_if_needed();
     virtual bool load_session_if_needed();
+    // client side sessions in the factory ResumptionStore
+    std::string upstream_key() const;
+    bool store_upstream_session(SSL_SESSION* session);
 	
 	bool readable (int s) override;
 	bool writable (int s) override;
+    // kernel TLS: records are encrypted/decrypted by kernel if offloaded
+    enum ktls_dir_t : unsigned int { KTLS_TX = 0x1, KTLS_RX = 0x2 };
+    unsigned int ktls_offload() const;
+    unsigned int ktls_dirs() const { return ktls_dirs_; }
+    void ktls_report();
+
+    struct ktls_stats_t {
+        static inline std::atomic<std::size_t> sessions {0};
+        static inline std::atomic<std::size_t> tx {0};
+        static inline std::atomic<std::size_t> rx {0};
+    };
+
+    // TLS payload can bypass userspace only if kernel does both encryption and decryption
+    bool spliceable() const override;
+    bool ktls_rx() const override { return not opt.bypass and (ktls_offload() & KTLS_RX); }
+    // sends close_notify
+    void shutdown_write(int _fd) override;
+    // SSL_write copies into record anyway, zerocopy is only for bypassed (plain) sessions
+    bool zerocopy_wanted(int _fd, std::size_t len) override { return opt.bypass and L4Proto::zerocopy_wanted(_fd, len); }
+    // post-handshake messages (session tickets, key update) don't count as unread data
+    bool idle_alive(int _fd) override;
 	
 	void accept_socket (int sockfd) override;
     void delay_socket (int sockfd) override;
@@ -565,6 +603,10 @@ public:
 
     static SSL_SESSION *server_get_session_callback(SSL *ssl, const unsigned char *, int, int *);
     static int new_session_callback(SSL *ssl, SSL_SESSION *session);
+    static void remove_session_callback(SSL_CTX *ctx, SSL_SESSION *session);
+    #ifdef USE_OPENSSL300
+    static int ticket_key_callback(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc);
+    #endif
     static void ssl_keylog_callback(const SSL *ssl, const char *line);
     static void ssl_msg_callback(int write_p, int version, int content_type, const void *buf, size_t len, SSL *ssl, void *arg);
     static void ssl_info_callback(const SSL *s, int where, int ret);
@@ -113,13 +113,93 @@ std::string baseSSLCom<L4Proto>::to_string(int verbosity) const {
     ss << "sni:" << get_sni() << " alpn: " << sslcom_alpn_;
 
     if(opt.bypass) ss << " bypassed";
+    if(ktls_dirs_ & KTLS_TX) ss << " ktls-tx";
+    if(ktls_dirs_ & KTLS_RX) ss << " ktls-rx";
 
     return ss.str().c_str();
 }
 
+template <class L4Proto>
+unsigned int baseSSLCom<L4Proto>::ktls_offload() const {
+
+    unsigned int ret = 0;
+
+#ifndef OPENSSL_NO_KTLS
+    if(sslcom_ssl) {
+        if(auto* wbio = SSL_get_wbio(sslcom_ssl); wbio and BIO_get_ktls_send(wbio)) ret |= KTLS_TX;
+        if(auto* rbio = SSL_get_rbio(sslcom_ssl); rbio and BIO_get_ktls_recv(rbio)) ret |= KTLS_RX;
+    }
+#endif
+
+    return ret;
+}
+
+template <class L4Proto>
+void baseSSLCom<L4Proto>::ktls_report() {
+
+    if(not SSLFactory::options::ktls) return;
+
+    ktls_dirs_ = ktls_offload();
+
+    ++ktls_stats_t::sessions;
+    if(ktls_dirs_ & KTLS_TX) ++ktls_stats_t::tx;
+    if(ktls_dirs_ & KTLS_RX) ++ktls_stats_t::rx;
+
+    _dia("SSLCom::ktls_report[%d]: kernel TLS tx: %s, rx: %s", socket(),
+                ktls_dirs_ & KTLS_TX ? "offloaded" : "no",
+                ktls_dirs_ & KTLS_RX ? "offloaded" : "no");
+}
+
+template <class L4Proto>
+void baseSSLCom<L4Proto>::shutdown_write(int _fd) {
+
+    if(opt.bypass or sslcom_waiting or sslcom_fatal or not sslcom_ssl) {
+        L4Proto::shutdown_write(_fd);
+        return;
+    }
+
+    if(not (SSL_get_shutdown(sslcom_ssl) & SSL_SENT_SHUTDOWN)) {
+        SSL_shutdown(sslcom_ssl);
+    }
+}
+
+template <class L4Proto>
+bool baseSSLCom<L4Proto>::idle_alive(int _fd) {
+
+    if(opt.bypass) return L4Proto::idle_alive(_fd);
+
+    if(sslcom_waiting or sslcom_fatal or not sslcom_ssl or _fd <= 0) return false;
+    if(SSL_get_shutdown(sslcom_ssl) != 0) return false;
+
+    // peek processes handshake records waiting in socket, but leaves application data unread
+    unsigned char b = 0;
+    ERR_clear_error();
+    auto r = SSL_peek(sslcom_ssl, &b, 1);
+    if(r > 0) {
+        _dia("SSLCom::idle_alive[%d]: unexpected data", _fd);
+        return false;
+    }
+
+    return SSL_get_error(sslcom_ssl, r) == SSL_ERROR_WANT_READ;
+}
+
+template <class L4Proto>
+bool baseSSLCom<L4Proto>::spliceable() const {
+
+    // plain TCP underneath
+    if(opt.bypass) return L4Proto::spliceable();
+
+    if(not SSLFactory::options::ktls_splice or sslcom_waiting or sslcom_fatal or not sslcom_ssl) return false;
+
+    // anything already decrypted by openssl must be read by SSL_read
+    if(SSL_has_pending(sslcom_ssl)) return false;
+
+    return ktls_offload() == (KTLS_TX | KTLS_RX);
+}
+
 // server callback on internal cache miss
 template <class L4Proto>
-SSL_SESSION* baseSSLCom<L4Proto>::server_get_session_callback(SSL* ssl, const unsigned char* , int, int* ) {
+SSL_SESSION* baseSSLCom<L4Proto>::server_get_session_callback(SSL* ssl, const unsigned char* sid, int sid_len, int* copy) {
     SSL_SESSION* ret = nullptr;
 
     auto const& log = log_cb_session();
@@ -132,13 +212,54 @@ SSL_SESSION* baseSSLCom<L4Proto>::server_get_session_callback(SSL* ssl, const un
     }
 
     _inf("lookup server session[%s]: SSL: 0x%x", name.c_str(), ssl);
+
+    if(auto* shared = SSLFactory::factory().shared_sessions(); shared) {
+        ret = shared->load(sid, static_cast<unsigned int>(sid_len));
+
+        // reference from load() is handed over to openssl
+        *copy = 0;
+        _dia("lookup server session[%s]: shared cache %s", name.c_str(), ret ? "hit" : "miss");
+    }
+
     return ret;
 }
+
+template <class L4Proto>
+void baseSSLCom<L4Proto>::remove_session_callback(SSL_CTX*, SSL_SESSION* session) {
+
+    if(auto* shared = SSLFactory::factory().shared_sessions(); shared) {
+        unsigned int sid_len = 0;
+        auto const* sid = SSL_SESSION_get_id(session, &sid_len);
+        shared->remove(sid, sid_len);
+    }
+}
+
+#ifdef USE_OPENSSL300
+template <class L4Proto>
+int baseSSLCom<L4Proto>::ticket_key_callback(SSL*, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc) {
+
+    if(auto* shared = SSLFactory::factory().shared_sessions(); shared) {
+        return shared->ticket_key(key_name, iv, cctx, hctx, enc);
+    }
+    return 0;
+}
+#endif
+
 template <class L4Proto>
 int baseSSLCom<L4Proto>::new_session_callback(SSL* ssl, SSL_SESSION* session) {
 
     auto const& log = log_cb_session();
 
+    if(SSL_is_server(ssl)) {
+        if (auto* shared = SSLFactory::factory().shared_sessions(); shared) {
+            _dia("new session: SSL: 0x%x, SSL_SESSION: 0x%x, storing to shared cache", ssl, session);
+            shared->store(session);
+
+            // shared cache keeps its own serialized copy
+            return 0;
+        }
+    }
+
     void* data = SSL_get_ex_data(ssl, baseSSLCom::extdata_index());
     std::string name = "unknown_cx";
     auto* com = static_cast<baseSSLCom*>(data);
@@ -153,6 +274,10 @@ int baseSSLCom<L4Proto>::new_session_callback(SSL* ssl, SSL_SESSION* session) {
             return 0;
         }
 
+        if(not com->is_server() and com->factory()->upstream_sessions()) {
+            // store takes over the reference
+            return com->store_upstream_session(session) ? 1 : 0;
+        }
 
         if(com->store_session_if_needed()) {
 
@@ -829,9 +954,20 @@ int baseSSLCom<L4Proto>::certificate_status_ocsp_check(baseSSLCom* com) {
         const char* str_status = "unknown";
 
 
-        auto cached_result = com->factory()->verify_cache().get(cn);;
-
-        if (cached_result) {
+        if(SSLFactory::options::ocsp_cache) {
+            auto& ocsp_cache = OcspCache::get();
+            if(auto cached = ocsp_cache.lookup(com->sslcom_target_cert, com->sslcom_target_issuer); cached) {
+                res = cached.value();
+                str_status = str_cached;
+                origin = verify_origin_t::OCSP_CACHE;
+            }
+            else {
+                res = ocsp_cache.query(com->sslcom_target_cert, com->sslcom_target_issuer);
+                str_status = str_fresh;
+                origin = verify_origin_t::OCSP;
+            }
+        }
+        else if (auto cached_result = com->factory()->verify_cache().get(cn); cached_result) {
             res.revoked = cached_result->value().revoked;
             str_status = str_cached;
             origin = verify_origin_t::OCSP_CACHE;
@@ -869,27 +1005,40 @@ int baseSSLCom<L4Proto>::certificate_status_ocsp_check(baseSSLCom* com) {
 
             std::vector<std::string> crls = inet::crl::crl_urls(com->sslcom_target_cert);
 
-            X509_CRL* crl_struct = nullptr;
-
-
-            auto lc_ = std::scoped_lock(com->factory()->crl_cache().getlock());
-            for(auto crl_url: crls) {
+            for(auto const& crl_url: crls) {
 
                 std::string crl_printable = printable(crl_url);
+
+                // entry is kept alive by its shared pointer even if replaced in the cache meanwhile
+                X509_CRL* crl_struct = nullptr;
+                X509_CRL* crl_owned = nullptr;
+                auto free_owned = raw::guard([&crl_owned]() { if(crl_owned) X509_CRL_free(crl_owned); });
                 auto crl_cache_entry = factory()->crl_cache().get(crl_url);
+                if(crl_cache_entry and crl_cache_entry->expired()) {
+                    crl_cache_entry.reset();
+                }
 
                 if(crl_cache_entry != nullptr) {
-                    auto crl_struct_e = crl_cache_entry->value()->ptr;
+                    crl_struct = crl_cache_entry->value()->ptr;
                     _dia("found cached crl: %s",crl_printable.c_str());
                     str_status = str_cached;
 
                     // we have crl cached, but it points to null (we indicate failed download)
-                    if(!crl_struct_e) {
+                    if(!crl_struct) {
                         _war("failed download was cached for crl: %s, waiting for expire", crl_printable.c_str());
                     }
 
+                    if(SSLFactory::options::crl_async) {
+                        CrlFetcher::get().touch(crl_url);
+                    }
+
                     origin = verify_origin_t::CRL_CACHE;
                 }
+                else if(SSLFactory::options::crl_async) {
+                    // don't wait, status is unknown until CRL is downloaded
+                    _dia("Connection from %s: CRL %s not cached, download requested", name.c_str(), crl_printable.c_str());
+                    CrlFetcher::get().request(crl_url);
+                }
                 else {
                     _dia("crl not cached: %s",crl_printable.c_str());
 
@@ -898,37 +1047,17 @@ int baseSSLCom<L4Proto>::certificate_status_ocsp_check(baseSSLCom* com) {
 
                     _dia("Connection from %s: downloading CRL at %s)",name.c_str(),crl_printable.c_str());
 
-                    buffer b;
-                    bool dnld_failed = false;
-                    int bytes = inet::download(crl_url.c_str(),b,tolerated_dnld_time*3);
-                    if(bytes < 0) dnld_failed = true;
+                    // cache is not locked for the download, other connections may download the same CRL
+                    crl_struct = CrlFetcher::fetch(crl_url);
+                    str_status = str_fresh;
 
-                    if(! dnld_failed ) {
-                        time_t t_dif = ::time(nullptr) - start;
-
-                        int crl_size = b.size();
-                        _dia("CRL downloaded: size %d bytes in %d seconds",crl_size,t_dif);
-                        if(t_dif > tolerated_dnld_time) {
+                    if(crl_struct) {
+                        crl_owned = crl_struct;
+                        if(::time(nullptr) - start > tolerated_dnld_time) {
                             _war("it took long time to download CRL. You should consider to disable CRL check :(");
                         }
-
-                        crl_struct = inet::crl::crl_from_bytes(b);
-                        str_status = str_fresh;
-
-
-                        if(crl_struct) {
-
-                            _dia("Caching CRL 0x%x", crl_struct);
-                            factory()->crl_cache().set(crl_url.c_str(), SSLFactory::make_expiring_crl(crl_struct));
-                            // but because we are locked, we are happy to overwrite it!
-                        }
-                    } else {
-                        _war("downloading CRL from %s failed.",crl_printable.c_str());
-                        factory()->crl_cache().set(crl_url.c_str(), SSLFactory::make_expiring_crl(nullptr));
                     }
-
                 }
-                // all control-paths are locked now
 
                 int is_revoked_by_crl = -1;
 
@@ -1818,6 +1947,20 @@ void baseSSLCom<L4Proto>::init_server() {
             _dia("    private key error: %s",ERR_error_string(err, nullptr));
         }
 
+        // chain is set per connection too, shared context stays untouched
+        if(std::any_of(sslcom_pref_issuers.begin(), sslcom_pref_issuers.end(), [](auto const* x) { return x != nullptr; })) {
+            STACK_OF(X509)* chain = sk_X509_new_null();
+            for(auto* issuer: sslcom_pref_issuers) {
+                if(issuer) sk_X509_push(chain, issuer);
+            }
+
+            if(SSL_set1_chain(sslcom_ssl, chain) != 1) {
+                int err = static_cast<int>(ERR_get_error());
+                _dia("    chain error: %s",ERR_error_string(err, nullptr));
+            }
+            sk_X509_free(chain);
+        }
+
 
         if(!sslcom_refcount_incremented_) {
 #ifdef USE_OPENSSL11
@@ -1971,11 +2114,10 @@ void baseSSLCom<L4Proto>::accept_socket (int sockfd) {
         if (l4com) {
             _inf("underlying com is UDPCom using virtual sockets");
 
-            auto it_rec = l4com->datagram_com()->datagrams_received.find(sockfd);
-            if (it_rec != l4com->datagram_com()->datagrams_received.end()) {
+            auto record = l4com->datagram_com()->datagrams_received.find(sockfd);
+            if (record) {
                 _deb("datagram records found");
 
-                auto record = it_rec->second;
                 socket(::socket(record->dst_family(), SOCK_DGRAM, IPPROTO_UDP));
 
                 if(socket() > 0) {
@@ -2039,6 +2181,7 @@ void baseSSLCom<L4Proto>::accept_socket (int sockfd) {
         _dia("SSLCom::accept_socket[%d]: success at 1st attempt.", sockfd);
         counters.prof_accept_ok++;
         sslcom_waiting = false;
+        ktls_report();
 
         // reread socket
         forced_read(true);
@@ -2309,6 +2452,11 @@ ret_handshake baseSSLCom<L4Proto>::handshake() {
     if (!is_server() ) {
         op_descr = op_connect;
 
+        // transport is not connecting yet, hostname is being resolved
+        if(L4Proto::resolving()) {
+            return ret_handshake::AGAIN;
+        }
+
         if(! handshake_peer_client() ) {
             _dia("SSLCom::handshake: %s on socket %d: waiting for the peer...", op_descr, socket());
 
@@ -2326,6 +2474,15 @@ ret_handshake baseSSLCom<L4Proto>::handshake() {
     }
     else {
         op_descr = op_accept;
+
+        // park socket until the certificate to present is created, job notification resumes it
+        if(cert_pending()) {
+            _dia("SSLCom::handshake: %s on socket %d: waiting for the certificate...", op_descr, socket());
+            unset_monitor(socket());
+
+            return ret_handshake::AGAIN;
+        }
+
         op_code = handshake_server();
     }
 
@@ -2436,6 +2593,7 @@ ret_handshake baseSSLCom<L4Proto>::handshake() {
 
     _dia("SSLCom::handshake: %s finished on socket %d", op_descr, socket());
     sslcom_waiting = false;
+    ktls_report();
 
     return ret_handshake::AGAIN;
 }
@@ -2509,6 +2667,10 @@ bool baseSSLCom<L4Proto>::store_session_if_needed() {
                 }
                 return ret;
             }
+            if(factory()->upstream_sessions()) {
+                _deb("ticketing: key %s: received sessions are stored by new session callback", key.c_str());
+                return false;
+            }
             if(verify_bitcheck(verify_status_t::VRF_OK)) {
 
                 auto lc_ = std::scoped_lock(factory()->session_cache().getlock() );
@@ -2577,6 +2739,30 @@ bool baseSSLCom<L4Proto>::store_session_if_needed() {
 }
 
 
+template <class L4Proto>
+std::string baseSSLCom<L4Proto>::upstream_key() const {
+    std::string alpn = opt.alpn_block ? std::string() : sslcom_peer_hello_alpn_;
+    return ResumptionStore::make_key(owner_cx()->host(), owner_cx()->port(), sslcom_sni_, alpn);
+}
+
+template <class L4Proto>
+bool baseSSLCom<L4Proto>::store_upstream_session(SSL_SESSION* session) {
+
+    if(opt.right.no_tickets or not owner_cx() or l4_proto() != SOCK_STREAM) return false;
+
+    // same trust rule as for sessions cache: only crystal OK servers are resumed
+    if(verify_get() != verify_status_t::VRF_OK and not SSL_session_reused(sslcom_ssl)) {
+        _dia("ticketing: upstream session not stored due to verify result 0x%04x", verify_get());
+        return false;
+    }
+
+    auto key = upstream_key();
+    factory()->upstream_sessions()->put(key, session);
+    _dia("ticketing: key %s: upstream session stored", key.c_str());
+
+    return true;
+}
+
 template <class L4Proto>
 bool baseSSLCom<L4Proto>::load_session_if_needed() {
 
@@ -2590,6 +2776,20 @@ bool baseSSLCom<L4Proto>::load_session_if_needed() {
     bool proceed  = is_server() ? !opt.left.no_tickets : !opt.right.no_tickets;
     std::string pref = is_server() ? "l-" : "r-";
 
+    if(proceed and not is_server() and l4_proto() == SOCK_STREAM and factory() and factory()->upstream_sessions() and owner_cx()) {
+        auto key = upstream_key();
+        auto* sess = factory()->upstream_sessions()->take(key);
+        SSL_set_session(sslcom_ssl, sess);
+
+        if(sess) {
+            _dia("ticketing: key %s: upstream session found", key.c_str());
+            SSL_SESSION_free(sess);
+            return true;
+        }
+        _dia("ticketing: key %s: upstream session not found", key.c_str());
+        return false;
+    }
+
     if(proceed and factory() && owner_cx()) {
         std::string current_sni;
 
@@ -3294,33 +3494,59 @@ ssize_t baseSSLCom<L4Proto>::write (int _fd, const void* _buf, size_t _n, int _f
     }
 
     sslcom_write_blocked_on_read=0;
-    int normalized__n = 20480;
-    void *ptr = (void*)_buf;
 
     if(_n == 0) {
         _ext("SSLCom::write[%d]: attempt to send %d bytes", _fd, _n);
     } else {
         _deb("SSLCom::write[%d]: attempt to send %d bytes", _fd, _n);
     }
-    if (_n < 20480) {
-        normalized__n = _n;
-    }
 
     if (_n <= 0 ) {
         return 0;
     }
 
-    /* Try to write */
+    /* Try to write: one record per SSL_write_ex (partial write mode), until burst is written or socket is full.
+       DTLS datagram is written as a single record to keep its boundaries. */
+    bool const stream = l4_proto() == SOCK_STREAM;
+
+    if(not stream and _n > RecordSizer::params_t::full_record) {
+        _err("SSLCom::write[%d]: datagram of %d bytes doesn't fit single record, rejected", _fd, _n);
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    auto const now = RecordSizer::clock::now();
+    std::size_t const burst = stream ? std::min(_n, RecordSizer::params_t::write_burst.load()) : _n;
+    std::size_t total = 0;
+    int write_ok = 1;
+
     ERR_clear_error();
-    sslcom_ret = SSL_write (sslcom_ssl, ptr, normalized__n);
+    while(total < burst) {
+        std::size_t record = stream and SSLFactory::options::dynamic_records ? record_sizer_.record_size(now)
+                                                                             : RecordSizer::params_t::full_record.load();
+        record = std::min(std::max(record, write_retry_len_), _n - total);
 
-    if(sslcom_ret >= normalized__n) {
-        forced_write(true);
+        std::size_t written = 0;
+        write_ok = SSL_write_ex(sslcom_ssl, static_cast<uint8_t const*>(_buf) + total, record, &written);
+        counters.prof_write_cnt++;
+
+        if(write_ok <= 0) {
+            write_retry_len_ = record;
+            break;
+        }
+
+        write_retry_len_ = 0;
+        record_sizer_.on_record(written, now);
+        total += written;
     }
 
-    counters.prof_write_cnt++;
+    if(total >= burst) {
+        forced_write(true);
+    }
 
-    int err = SSL_get_error (sslcom_ssl, sslcom_ret);
+    // records already written make this call successful, failed one is repeated by next call
+    sslcom_ret = total > 0 ? static_cast<int>(total) : write_ok;
+    int err = total > 0 ? SSL_ERROR_NONE : SSL_get_error (sslcom_ssl, write_ok);
     bool is_problem = true;
     bool apply_error_timer = false;
 
@@ -3362,13 +3588,7 @@ ssize_t baseSSLCom<L4Proto>::write (int _fd, const void* _buf, size_t _n, int _f
             // trigger write again
             master()->poller.modify(_fd, EPOLLIN | EPOLLOUT);
             sslcom_write_blocked_on_write=1;
-
-            if (sslcom_ret > 0) {
-                normalized__n = normalized__n - sslcom_ret;
-                ptr = static_cast<uint8_t*>(ptr) + sslcom_ret;
-            } else {
-                _dum("SSLCom::write[%d]: want write: repeating last operation", _fd);
-            }
+            _dum("SSLCom::write[%d]: want write: repeating last operation", _fd);
 
             counters.write_want_write_cur++;
             counters.prof_want_write_cnt++;
@@ -3431,6 +3651,13 @@ ssize_t baseSSLCom<L4Proto>::write (int _fd, const void* _buf, size_t _n, int _f
         return 0;
     }
 
+    if(write_ok <= 0) {
+        // partially written: the rest of failed record waits in openssl for socket to become writable,
+        // an error of the failed record is reported by the next call, which repeats it
+        _dia("SSLCom::write[%d]: record after %d bytes failed: %d", _fd, sslcom_ret, SSL_get_error(sslcom_ssl, write_ok));
+        set_write_monitor(socket());
+    }
+
     _dia("SSLCom::write[%d]: %4d bytes written", _fd, sslcom_ret);
     return sslcom_ret;
 }
@@ -3559,6 +3786,7 @@ int baseSSLCom<L4Proto>::upgrade_client_socket(int sock) {
 
         _deb("SSLCom::upgrade_client_socket[%d]: connection succeeded",sock);
         sslcom_waiting = false;
+        ktls_report();
         
         // restore peer monitoring
         monitor_peer();
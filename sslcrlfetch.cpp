@@ -0,0 +1,216 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <sys/eventfd.h>
+
+#include <sslcrlfetch.hpp>
+#include <internet.hpp>
+#include <mempool/mempool.hpp>
+
+#include <chrono>
+
+CrlFetcher::CrlFetcher() {
+    // downloads and cache entries use memPool: it must be destroyed after this object
+    memPool::pool();
+
+    stop_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    instance_ = this;
+}
+
+CrlFetcher::~CrlFetcher() {
+    stop();
+    instance_ = nullptr;
+
+    if(stop_fd_ >= 0) ::close(stop_fd_);
+}
+
+void CrlFetcher::shutdown() {
+    if(auto* f = instance_.load(); f) f->stop();
+}
+
+void CrlFetcher::stop() {
+    {
+        auto l_ = std::scoped_lock(lock_);
+        if(stop_ and workers_.empty()) return;
+
+        stop_ = true;
+        queue_.clear();
+    }
+
+    // stays readable: every running download sees it
+    if(stop_fd_ >= 0) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto w = ::write(stop_fd_, &one, sizeof(one));
+    }
+    cv_.notify_all();
+
+    for(auto& t: workers_) {
+        if(t.joinable()) t.join();
+    }
+    workers_.clear();
+
+    auto const& log = get_log();
+    _dia("CrlFetcher::stop: workers stopped");
+}
+
+void CrlFetcher::start() {
+    // called with lock_ held
+    if(not workers_.empty()) return;
+
+    auto const& log = get_log();
+
+    auto n = std::max(1U, params_t::threads.load());
+    for(unsigned int i = 0; i < n; ++i) {
+        workers_.emplace_back([this]() { worker(); });
+    }
+    _dia("CrlFetcher::start: %d threads", n);
+}
+
+void CrlFetcher::request(std::string const& url) {
+
+    auto const& log = get_log();
+    {
+        auto l_ = std::scoped_lock(lock_);
+        if(stop_) return;
+
+        known_[url].used = ::time(nullptr);
+
+        if(inflight_.find(url) != inflight_.end()) {
+            ++stats_t::joined;
+            return;
+        }
+
+        start();
+        inflight_.insert(url);
+        queue_.push_back(url);
+    }
+    cv_.notify_one();
+
+    ++stats_t::requested;
+    _dia("CrlFetcher::request: queued %s", printable(url).c_str());
+}
+
+void CrlFetcher::touch(std::string const& url) {
+    auto l_ = std::scoped_lock(lock_);
+    known_[url].used = ::time(nullptr);
+}
+
+bool CrlFetcher::pending(std::string const& url) {
+    auto l_ = std::scoped_lock(lock_);
+    return inflight_.find(url) != inflight_.end();
+}
+
+X509_CRL* CrlFetcher::fetch(std::string const& url, int cancel_fd) {
+
+    auto const& log = get_log();
+    auto& cache = SSLFactory::factory().crl_cache();
+    auto const url_printable = printable(url);
+
+    time_t start = ::time(nullptr);
+
+    buffer b;
+    X509_CRL* crl = nullptr;
+    if(inet::download(url, b, params_t::download_timeout, 4, cancel_fd) >= 0) {
+        crl = inet::crl::crl_from_bytes(b);
+    }
+
+    if(not crl and inet::cancelled(cancel_fd)) {
+        _dia("CrlFetcher::fetch: download of %s aborted", url_printable.c_str());
+        return nullptr;
+    }
+
+    if(not crl) {
+        ++stats_t::failed;
+        _war("CrlFetcher::fetch: downloading CRL from %s failed", url_printable.c_str());
+
+        // keep still valid CRL if this was a refresh
+        auto lc_ = std::scoped_lock(cache.getlock());
+        auto current = cache.get(url);
+        if(not current or current->expired() or not current->value()->ptr) {
+            cache.set(url, new SSLFactory::expiring_crl(new crl_holder(nullptr), params_t::retry_after));
+        }
+        return nullptr;
+    }
+
+    ++stats_t::downloaded;
+    _dia("CrlFetcher::fetch: CRL %s downloaded: size %d bytes in %d seconds", url_printable.c_str(), b.size(), ::time(nullptr) - start);
+
+    X509_CRL_up_ref(crl);
+    cache.set(url, SSLFactory::make_expiring_crl(crl));
+
+    return crl;
+}
+
+void CrlFetcher::schedule_refresh() {
+
+    auto const& log = get_log();
+    auto const now = ::time(nullptr);
+    auto const ttl = SSLFactory::options::crl_status_ttl;
+
+    for(auto it = known_.begin(); it != known_.end(); ) {
+        auto const& [url, k] = *it;
+
+        // not used for the whole ttl: let it expire
+        if(now - k.used > ttl) {
+            it = known_.erase(it);
+            continue;
+        }
+
+        if(k.fetched > 0 and now - k.fetched >= ttl - params_t::refresh_ahead and inflight_.find(url) == inflight_.end()) {
+            start();
+            inflight_.insert(url);
+            queue_.push_back(url);
+
+            ++stats_t::refreshed;
+            _dia("CrlFetcher::schedule_refresh: refreshing %s", printable(url).c_str());
+        }
+        ++it;
+    }
+}
+
+void CrlFetcher::worker() {
+
+    while(true) {
+        std::string url;
+        {
+            auto l_ = std::unique_lock(lock_);
+            cv_.wait_for(l_, std::chrono::seconds(1), [this]() { return stop_ or not queue_.empty(); });
+
+            if(stop_) return;
+
+            if(queue_.empty()) {
+                schedule_refresh();
+                if(queue_.empty()) continue;
+            }
+
+            url = queue_.front();
+            queue_.pop_front();
+        }
+
+        auto* crl = fetch(url, stop_fd_);
+        if(crl) X509_CRL_free(crl);
+
+        auto l_ = std::scoped_lock(lock_);
+        inflight_.erase(url);
+
+        // failed download is retried by the next request, after cached failure expires
+        if(auto it = known_.find(url); it != known_.end()) {
+            it->second.fetched = crl ? ::time(nullptr) : 0;
+        }
+    }
+}
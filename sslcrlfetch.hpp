@@ -0,0 +1,115 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLCRLFETCH_HPP
+#define SSLCRLFETCH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sslcertstore.hpp>
+
+//! Downloads CRLs into SSLFactory::crl_cache() out of the handshake path.
+/*!
+ *  Requests for the same URL share single download. Until it's finished, connections see CRL status as
+ *  unknown, the same way as if download failed. URLs which were used recently are downloaded again
+ *  params_t::refresh_ahead seconds before their cache entry expires, so popular CRLs don't get missing at all.
+ *  Failed download is cached as empty entry for params_t::retry_after seconds.
+ *
+ *  Workers are stopped by stop() (at latest by ~SSLFactory, whose cache they fill): running downloads are aborted,
+ *  so stopping doesn't wait for params_t::download_timeout.
+ */
+class CrlFetcher {
+public:
+    struct params_t {
+        static inline std::atomic<unsigned int> threads = 2;
+        static inline std::atomic<int> download_timeout = 9;     // seconds
+        static inline std::atomic<int> refresh_ahead = 600;      // seconds before crl_status_ttl expires
+        static inline std::atomic<int> retry_after = 300;        // failed download is cached for this long
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> requested {0};
+        static inline std::atomic<std::size_t> joined {0};       // download was already running
+        static inline std::atomic<std::size_t> downloaded {0};
+        static inline std::atomic<std::size_t> failed {0};
+        static inline std::atomic<std::size_t> refreshed {0};
+    };
+
+    static CrlFetcher& get() {
+        static CrlFetcher f;
+        return f;
+    }
+
+    /// @brief queue download of the url, unless it's already running. Returns immediately.
+    void request(std::string const& url);
+    /// @brief mark url as used, to keep it refreshed
+    void touch(std::string const& url);
+    [[nodiscard]] bool pending(std::string const& url);
+
+    /// @brief download and parse CRL, store it in the cache. Returns CRL with new reference, or nullptr.
+    /// Download is aborted if cancel_fd becomes readable, cache is not touched then.
+    static X509_CRL* fetch(std::string const& url, int cancel_fd = -1);
+
+    /// @brief abort running downloads and join workers, further requests are ignored
+    void stop();
+    /// @brief stop() the instance, if it was created
+    static void shutdown();
+
+    ~CrlFetcher();
+
+    CrlFetcher(CrlFetcher const&) = delete;
+    CrlFetcher& operator=(CrlFetcher const&) = delete;
+
+private:
+    CrlFetcher();
+
+    struct known_t {
+        time_t fetched = 0;
+        time_t used = 0;
+    };
+
+    void start();
+    void worker();
+    void schedule_refresh();    // called locked
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    std::unordered_set<std::string> inflight_;
+    std::unordered_map<std::string, known_t> known_;
+    std::vector<std::thread> workers_;
+    bool stop_ = false;
+    int stop_fd_ = -1;  // eventfd, readable once stopped: aborts downloads
+
+    static inline std::atomic<CrlFetcher*> instance_ {nullptr};
+
+    static logan_lite& get_log() {
+        static logan_lite l("com.tls.crl");
+        return l;
+    }
+};
+
+#endif //SSLCRLFETCH_HPP
@@ -0,0 +1,133 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <openssl/ec.h>
+#include <openssl/rsa.h>
+
+#include <chrono>
+
+#include <sslkeypool.hpp>
+#include <log/logger.hpp>
+
+
+namespace {
+    int key_base_id(KeyPool::key_type_t type) {
+        return type == KeyPool::key_type_t::EC_P256 ? EVP_PKEY_EC : EVP_PKEY_RSA;
+    }
+}
+
+EVP_PKEY* KeyPool::generate(key_type_t type) {
+
+    EVP_PKEY* key = nullptr;
+    auto* ctx = EVP_PKEY_CTX_new_id(key_base_id(type), nullptr);
+    if(not ctx) return nullptr;
+
+    if(EVP_PKEY_keygen_init(ctx) > 0) {
+        int r = type == key_type_t::EC_P256 ? EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1)
+                                            : EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+        if(r > 0 and EVP_PKEY_keygen(ctx, &key) <= 0) {
+            key = nullptr;
+        }
+    }
+
+    EVP_PKEY_CTX_free(ctx);
+    return key;
+}
+
+KeyPool::~KeyPool() {
+    {
+        auto l_ = std::scoped_lock(lock_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    if(filler_.joinable()) filler_.join();
+
+    for(auto* k: keys_) EVP_PKEY_free(k);
+}
+
+void KeyPool::start() {
+    // called with lock_ held
+    if(filler_.joinable()) return;
+
+    filler_ = std::thread([this]() { worker(); });
+    _dia("KeyPool::start: filling %d %s keys", params_t::size.load(), type_str(params_t::type));
+}
+
+std::size_t KeyPool::available() {
+    auto l_ = std::scoped_lock(lock_);
+    start();
+    return keys_.size();
+}
+
+EVP_PKEY* KeyPool::take() {
+
+    EVP_PKEY* key = nullptr;
+    {
+        auto l_ = std::scoped_lock(lock_);
+        start();
+
+        // drop keys generated before type was changed
+        while(not keys_.empty() and EVP_PKEY_base_id(keys_.front()) != key_base_id(params_t::type)) {
+            EVP_PKEY_free(keys_.front());
+            keys_.pop_front();
+        }
+
+        if(not keys_.empty()) {
+            key = keys_.front();
+            keys_.pop_front();
+        }
+    }
+    cv_.notify_one();
+
+    if(key) {
+        ++stats_t::taken;
+    } else {
+        ++stats_t::empty;
+        _deb("KeyPool::take: pool is empty");
+    }
+
+    return key;
+}
+
+void KeyPool::worker() {
+
+    while(true) {
+        {
+            // params_t::size could be raised meanwhile, recheck periodically
+            auto l_ = std::unique_lock(lock_);
+            if(not cv_.wait_for(l_, std::chrono::seconds(1), [this]() { return stop_ or keys_.size() < params_t::size; })) {
+                continue;
+            }
+
+            if(stop_) return;
+        }
+
+        // keys are generated unlocked, take() is never blocked by it
+        auto* key = generate(params_t::type);
+        if(not key) {
+            _err("KeyPool::worker: key generation failed");
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+        ++stats_t::generated;
+
+        auto l_ = std::scoped_lock(lock_);
+        keys_.push_back(key);
+    }
+}
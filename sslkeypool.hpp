@@ -0,0 +1,85 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLKEYPOOL_HPP
+#define SSLKEYPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <openssl/evp.h>
+
+#include <log/logan.hpp>
+
+//! Pre-generated private keys for spoofed certificates.
+/*!
+ *  Background thread keeps the pool filled, so giving each spoofed certificate its own key doesn't
+ *  cost key generation on the handshake path. If the pool runs dry, take() returns nullptr rather than
+ *  generating the key in place.
+ */
+class KeyPool {
+public:
+    enum class key_type_t { RSA2048, EC_P256 };
+
+    struct params_t {
+        static inline std::atomic<std::size_t> size = 64;
+        static inline std::atomic<key_type_t> type = key_type_t::EC_P256;
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> generated {0};
+        static inline std::atomic<std::size_t> taken {0};
+        static inline std::atomic<std::size_t> empty {0};
+    };
+
+    static KeyPool& get() {
+        static KeyPool p;
+        return p;
+    }
+
+    /// @brief key of params_t::type, owned by caller. Nullptr if there is no key ready.
+    EVP_PKEY* take();
+    std::size_t available();
+
+    static EVP_PKEY* generate(key_type_t type);
+    static const char* type_str(key_type_t type) { return type == key_type_t::EC_P256 ? "ec-p256" : "rsa-2048"; }
+
+    ~KeyPool();
+
+    KeyPool(KeyPool const&) = delete;
+    KeyPool& operator=(KeyPool const&) = delete;
+
+private:
+    KeyPool() = default;
+
+    void start();
+    void worker();
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<EVP_PKEY*> keys_;
+    std::thread filler_;
+    bool stop_ = false;
+
+    logan_lite log {"pki.keypool"};
+};
+
+#endif //SSLKEYPOOL_HPP
@@ -21,6 +21,7 @@
 
 
 #include <sslcom.hpp>
+#include <sslspoofpool.hpp>
 
 
 struct SpoofOptions {
@@ -42,6 +43,8 @@ public:
     virtual bool use_cert_sni(SpoofOptions &spo);
     virtual bool use_cert_ip(SpoofOptions &spo);
     virtual bool use_cert_mitm(X509* cert_orig, SpoofOptions& spo);
+    bool cert_pending() override;
+    void cleanup() override;
 
     baseCom* replicate() override { return new baseSSLMitmCom(); };
 
@@ -49,6 +52,18 @@ public:
     std::string to_string(int verbosity) const override { return SSLProto::to_string(verbosity); };
 
     TYPENAME_OVERRIDE("baseSSLMitmCom")
+
+private:
+    // set if certificate is being created by SpoofPool
+    SpoofPool::job_ptr spoof_job_;
+    void use_spoof_result();
+
+    // duplicate of spoof_job_ notify_fd(), monitored with the socket's handler while waiting for the job
+    int spoof_notify_ = -1;
+    void watch_spoof_job();
+    void unwatch_spoof_job();
+
+public:
     DECLARE_LOGGING(to_string)
 
     struct log {
@@ -173,7 +173,10 @@ bool baseSSLMitmCom<SSLProto>::check_cert(const char* peer_name) {
                     // this is inefficient: many SSLComs are already initialized, this is running it once 
                     // more ...
                     // check if is waiting would help
-                    if (remote->sslcom_waiting) {
+                    if (remote->cert_pending()) {
+                        _dia("SSLMitmCom::check_cert[%x]: peer certificate is being spoofed, init deferred", this);
+                    }
+                    else if (remote->sslcom_waiting) {
                         if(not remote->upgraded()) {
                             remote->init_server();
                             remote->upgraded(true);
@@ -212,6 +215,7 @@ bool baseSSLMitmCom<SSLProto>::use_cert_sni(SpoofOptions &spo) {
 
             this->sslcom_pref_cert = parek.value().chain.cert;
             this->sslcom_pref_key = parek.value().chain.key;
+            this->sslcom_pref_issuers = parek.value().chain.issuers;
 
             auto custom_ctx = parek.value().ctx;
             if(custom_ctx)
@@ -240,6 +244,7 @@ bool baseSSLMitmCom<SSLProto>::use_cert_ip(SpoofOptions &spo) {
 
                 this->sslcom_pref_cert = parek.value().chain.cert;
                 this->sslcom_pref_key = parek.value().chain.key;
+                this->sslcom_pref_issuers = parek.value().chain.issuers;
 
                 auto custom_ctx = parek.value().ctx;
                 if(custom_ctx) {
@@ -279,7 +284,15 @@ bool baseSSLMitmCom<SSLProto>::use_cert_mitm(X509 *cert_orig, SpoofOptions &spo)
 
         _dia("SSLMitmCom::use_cert_mitm: NOT found '%s'", store_key.c_str());
 
-        auto spoof_ret = this->factory()->spoof(cert_orig, spo.self_signed, &spo.sans);
+        if(SSLFactory::options::async_spoof) {
+            spoof_job_ = SpoofPool::get().submit(store_key, cert_orig, spo.self_signed, spo.sans);
+            if(spoof_job_) {
+                _dia("SSLMitmCom::use_cert_mitm: '%s' is being spoofed in background", store_key.c_str());
+                return true;
+            }
+        }
+
+        auto spoof_ret = this->factory()->spoof_or_load(store_key, cert_orig, spo.self_signed, &spo.sans);
         if(not spoof_ret.has_value()) {
             _war("SSLMitmCom::use_cert_mitm: factory failed to spoof '%s' - default will be used", store_key.c_str());
             return false;
@@ -292,13 +305,7 @@ bool baseSSLMitmCom<SSLProto>::use_cert_mitm(X509 *cert_orig, SpoofOptions &spo)
             if(custom_ctx)
                 this->sslcom_pref_ctx = custom_ctx;
 
-#ifdef USE_OPENSSL11
-            EVP_PKEY_up_ref(this->sslcom_pref_key);
-#else
-            // just increment key refcount, cert is new (made from key), thus refcount is already 1
-            CRYPTO_add(&this->sslcom_pref_key->references,+1,CRYPTO_LOCK_EVP_PKEY);
-#endif //USE_OPENSSL11
-
+            // cache takes over spoofed cert and key references
             if (!this->factory()->add_mitm(store_key, spoof_ret.value())) {
                 _dia("SSLMitmCom::use_cert_mitm: spoofed, but cache failed to update with %s", store_key.c_str());
                 return true;
@@ -309,6 +316,84 @@ bool baseSSLMitmCom<SSLProto>::use_cert_mitm(X509 *cert_orig, SpoofOptions &spo)
     return true;
 }
 
+template <class SSLProto>
+bool baseSSLMitmCom<SSLProto>::cert_pending() {
+
+    if(not spoof_job_) return false;
+    if(not spoof_job_->ready()) {
+        watch_spoof_job();
+        return true;
+    }
+
+    unwatch_spoof_job();
+    use_spoof_result();
+    return false;
+}
+
+template <class SSLProto>
+void baseSSLMitmCom<SSLProto>::watch_spoof_job() {
+    auto const& log = log::mitm();
+
+    // proxy is woken up by the job and retries reading from the socket, which resumes the handshake
+    this->forced_read(true);
+
+    if(spoof_notify_ >= 0) return;
+
+    spoof_notify_ = ::dup(spoof_job_->notify_fd());
+    if(spoof_notify_ < 0) {
+        _err("SSLMitmCom::watch_spoof_job: cannot duplicate notify fd: %s", string_error().c_str());
+        return;
+    }
+
+    this->master()->poller.add(spoof_notify_, EPOLLIN);
+    this->set_poll_handler(spoof_notify_, this->get_poll_handler(this->socket()));
+    _dia("SSLMitmCom::watch_spoof_job: socket %d waits on notify fd %d", this->socket(), spoof_notify_);
+}
+
+template <class SSLProto>
+void baseSSLMitmCom<SSLProto>::unwatch_spoof_job() {
+
+    if(spoof_notify_ < 0) return;
+
+    // fd stays readable: it must leave epoll before it's closed, the job holds the same eventfd open
+    this->master()->poller.del(spoof_notify_);
+    this->set_poll_handler(spoof_notify_, nullptr);
+    ::close(spoof_notify_);
+    spoof_notify_ = -1;
+}
+
+template <class SSLProto>
+void baseSSLMitmCom<SSLProto>::cleanup() {
+    unwatch_spoof_job();
+    SSLProto::cleanup();
+}
+
+template <class SSLProto>
+void baseSSLMitmCom<SSLProto>::use_spoof_result() {
+    auto const& log = log::mitm();
+
+    // job keeps references until server is initialized
+    auto job = std::move(spoof_job_);
+
+    if(job->state == SpoofPool::job_t::state_t::DONE) {
+        _dia("SSLMitmCom::use_spoof_result: using spoofed '%s'", job->store_key.c_str());
+
+        this->sslcom_pref_cert = job->result.chain.cert;
+        this->sslcom_pref_key = job->result.chain.key;
+
+        if(job->result.ctx)
+            this->sslcom_pref_ctx = job->result.ctx;
+    }
+    else {
+        _war("SSLMitmCom::use_spoof_result: failed to spoof '%s' - default will be used", job->store_key.c_str());
+    }
+
+    if(this->sslcom_waiting and not this->upgraded()) {
+        this->init_server();
+        this->upgraded(true);
+    }
+}
+
 template <class SSLProto>
 bool baseSSLMitmCom<SSLProto>::spoof_cert(X509* cert_orig, SpoofOptions& spo) {
     auto const& log = log::mitm();
@@ -0,0 +1,189 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <sslocspcache.hpp>
+#include <display.hpp>
+
+#include <array>
+#include <chrono>
+#include <vector>
+
+OcspCache::entry_t::entry_t(X509* c, X509* i) : cert(c), issuer(i) {
+    X509_up_ref(cert);
+    X509_up_ref(issuer);
+}
+
+OcspCache::entry_t::~entry_t() {
+    X509_free(cert);
+    X509_free(issuer);
+}
+
+OcspCache::~OcspCache() {
+    {
+        auto l_ = std::scoped_lock(lock_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    if(refresher_.joinable()) refresher_.join();
+}
+
+std::string OcspCache::cert_key(X509* cert, X509* issuer) {
+
+    std::string ret;
+
+    auto* bn = ASN1_INTEGER_to_BN(X509_get0_serialNumber(cert), nullptr);
+    if(bn) {
+        auto* hex = BN_bn2hex(bn);
+        ret = hex;
+        OPENSSL_free(hex);
+        BN_free(bn);
+    }
+
+    std::array<unsigned char, EVP_MAX_MD_SIZE> md {};
+    unsigned int md_len = 0;
+    if(X509_pubkey_digest(issuer, EVP_sha1(), md.data(), &md_len) == 1) {
+        ret += ":" + hex_print(md.data(), md_len);
+    }
+
+    return ret;
+}
+
+void OcspCache::start() {
+    if(refresher_.joinable()) return;
+    refresher_ = std::thread([this]() { refresher(); });
+}
+
+std::optional<inet::cert::VerifyStatus> OcspCache::lookup(X509* cert, X509* issuer) {
+
+    auto const key = cert_key(cert, issuer);
+    auto const now = ::time(nullptr);
+
+    auto l_ = std::scoped_lock(lock_);
+
+    auto it = entries_.find(key);
+    if(it == entries_.end() or it->second->expires <= now) {
+        ++stats_t::misses;
+        return std::nullopt;
+    }
+
+    auto& e = *it->second;
+    e.used = now;
+    ++e.uses;
+
+    ++stats_t::hits;
+    return e.status;
+}
+
+void OcspCache::update(std::string const& key, X509* cert, X509* issuer, inet::cert::VerifyStatus const& status) {
+
+    auto const now = ::time(nullptr);
+    auto const ttl = status.revoked >= 0 ? status.ttl : std::min(status.ttl, params_t::unknown_ttl.load());
+
+    auto l_ = std::scoped_lock(lock_);
+
+    auto& e = entries_[key];
+    if(e) {
+        // failed refresh doesn't replace still valid result
+        if(status.revoked < 0 and e->status.revoked >= 0 and e->expires > now) {
+            e->fetched = now;
+            return;
+        }
+    }
+    else {
+        e = std::make_shared<entry_t>(cert, issuer);
+        e->used = now;
+    }
+
+    e->status = status;
+    e->fetched = now;
+    e->expires = now + ttl;
+    ++e->uses;
+}
+
+inet::cert::VerifyStatus OcspCache::query(X509* cert, X509* issuer) {
+
+    auto const key = cert_key(cert, issuer);
+
+    std::promise<inet::cert::VerifyStatus> promise;
+    std::shared_future<inet::cert::VerifyStatus> running;
+    {
+        auto l_ = std::scoped_lock(lock_);
+        start();
+
+        if(auto it = inflight_.find(key); it != inflight_.end()) {
+            running = it->second;
+        }
+        else {
+            inflight_.emplace(key, promise.get_future().share());
+        }
+    }
+
+    if(running.valid()) {
+        ++stats_t::joined;
+        _dia("OcspCache::query: %s: waiting for running query", key.c_str());
+        return running.get();
+    }
+
+    ++stats_t::queries;
+    _dia("OcspCache::query: %s: querying responder", key.c_str());
+
+    auto status = inet::ocsp::ocsp_check_cert(cert, issuer, params_t::request_timeout);
+    update(key, cert, issuer, status);
+    promise.set_value(status);
+
+    auto l_ = std::scoped_lock(lock_);
+    inflight_.erase(key);
+
+    return status;
+}
+
+void OcspCache::refresher() {
+
+    while(true) {
+        std::vector<std::shared_ptr<entry_t>> due;
+        {
+            auto l_ = std::unique_lock(lock_);
+            cv_.wait_for(l_, std::chrono::seconds(1), [this]() { return stop_; });
+            if(stop_) return;
+
+            auto const now = ::time(nullptr);
+            for(auto it = entries_.begin(); it != entries_.end(); ) {
+                auto const& e = it->second;
+                bool const hot = e->uses >= params_t::hot_uses and now - e->used < params_t::hot_window;
+
+                if(not hot and e->expires <= now) {
+                    ++stats_t::dropped;
+                    it = entries_.erase(it);
+                    continue;
+                }
+
+                bool const due_soon = e->expires - now <= params_t::refresh_ahead and now - e->fetched >= params_t::refresh_interval;
+                if(hot and due_soon and inflight_.find(it->first) == inflight_.end()) {
+                    due.push_back(e);
+                }
+                ++it;
+            }
+        }
+
+        for(auto const& e: due) {
+            ++stats_t::refreshed;
+            query(e->cert, e->issuer);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLOCSPCACHE_HPP
+#define SSLOCSPCACHE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <sslcertval.hpp>
+#include <log/logan.hpp>
+
+//! OCSP results keyed by certificate ID (serial and issuer key hash), with prefetch of popular certificates.
+/*!
+ *  Result is valid until the response nextUpdate (unknown status only for params_t::unknown_ttl). Concurrent
+ *  queries for the same certificate wait for the single running one. Certificates looked up at least
+ *  params_t::hot_uses times are queried again by the background thread, params_t::refresh_ahead seconds
+ *  before their result expires, so connections to them don't wait for OCSP.
+ */
+class OcspCache {
+public:
+    struct params_t {
+        static inline std::atomic<int> request_timeout = 2;     // seconds
+        static inline std::atomic<int> refresh_ahead = 300;     // seconds before nextUpdate
+        static inline std::atomic<int> refresh_interval = 60;   // minimal age of result to be refreshed (short nextUpdate)
+        static inline std::atomic<int> unknown_ttl = 60;
+        static inline std::atomic<std::size_t> hot_uses = 2;
+        static inline std::atomic<int> hot_window = 3600;       // entries unused for this long are not refreshed, and dropped once expired
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> hits {0};
+        static inline std::atomic<std::size_t> misses {0};
+        static inline std::atomic<std::size_t> queries {0};
+        static inline std::atomic<std::size_t> joined {0};      // query was already running
+        static inline std::atomic<std::size_t> refreshed {0};
+        static inline std::atomic<std::size_t> dropped {0};
+    };
+
+    static OcspCache& get() {
+        static OcspCache c;
+        return c;
+    }
+
+    /// @brief OCSP certificate ID: serial number and SHA1 hash of issuer public key, hex encoded
+    static std::string cert_key(X509* cert, X509* issuer);
+
+    /// @brief cached, not expired status
+    std::optional<inet::cert::VerifyStatus> lookup(X509* cert, X509* issuer);
+    /// @brief query OCSP responder (or wait for the running query of the same certificate), cache the result
+    inet::cert::VerifyStatus query(X509* cert, X509* issuer);
+
+    std::size_t size() { auto l_ = std::scoped_lock(lock_); return entries_.size(); }
+    void clear() { auto l_ = std::scoped_lock(lock_); entries_.clear(); }
+
+    ~OcspCache();
+
+    OcspCache(OcspCache const&) = delete;
+    OcspCache& operator=(OcspCache const&) = delete;
+
+private:
+    OcspCache() = default;
+
+    struct entry_t {
+        entry_t(X509* c, X509* i);
+        ~entry_t();
+
+        entry_t(entry_t const&) = delete;
+        entry_t& operator=(entry_t const&) = delete;
+
+        X509* const cert;       // referenced, kept for refresh
+        X509* const issuer;
+
+        inet::cert::VerifyStatus status;
+        time_t expires = 0;
+        time_t fetched = 0;
+        time_t used = 0;
+        std::size_t uses = 0;
+    };
+
+    void update(std::string const& key, X509* cert, X509* issuer, inet::cert::VerifyStatus const& status);
+
+    void start();   // called locked
+    void refresher();
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, std::shared_ptr<entry_t>> entries_;
+    std::unordered_map<std::string, std::shared_future<inet::cert::VerifyStatus>> inflight_;
+    std::thread refresher_;
+    bool stop_ = false;
+
+    logan_lite log {"com.tls.ocsp.cache"};
+};
+
+#endif //SSLOCSPCACHE_HPP
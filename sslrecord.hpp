@@ -0,0 +1,69 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLRECORD_HPP
+#define SSLRECORD_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+
+//! Size of outgoing TLS records for one connection.
+/*!
+ *  Connection starts (and restarts after being idle) with records fitting into a single TCP segment, so the peer
+ *  can decrypt the first bytes without waiting for more segments. Each record written in full size doubles
+ *  the record size, up to maximal TLS record, which has the lowest per-record overhead for bulk transfers.
+ *  Short interactive writes don't grow the record size.
+ */
+class RecordSizer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct params_t {
+        // 1460B MSS minus TCP options and TLS record header, MAC and padding
+        static inline std::atomic<std::size_t> small_record = 1369;
+        static inline std::atomic<std::size_t> full_record = 16384;
+        static inline std::atomic<int> idle_reset_ms = 1000;
+        // bytes written by one SSLCom::write() call, so other connections get their turn
+        static inline std::atomic<std::size_t> write_burst = 128*1024;
+    };
+
+    /// @brief size of the next record
+    std::size_t record_size(clock::time_point now) {
+        if(current_ == 0 or now - last_ > std::chrono::milliseconds(params_t::idle_reset_ms)) {
+            current_ = std::min(params_t::small_record.load(), params_t::full_record.load());
+        }
+        return current_;
+    }
+
+    /// @brief record of 'size' bytes was written
+    void on_record(std::size_t size, clock::time_point now) {
+        last_ = now;
+        if(size >= current_) {
+            current_ = std::min(current_ * 2, params_t::full_record.load());
+        }
+    }
+
+private:
+    std::size_t current_ = 0;
+    clock::time_point last_ {};
+};
+
+#endif //SSLRECORD_HPP
@@ -0,0 +1,215 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <sslresume.hpp>
+#include <siphash.hpp>
+
+#include <algorithm>
+#include <ctime>
+
+ResumptionStore::ResumptionStore() :
+        size_(std::max<std::size_t>(1, params_t::destinations.load())),
+        probe_(std::clamp<unsigned int>(params_t::probe.load(), 1, static_cast<unsigned int>(size_))),
+        table_(std::make_unique<destination_t[]>(size_)) {}
+
+ResumptionStore::~ResumptionStore() {
+    clear();
+}
+
+std::string ResumptionStore::make_key(std::string const& host, std::string const& port, std::string const& sni, std::string const& alpn_wire) {
+    std::string ret = host + ":" + port + "/" + sni + "/";
+
+    // wire format (length prefixed) to a readable list
+    for(std::size_t i = 0; i < alpn_wire.size(); ) {
+        auto const len = static_cast<unsigned char>(alpn_wire[i]);
+        if(i > 0) ret += ",";
+        ret += alpn_wire.substr(i + 1, len);
+        i += 1 + len;
+    }
+    return ret;
+}
+
+uint64_t ResumptionStore::hash(std::string const& key) {
+    auto h = socle::tools::siphash::compute(key.data(), key.size());
+
+    // zero marks free destination slot
+    return h ? h : 1;
+}
+
+int ResumptionStore::tag_index() {
+    static int idx = SSL_SESSION_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return idx;
+}
+
+uint64_t ResumptionStore::tag(SSL_SESSION* sess) {
+    return reinterpret_cast<uintptr_t>(SSL_SESSION_get_ex_data(sess, tag_index()));
+}
+
+ResumptionStore::destination_t* ResumptionStore::find(uint64_t h) const {
+    for(unsigned int i = 0; i < probe_; ++i) {
+        auto& d = table_[(h + i) % size_];
+        if(d.hash.load(std::memory_order_acquire) == h) return &d;
+    }
+    return nullptr;
+}
+
+ResumptionStore::destination_t* ResumptionStore::claim(uint64_t h, std::string const& key) {
+
+    destination_t* ret = nullptr;
+    for(unsigned int i = 0; i < probe_ and not ret; ++i) {
+        auto& d = table_[(h + i) % size_];
+        uint64_t expected = 0;
+        if(d.hash.compare_exchange_strong(expected, h, std::memory_order_acq_rel) or expected == h) {
+            ret = &d;
+        }
+    }
+
+    if(not ret) {
+        // no free slot in the probe window, reclaim one of them
+        ret = &table_[(h + (h >> 32) % probe_) % size_];
+        auto old = ret->hash.exchange(h, std::memory_order_acq_rel);
+        if(old != h) {
+            drain(*ret);
+            ret->lookups = 0;
+            ret->hits = 0;
+            ret->stored = 0;
+            ++stats_t::reclaimed;
+
+            auto l_ = std::scoped_lock(names_lock_);
+            names_.erase(old);
+        }
+    }
+
+    auto l_ = std::scoped_lock(names_lock_);
+    names_.try_emplace(h, key);
+
+    return ret;
+}
+
+void ResumptionStore::drain(destination_t& d) {
+    for(auto& s: d.sessions) {
+        if(auto* sess = s.exchange(nullptr, std::memory_order_acq_rel); sess) {
+            SSL_SESSION_free(sess);
+        }
+    }
+}
+
+void ResumptionStore::put(std::string const& key, SSL_SESSION* sess) {
+
+    auto const h = hash(key);
+    SSL_SESSION_set_ex_data(sess, tag_index(), reinterpret_cast<void*>(static_cast<uintptr_t>(h)));
+
+    auto* d = find(h);
+    if(not d) d = claim(h, key);
+
+    ++d->stored;
+    ++stats_t::stored;
+
+    for(auto& s: d->sessions) {
+        SSL_SESSION* expected = nullptr;
+        if(s.compare_exchange_strong(expected, sess, std::memory_order_acq_rel)) {
+            _deb("ResumptionStore::put: %s: session stored", key.c_str());
+            return;
+        }
+    }
+
+    // all slots taken, replace in round-robin
+    auto& s = d->sessions[d->next++ % max_tickets];
+    if(auto* old = s.exchange(sess, std::memory_order_acq_rel); old) {
+        SSL_SESSION_free(old);
+        ++stats_t::replaced;
+    }
+    _deb("ResumptionStore::put: %s: session stored, older one replaced", key.c_str());
+}
+
+SSL_SESSION* ResumptionStore::take(std::string const& key) {
+
+    ++stats_t::lookups;
+
+    auto const h = hash(key);
+    auto* d = find(h);
+    if(not d) {
+        _deb("ResumptionStore::take: %s: unknown destination", key.c_str());
+        return nullptr;
+    }
+
+    ++d->lookups;
+    auto const now = time(nullptr);
+
+    for(auto& s: d->sessions) {
+        auto* sess = s.exchange(nullptr, std::memory_order_acq_rel);
+        if(not sess) continue;
+
+        if(tag(sess) != h or SSL_SESSION_get_time(sess) + SSL_SESSION_get_timeout(sess) <= now) {
+            SSL_SESSION_free(sess);
+            ++stats_t::discarded;
+            continue;
+        }
+
+        if(SSL_SESSION_get_protocol_version(sess) < TLS1_3_VERSION) {
+            // not single use: put it back, unless the slot was used meanwhile
+            SSL_SESSION_up_ref(sess);
+            SSL_SESSION* expected = nullptr;
+            if(not s.compare_exchange_strong(expected, sess, std::memory_order_acq_rel)) {
+                SSL_SESSION_free(sess);
+            }
+        }
+
+        ++d->hits;
+        ++stats_t::hits;
+        _deb("ResumptionStore::take: %s: session found", key.c_str());
+        return sess;
+    }
+
+    _deb("ResumptionStore::take: %s: no usable session", key.c_str());
+    return nullptr;
+}
+
+std::vector<ResumptionStore::report_t> ResumptionStore::report() const {
+
+    std::vector<report_t> ret;
+    {
+        auto l_ = std::scoped_lock(names_lock_);
+        for (auto const& [h, name]: names_) {
+            auto const* d = find(h);
+            if (not d) continue;
+
+            report_t r;
+            r.destination = name;
+            r.lookups = d->lookups;
+            r.hits = d->hits;
+            r.stored = d->stored;
+            r.available = std::count_if(d->sessions.begin(), d->sessions.end(),
+                                        [](auto const& s) { return s.load() != nullptr; });
+            ret.emplace_back(std::move(r));
+        }
+    }
+
+    std::sort(ret.begin(), ret.end(), [](auto const& a, auto const& b) { return a.lookups > b.lookups; });
+    return ret;
+}
+
+void ResumptionStore::clear() {
+    for(std::size_t i = 0; i < size_; ++i) {
+        drain(table_[i]);
+        table_[i].hash = 0;
+    }
+
+    auto l_ = std::scoped_lock(names_lock_);
+    names_.clear();
+}
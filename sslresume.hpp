@@ -0,0 +1,118 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLRESUME_HPP
+#define SSLRESUME_HPP
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include <log/logan.hpp>
+
+//! Upstream (client side) sessions, per destination.
+/*!
+ *  Destination is a string made of target IP, port, SNI and offered ALPN. Each destination keeps up to
+ *  max_tickets sessions: TLS 1.3 tickets are single use, so a session is taken out of its slot with an
+ *  atomic exchange and no other connection can get it. Older protocol sessions can be resumed many times
+ *  and are put back after take().
+ *
+ *  Destinations live in a fixed open-addressing table of hashed keys. take() and put() only use atomics; the
+ *  table mutex guards destination names, which are needed just for report(). Each session is tagged with
+ *  its destination hash, so a session put to a destination slot being reclaimed is never handed to the new one.
+ */
+class ResumptionStore {
+public:
+    static constexpr std::size_t max_tickets = 4;
+
+    struct params_t {
+        static inline std::atomic<std::size_t> destinations = 4096;   // table size, read at construction
+        static inline std::atomic<unsigned int> probe = 8;
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> lookups {0};
+        static inline std::atomic<std::size_t> hits {0};
+        static inline std::atomic<std::size_t> stored {0};
+        static inline std::atomic<std::size_t> replaced {0};     // slots were full, the oldest session dropped
+        static inline std::atomic<std::size_t> discarded {0};    // expired, or belonging to a reclaimed destination
+        static inline std::atomic<std::size_t> reclaimed {0};    // destination evicted by another one
+    };
+
+    struct report_t {
+        std::string destination;
+        std::size_t lookups = 0;
+        std::size_t hits = 0;
+        std::size_t stored = 0;
+        std::size_t available = 0;
+
+        [[nodiscard]] double hit_rate() const { return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0; }
+    };
+
+    ResumptionStore();
+    ~ResumptionStore();
+
+    ResumptionStore(ResumptionStore const&) = delete;
+    ResumptionStore& operator=(ResumptionStore const&) = delete;
+
+    static std::string make_key(std::string const& host, std::string const& port, std::string const& sni, std::string const& alpn_wire);
+
+    /// @brief store session, reference is taken over by the store
+    void put(std::string const& key, SSL_SESSION* sess);
+    /// @brief returns session (owned by caller) to resume connection to the destination, or nullptr
+    SSL_SESSION* take(std::string const& key);
+
+    /// @brief per destination counters, busiest first
+    std::vector<report_t> report() const;
+    void clear();
+
+private:
+    struct destination_t {
+        std::atomic<uint64_t> hash {0};
+        std::array<std::atomic<SSL_SESSION*>, max_tickets> sessions {};
+        std::atomic<unsigned int> next {0};
+        std::atomic<std::size_t> lookups {0};
+        std::atomic<std::size_t> hits {0};
+        std::atomic<std::size_t> stored {0};
+    };
+
+    static uint64_t hash(std::string const& key);
+    static int tag_index();
+    static uint64_t tag(SSL_SESSION* sess);
+
+    destination_t* find(uint64_t h) const;
+    destination_t* claim(uint64_t h, std::string const& key);
+    static void drain(destination_t& d);
+
+    std::size_t const size_;
+    unsigned int const probe_;
+    std::unique_ptr<destination_t[]> table_;
+
+    mutable std::mutex names_lock_;
+    std::unordered_map<uint64_t, std::string> names_;
+
+    logan_lite log {"com.tls.resume"};
+};
+
+#endif //SSLRESUME_HPP
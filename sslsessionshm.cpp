@@ -0,0 +1,397 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <sslsessionshm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include <openssl/rand.h>
+#include <openssl/core_names.h>
+
+
+namespace {
+    // must give the same result in all processes
+    uint64_t fnv1a(const unsigned char* data, unsigned int len) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for(unsigned int i = 0; i < len; ++i) {
+            h ^= data[i];
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+}
+
+SharedSessionCache::~SharedSessionCache() {
+    if(attached()) dettach();
+}
+
+void SharedSessionCache::unlink(std::string const& name) {
+    ::shm_unlink(name.c_str());
+    ::sem_unlink((name + ".lock").c_str());
+}
+
+bool SharedSessionCache::attach() {
+
+    if(attached()) return true;
+
+    unsigned int const ways = std::max(1U, params_t::ways.load());
+    unsigned int const slots = std::max(ways, params_t::slots.load() / ways * ways);
+    unsigned int const slot_size = (params_t::slot_size.load() + 7) & ~7U;
+
+    if(slot_size < sizeof(slot_t) + 256) {
+        _err("SharedSessionCache::attach: slot size %d too small", slot_size);
+        return false;
+    }
+
+    auto const size = sizeof(header_t) + static_cast<std::size_t>(slots) * slot_size;
+
+    if(not shared_buffer::attach(name_.c_str(), static_cast<int>(size), (name_ + ".lock").c_str(), true)) {
+        _err("SharedSessionCache::attach: cannot attach %s", name_.c_str());
+        return false;
+    }
+
+    // memory created by a worker with different geometry would fault beyond its size
+    struct stat st {};
+    if(::fstat(memory_fd, &st) != 0 or static_cast<std::size_t>(st.st_size) < size) {
+        _err("SharedSessionCache::attach: %s has size %ld, %ld expected", name_.c_str(), st.st_size, size);
+        dettach();
+        return false;
+    }
+
+    if(not initialize_mutex() or not lock()) {
+        dettach();
+        return false;
+    }
+
+    bool ret = true;
+    auto* h = header();
+    if(h->magic == 0) {
+        h->slots = slots;
+        h->slot_size = slot_size;
+        h->ways = ways;
+        ret = initialize_header();
+    }
+    else if(h->magic != magic or h->slots != slots or h->slot_size != slot_size or h->ways != ways) {
+        _err("SharedSessionCache::attach: %s geometry %dx%d/%d differs from %dx%d/%d", name_.c_str(),
+             h->slots, h->slot_size, h->ways, slots, slot_size, ways);
+        ret = false;
+    }
+    unlock();
+
+    if(not ret) {
+        dettach();
+        return false;
+    }
+
+    _dia("SharedSessionCache::attach: %s attached, %d slots of %dB", name_.c_str(), slots, slot_size);
+    return true;
+}
+
+bool SharedSessionCache::initialize_mutex() {
+    auto* h = header();
+
+    uint32_t fresh = 0;
+    if(h->mutex_state.compare_exchange_strong(fresh, 1)) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        int const rc = pthread_mutex_init(&h->mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+
+        if(rc != 0) {
+            _err("SharedSessionCache::initialize_mutex: %s: %s", name_.c_str(), string_error(rc).c_str());
+            h->mutex_state = 0;
+            return false;
+        }
+
+        h->mutex_state = 2;
+        return true;
+    }
+
+    // other worker is just initializing it
+    auto const until = std::chrono::steady_clock::now() + std::chrono::milliseconds(params_t::lock_timeout_ms.load());
+    while(h->mutex_state != 2) {
+        if(std::chrono::steady_clock::now() > until) {
+            _err("SharedSessionCache::initialize_mutex: %s: mutex not initialized in time", name_.c_str());
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool SharedSessionCache::initialize_header() {
+    auto* h = header();
+
+    if(not rotate_keys(time(nullptr))) return false;
+    h->keys[1] = ticket_key_t{};
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    h->magic = magic;
+
+    return true;
+}
+
+bool SharedSessionCache::rotate_keys(int64_t now) {
+    auto* h = header();
+
+    ticket_key_t k {};
+    if(RAND_bytes(k.name, sizeof(k.name)) != 1 or RAND_bytes(k.aes, sizeof(k.aes)) != 1 or RAND_bytes(k.hmac, sizeof(k.hmac)) != 1) {
+        _err("SharedSessionCache::rotate_keys: cannot generate ticket key");
+        return false;
+    }
+    k.created = now;
+
+    h->keys[1] = h->keys[0];
+    h->keys[0] = k;
+    ++stats_t::key_rotations;
+
+    _dia("SharedSessionCache::rotate_keys: new ticket key %s", hex_print(k.name, sizeof(k.name)).c_str());
+    return true;
+}
+
+bool SharedSessionCache::lock() {
+
+    timespec ts {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    auto const ms = params_t::lock_timeout_ms.load();
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if(ts.tv_nsec >= 1000000000L) {
+        ++ts.tv_sec;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    int const rc = pthread_mutex_timedlock(&header()->mutex, &ts);
+    if(rc == EOWNERDEAD) {
+        // slots and header are written so that an interrupted update leaves them unused or uninitialized
+        ++stats_t::owner_died;
+        _war("SharedSessionCache::lock: %s: previous owner died, lock recovered", name_.c_str());
+        pthread_mutex_consistent(&header()->mutex);
+        return true;
+    }
+    else if(rc != 0) {
+        if(rc == ETIMEDOUT) ++stats_t::lock_timeouts;
+        _war("SharedSessionCache::lock: %s: %s", name_.c_str(), string_error(rc).c_str());
+        return false;
+    }
+    return true;
+}
+
+void SharedSessionCache::unlock() {
+    pthread_mutex_unlock(&header()->mutex);
+}
+
+SharedSessionCache::slot_t* SharedSessionCache::slot(unsigned int index) const {
+    auto* first = data_ + sizeof(header_t);
+    return reinterpret_cast<slot_t*>(first + static_cast<std::size_t>(index) * header()->slot_size);
+}
+
+SharedSessionCache::slot_t* SharedSessionCache::find(const unsigned char* sid, unsigned int sid_len) const {
+    auto const* h = header();
+    auto const set = static_cast<unsigned int>(fnv1a(sid, sid_len) % (h->slots / h->ways));
+
+    for(unsigned int w = 0; w < h->ways; ++w) {
+        auto* s = slot(set * h->ways + w);
+        if(s->expires != 0 and s->sid_len == sid_len and ::memcmp(s->sid, sid, sid_len) == 0) {
+            return s;
+        }
+    }
+    return nullptr;
+}
+
+bool SharedSessionCache::store(SSL_SESSION* sess) {
+
+    if(not attached() or not sess) return false;
+
+    unsigned int sid_len = 0;
+    auto const* sid = SSL_SESSION_get_id(sess, &sid_len);
+    if(sid_len == 0 or sid_len > SSL_MAX_SSL_SESSION_ID_LENGTH) return false;
+
+    int const der_len = i2d_SSL_SESSION(sess, nullptr);
+    if(der_len <= 0 or static_cast<unsigned int>(der_len) > data_size()) {
+        ++stats_t::too_big;
+        _dia("SharedSessionCache::store: session of %dB doesn't fit in the slot", der_len);
+        return false;
+    }
+
+    // serialize outside of the lock
+    std::vector<unsigned char> der(der_len);
+    auto* p = der.data();
+    i2d_SSL_SESSION(sess, &p);
+
+    auto const now = static_cast<int64_t>(time(nullptr));
+    auto const expires = static_cast<int64_t>(SSL_SESSION_get_time(sess)) + SSL_SESSION_get_timeout(sess);
+    if(expires <= now) return false;
+
+    if(not lock()) return false;
+
+    auto* target = find(sid, sid_len);
+    if(not target) {
+        auto const* h = header();
+        auto const set = static_cast<unsigned int>(fnv1a(sid, sid_len) % (h->slots / h->ways));
+
+        for(unsigned int w = 0; w < h->ways; ++w) {
+            auto* s = slot(set * h->ways + w);
+            if(s->expires <= now) {
+                target = s;
+                break;
+            }
+            if(not target or s->stored < target->stored) {
+                target = s;
+            }
+        }
+        if(target->expires > now) ++stats_t::evicted;
+    }
+
+    // slot is unused until it's complete, even if this process dies in the middle
+    target->expires = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    target->stored = now;
+    target->sid_len = sid_len;
+    ::memcpy(target->sid, sid, sid_len);
+    target->der_len = der_len;
+    ::memcpy(reinterpret_cast<unsigned char*>(target) + sizeof(slot_t), der.data(), der_len);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    target->expires = expires;
+
+    unlock();
+
+    ++stats_t::stored;
+    _deb("SharedSessionCache::store: session %s stored", hex_print(sid, sid_len).c_str());
+    return true;
+}
+
+SSL_SESSION* SharedSessionCache::load(const unsigned char* sid, unsigned int sid_len) {
+
+    if(not attached() or sid_len == 0 or sid_len > SSL_MAX_SSL_SESSION_ID_LENGTH) return nullptr;
+
+    std::vector<unsigned char> der;
+
+    if(not lock()) return nullptr;
+
+    if(auto* s = find(sid, sid_len); s) {
+        if(s->expires > static_cast<int64_t>(time(nullptr))) {
+            auto const* d = reinterpret_cast<unsigned char*>(s) + sizeof(slot_t);
+            der.assign(d, d + s->der_len);
+        } else {
+            s->expires = 0;
+        }
+    }
+
+    unlock();
+
+    if(der.empty()) {
+        ++stats_t::misses;
+        _deb("SharedSessionCache::load: session %s not found", hex_print(sid, sid_len).c_str());
+        return nullptr;
+    }
+
+    const unsigned char* p = der.data();
+    auto* sess = d2i_SSL_SESSION(nullptr, &p, static_cast<long>(der.size()));
+    if(not sess) {
+        ++stats_t::misses;
+        _err("SharedSessionCache::load: session %s cannot be parsed", hex_print(sid, sid_len).c_str());
+        return nullptr;
+    }
+
+    ++stats_t::hits;
+    _deb("SharedSessionCache::load: session %s found", hex_print(sid, sid_len).c_str());
+    return sess;
+}
+
+bool SharedSessionCache::remove(const unsigned char* sid, unsigned int sid_len) {
+
+    if(not attached() or sid_len == 0 or sid_len > SSL_MAX_SSL_SESSION_ID_LENGTH) return false;
+    if(not lock()) return false;
+
+    auto* s = find(sid, sid_len);
+    if(s) s->expires = 0;
+
+    unlock();
+    return s != nullptr;
+}
+
+#ifdef USE_OPENSSL300
+int SharedSessionCache::ticket_key(unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc) {
+
+    if(not attached() or not lock()) return 0;
+
+    auto const now = static_cast<int64_t>(time(nullptr));
+    auto const lifetime = params_t::ticket_key_lifetime.load();
+
+    auto* h = header();
+    if(enc and now - h->keys[0].created >= lifetime) {
+        rotate_keys(now);
+    }
+    ticket_key_t keys[2] = { h->keys[0], h->keys[1] };
+
+    unlock();
+
+    auto set_mac = [hctx](ticket_key_t& k) {
+        char digest[] = "sha256";
+        OSSL_PARAM params[] = {
+                OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, k.hmac, sizeof(k.hmac)),
+                OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+                OSSL_PARAM_construct_end()
+        };
+        return EVP_MAC_CTX_set_params(hctx, params) == 1;
+    };
+
+    if(enc) {
+        auto& k = keys[0];
+        ::memcpy(key_name, k.name, sizeof(k.name));
+
+        if(RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1
+           or EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr, k.aes, iv) != 1
+           or not set_mac(k)) {
+            return -1;
+        }
+
+        ++stats_t::tickets_issued;
+        return 1;
+    }
+
+    // previous key decrypts tickets issued before the last rotation, for one more lifetime
+    for(unsigned int i = 0; i < 2; ++i) {
+        auto& k = keys[i];
+        if(k.created == 0 or (i > 0 and now - k.created >= 2 * lifetime)) continue;
+        if(::memcmp(key_name, k.name, sizeof(k.name)) != 0) continue;
+
+        if(EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr, k.aes, iv) != 1 or not set_mac(k)) {
+            return -1;
+        }
+
+        ++stats_t::tickets_decrypted;
+        if(i > 0) {
+            ++stats_t::tickets_renewed;
+            return 2;
+        }
+        return 1;
+    }
+
+    ++stats_t::tickets_unknown;
+    _deb("SharedSessionCache::ticket_key: unknown key %s", hex_print(key_name, key_name_sz).c_str());
+    return 0;
+}
+#endif
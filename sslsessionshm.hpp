@@ -0,0 +1,151 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLSESSIONSHM_HPP
+#define SSLSESSIONSHM_HPP
+
+#include <atomic>
+#include <string>
+
+#include <pthread.h>
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+
+#include <socle_common.hpp>
+#include <display.hpp>
+#include <shmbuffer.hpp>
+
+//! TLS server session cache and ticket keys in shared memory.
+/*!
+ *  Every worker (thread or process) attached to the same shared memory name is able to resume sessions
+ *  established by any other one:
+ *  - stateful sessions (session IDs, TLS 1.3 stateful tickets) are stored DER serialized in fixed size slots,
+ *    hashed by session ID into sets of params_t::ways slots, oldest slot in a set is replaced.
+ *  - TLS session tickets are encrypted by keys kept in the shared header. Current key is rotated
+ *    by whichever worker notices it's older than params_t::ticket_key_lifetime, previous key is still
+ *    accepted for decryption (and the ticket is renewed).
+ *
+ *  Access is serialized by a robust process-shared mutex in the shared header, so a worker dying while holding it
+ *  doesn't block the others: the next one takes the lock over (stats_t::owner_died). Waiting for it is bounded
+ *  by params_t::lock_timeout_ms, on timeout the operation behaves like a cache miss.
+ */
+class SharedSessionCache : public shared_buffer {
+public:
+    struct params_t {
+        static inline std::string name = "/socle_tls_sessions";   // shm object; shared_buffer semaphore gets ".lock" suffix
+        static inline std::atomic<unsigned int> slots = 16384;       // geometry must be the same in all workers
+        static inline std::atomic<unsigned int> slot_size = 2048;
+        static inline std::atomic<unsigned int> ways = 4;
+        static inline std::atomic<long> ticket_key_lifetime = 3600;   // seconds
+        static inline std::atomic<long> lock_timeout_ms = 50;
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> hits {0};
+        static inline std::atomic<std::size_t> misses {0};
+        static inline std::atomic<std::size_t> stored {0};
+        static inline std::atomic<std::size_t> evicted {0};         // valid session replaced by a new one
+        static inline std::atomic<std::size_t> too_big {0};
+        static inline std::atomic<std::size_t> tickets_issued {0};
+        static inline std::atomic<std::size_t> tickets_decrypted {0};
+        static inline std::atomic<std::size_t> tickets_renewed {0};  // decrypted by the previous key
+        static inline std::atomic<std::size_t> tickets_unknown {0};
+        static inline std::atomic<std::size_t> key_rotations {0};
+        static inline std::atomic<std::size_t> lock_timeouts {0};
+        static inline std::atomic<std::size_t> owner_died {0};      // lock taken over from a dead worker
+    };
+
+    explicit SharedSessionCache(std::string name = params_t::name) : name_(std::move(name)) {};
+    ~SharedSessionCache();
+
+    SharedSessionCache(SharedSessionCache const&) = delete;
+    SharedSessionCache& operator=(SharedSessionCache const&) = delete;
+
+    /// @brief map shared memory, create and initialize it if it doesn't exist yet
+    bool attach();
+    /// @brief remove shared memory and semaphore names from the system. Attached workers are not affected.
+    static void unlink(std::string const& name);
+
+    /// @brief store server session. Caller keeps its reference.
+    bool store(SSL_SESSION* sess);
+    /// @brief returns new session (owned by caller), or nullptr if not found or expired.
+    SSL_SESSION* load(const unsigned char* sid, unsigned int sid_len);
+    bool remove(const unsigned char* sid, unsigned int sid_len);
+
+#ifdef USE_OPENSSL300
+    /// @brief ticket key callback body, see SSL_CTX_set_tlsext_ticket_key_evp_cb()
+    int ticket_key(unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc);
+#endif
+
+    unsigned int slot_count() const { return header() ? header()->slots : 0; }
+    std::string const& name() const { return name_; }
+
+    static constexpr unsigned int key_name_sz = 16;
+
+protected:
+    bool lock();
+    void unlock();
+
+private:
+    static constexpr uint32_t magic = 0x534f4353;   // "SOCS"
+
+    struct ticket_key_t {
+        unsigned char name[key_name_sz];
+        unsigned char aes[32];
+        unsigned char hmac[32];
+        int64_t created;
+    };
+
+    struct header_t {
+        uint32_t magic;                 // set last, header is initialized again if its initializer died
+        std::atomic<uint32_t> mutex_state;  // 0: fresh memory, 1: mutex being initialized, 2: mutex ready
+        pthread_mutex_t mutex;
+        uint32_t slots;
+        uint32_t slot_size;
+        uint32_t ways;
+        // [0] current, [1] previous
+        ticket_key_t keys[2];
+    };
+
+    struct slot_t {
+        int64_t expires;    // 0: slot is free
+        int64_t stored;
+        uint32_t sid_len;
+        uint32_t der_len;
+        unsigned char sid[SSL_MAX_SSL_SESSION_ID_LENGTH];
+        // der_len bytes of DER encoded session follow
+    };
+
+    header_t* header() const { return attached() ? reinterpret_cast<header_t*>(data_) : nullptr; }
+    slot_t* slot(unsigned int index) const;
+    unsigned int data_size() const { return header()->slot_size - sizeof(slot_t); }
+    slot_t* find(const unsigned char* sid, unsigned int sid_len) const;
+
+    bool initialize_mutex();
+
+    // both called locked
+    bool initialize_header();
+    bool rotate_keys(int64_t now);
+
+    std::string const name_;
+
+    logan_lite log {"com.tls.session.shm"};
+};
+
+#endif //SSLSESSIONSHM_HPP
@@ -0,0 +1,181 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <sslspoofpool.hpp>
+#include <log/logger.hpp>
+
+
+namespace {
+    // take one more reference of everything in the chain, released by CertificateChainCtx::release()
+    void chain_up_ref(CertificateChainCtx const& c) {
+#ifdef USE_OPENSSL11
+        if(c.chain.key) EVP_PKEY_up_ref(c.chain.key);
+        if(c.chain.cert) X509_up_ref(c.chain.cert);
+        if(c.ctx) SSL_CTX_up_ref(c.ctx);
+#else
+        if(c.chain.key) CRYPTO_add(&c.chain.key->references,+1,CRYPTO_LOCK_EVP_PKEY);
+        if(c.chain.cert) CRYPTO_add(&c.chain.cert->references,+1,CRYPTO_LOCK_X509);
+        if(c.ctx) CRYPTO_add(&c.ctx->references,+1,CRYPTO_LOCK_SSL_CTX);
+#endif
+    }
+}
+
+
+SpoofPool::job_t::job_t(std::string key, X509* cert, bool ss, std::vector<std::string> s) :
+        store_key(std::move(key)), cert_orig(cert), self_signed(ss), sans(std::move(s)) {
+#ifdef USE_OPENSSL11
+    X509_up_ref(cert_orig);
+#else
+    CRYPTO_add(&cert_orig->references,+1,CRYPTO_LOCK_X509);
+#endif
+    notify_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+SpoofPool::job_t::~job_t() {
+    result.release();
+    X509_free(cert_orig);
+    if(notify_fd_ >= 0) ::close(notify_fd_);
+}
+
+
+SpoofPool::~SpoofPool() {
+    {
+        auto l_ = std::scoped_lock(lock_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    for(auto& t: workers_) {
+        if(t.joinable()) t.join();
+    }
+}
+
+void SpoofPool::start() {
+    // called with lock_ held
+    if(not workers_.empty()) return;
+
+    auto n = std::max(1U, params_t::threads.load());
+    for(unsigned int i = 0; i < n; ++i) {
+        workers_.emplace_back([this]() { worker(); });
+    }
+    _dia("SpoofPool::start: %d threads", n);
+}
+
+SpoofPool::job_ptr SpoofPool::submit(std::string const& store_key, X509* cert_orig, bool self_signed,
+                                     std::vector<std::string> const& sans) {
+    if(not cert_orig) return nullptr;
+
+    job_ptr job;
+    {
+        auto l_ = std::scoped_lock(lock_);
+
+        auto it = inflight_.find(store_key);
+        if(it != inflight_.end()) {
+            ++stats_t::joined;
+            _dia("SpoofPool::submit: joined running job for '%s'", store_key.c_str());
+            return it->second;
+        }
+
+        job = std::make_shared<job_t>(store_key, cert_orig, self_signed, sans);
+        if(job->notify_fd_ < 0) {
+            _err("SpoofPool::submit[%s]: cannot create eventfd", store_key.c_str());
+            return nullptr;
+        }
+
+        start();
+        inflight_[store_key] = job;
+        queue_.push_back(job);
+    }
+    cv_.notify_one();
+
+    ++stats_t::submitted;
+    _dia("SpoofPool::submit: queued '%s'", store_key.c_str());
+    return job;
+}
+
+void SpoofPool::process(job_t& job) {
+
+    auto& fac = SSLFactory::factory();
+
+    {
+        // certificate could have been created by synchronous spoof meanwhile
+        auto lc_ = std::scoped_lock(fac.lock());
+        auto cached = fac.find_mitm(job.store_key);
+        if(cached.has_value()) {
+            job.result = cached.value();
+            chain_up_ref(job.result);
+
+            ++stats_t::cache_hits;
+            finish(job, job_t::state_t::DONE);
+            return;
+        }
+    }
+
+    auto spoof_ret = fac.spoof_or_load(job.store_key, job.cert_orig, job.self_signed, &job.sans);
+    if(not spoof_ret.has_value()) {
+        _war("SpoofPool::process: failed to spoof '%s'", job.store_key.c_str());
+        ++stats_t::failed;
+        finish(job, job_t::state_t::FAILED);
+        return;
+    }
+
+    // spoofed references go to the cache, take one more of both for this job
+    auto const& chain = spoof_ret.value();
+    chain_up_ref(chain);
+
+    if(not fac.add_mitm(job.store_key, chain)) {
+        // not owned by cache
+        EVP_PKEY_free(chain.chain.key);
+        X509_free(chain.chain.cert);
+    }
+
+    job.result = chain;
+    ++stats_t::spoofed;
+    finish(job, job_t::state_t::DONE);
+
+    _dia("SpoofPool::process: spoofed '%s'", job.store_key.c_str());
+}
+
+void SpoofPool::finish(job_t& job, job_t::state_t st) {
+    job.state = st;
+    eventfd_write(job.notify_fd_, 1);
+}
+
+void SpoofPool::worker() {
+
+    while(true) {
+        job_ptr job;
+        {
+            auto l_ = std::unique_lock(lock_);
+            cv_.wait(l_, [this]() { return stop_ or not queue_.empty(); });
+
+            if(stop_) return;
+
+            job = queue_.front();
+            queue_.pop_front();
+        }
+
+        process(*job);
+
+        auto l_ = std::scoped_lock(lock_);
+        inflight_.erase(job->store_key);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+    Socle - Socket Library Ecosystem
+    Copyright (c) 2014, Ales Stibal <astib@mag0.net>, All rights reserved.
+
+    This library  is free  software;  you can redistribute  it and/or
+    modify  it  under   the  terms of the  GNU Lesser  General Public
+    License  as published by  the   Free Software Foundation;  either
+    version 3.0 of the License, or (at your option) any later version.
+    This library is  distributed  in the hope that  it will be useful,
+    but WITHOUT ANY WARRANTY;  without  even  the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+    See the GNU Lesser General Public License for more details.
+
+    You  should have received a copy of the GNU Lesser General Public
+    License along with this library.
+*/
+
+#ifndef SSLSPOOFPOOL_HPP
+#define SSLSPOOFPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sslcertstore.hpp>
+
+//! Thread pool creating spoofed certificates out of the worker event loop.
+/*!
+ *  Jobs are keyed by the same store key as used for the mitm certificate cache. Concurrent requests for the
+ *  same key share single job, so each certificate is signed just once. Result is inserted into the cache
+ *  by the pool thread. Each job carries an eventfd which becomes readable once the job is finished: the
+ *  requesting SSLCom monitors it in place of its socket and resumes the handshake on its event.
+ */
+class SpoofPool {
+public:
+    struct params_t {
+        static inline std::atomic<unsigned int> threads = 2;
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> submitted {0};
+        static inline std::atomic<std::size_t> joined {0};       // requests served by already running job
+        static inline std::atomic<std::size_t> cache_hits {0};   // certificate cached meanwhile, not spoofed
+        static inline std::atomic<std::size_t> spoofed {0};
+        static inline std::atomic<std::size_t> failed {0};
+    };
+
+    struct job_t {
+        enum class state_t { PENDING, DONE, FAILED };
+
+        job_t(std::string key, X509* cert_orig, bool self_signed, std::vector<std::string> sans);
+        ~job_t();
+
+        job_t(job_t const&) = delete;
+        job_t& operator=(job_t const&) = delete;
+
+        std::string const store_key;
+        X509* const cert_orig;                 // referenced by job
+        bool const self_signed;
+        std::vector<std::string> sans;
+
+        std::atomic<state_t> state = state_t::PENDING;
+
+        // valid once state is DONE; cert and key are referenced by job until it's destroyed
+        CertificateChainCtx result;
+
+        [[nodiscard]] int notify_fd() const { return notify_fd_; }
+        [[nodiscard]] bool ready() const { return state != state_t::PENDING; }
+
+    private:
+        friend class SpoofPool;
+        int notify_fd_ = -1;          // eventfd, readable when job is not PENDING anymore
+    };
+    using job_ptr = std::shared_ptr<job_t>;
+
+    static SpoofPool& get() {
+        static SpoofPool p;
+        return p;
+    }
+
+    /// @brief request spoofed certificate. Running job for the same store key is returned if there is one.
+    job_ptr submit(std::string const& store_key, X509* cert_orig, bool self_signed, std::vector<std::string> const& sans);
+
+    ~SpoofPool();
+
+    SpoofPool(SpoofPool const&) = delete;
+    SpoofPool& operator=(SpoofPool const&) = delete;
+
+private:
+    SpoofPool() = default;
+
+    void start();
+    void worker();
+    void process(job_t& job);
+    static void finish(job_t& job, job_t::state_t st);
+
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::deque<job_ptr> queue_;
+    std::unordered_map<std::string, job_ptr> inflight_;
+    std::vector<std::thread> workers_;
+    bool stop_ = false;
+
+    logan_lite log {"com.tls.spoofpool"};
+};
+
+#endif //SSLSPOOFPOOL_HPP
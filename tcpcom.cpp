@@ -18,6 +18,11 @@
 #include <tcpcom.hpp>
 #include <socketinfo.hpp>
 #include <internet.hpp>
+#include <resolver.hpp>
+
+#include <ctime>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
 
 #include <vars.hpp>
 #include <convert.hpp>
@@ -46,8 +51,7 @@ bool TCPCom::make_transparent(int sfd) {
 
 int TCPCom::connect(const char* host, const char* port) {
     struct addrinfo hints{};
-    struct addrinfo *gai_result, *rp;
-    int sfd = -1;
+    struct addrinfo *gai_result;
     int gai;
 
     /* Obtain address(es) matching host/port */
@@ -58,6 +62,26 @@ int TCPCom::connect(const char* host, const char* port) {
     hints.ai_flags = 0;
     hints.ai_protocol = 0;          /* Any protocol */
 
+    // state of previous connect attempt
+    resolving_.reset();
+    resolve_failed_ = false;
+
+    bool numeric = inet::is_ipv4_address(host) or inet::is_ipv6_address(host);
+
+    if(config_t::async_dns and not numeric and not GLOBAL_IO_BLOCKING()) {
+
+        auto req = inet::Resolver::get().submit(host, port, hints);
+        int placeholder = req ? ::dup(req->notify_fd()) : -1;
+
+        if(placeholder >= 0) {
+            // placeholder becomes readable when resolver is done, then it's replaced by connected socket
+            _dia("TCPCom::connect[%s:%s]: resolving asynchronously, placeholder socket %d", host, port, placeholder);
+            resolving_ = std::move(req);
+            return socket(placeholder);
+        }
+        _dia("TCPCom::connect[%s:%s]: async resolver not available, resolving synchronously", host, port);
+    }
+
     gai = getaddrinfo(host, port, &hints, &gai_result);
     if (gai != 0) {
         _deb("TCPCom::connect[%s:%s]: getaddrinfo: %s", host, port, gai_strerror(gai));
@@ -66,6 +90,57 @@ int TCPCom::connect(const char* host, const char* port) {
 
     auto gai_r = raw::lax<addrinfo*>(gai_result, [](auto& r) { freeaddrinfo(r); } );
 
+    return socket(connect_to(host, port, gai_result));
+}
+
+bool TCPCom::resolving() {
+
+    if(not resolving_) return false;
+    if(not resolving_->ready()) return true;
+
+    // request (and its eventfd) is released at the end of this scope
+    auto req = std::move(resolving_);
+    int placeholder = socket();
+
+    if(req->state == inet::Resolver::request_t::state_t::DONE) {
+        int sfd = connect_to(req->host.c_str(), req->port.c_str(), req->result);
+
+        if(sfd >= 0) {
+            // keep socket number already known to owner and poller
+            ::dup2(sfd, placeholder);
+            ::close(sfd);
+
+            // poller registration was bound to placeholder's file, register connecting socket
+            set_write_monitor(placeholder);
+
+            _dia("TCPCom::resolving[%s:%s]: resolved, socket %d connecting", req->host.c_str(), req->port.c_str(), placeholder);
+            return false;
+        }
+    }
+    else {
+        _dia("TCPCom::resolving[%s:%s]: getaddrinfo: %s", req->host.c_str(), req->port.c_str(), gai_strerror(req->gai_error));
+    }
+
+    resolve_failed_ = true;
+    return false;
+}
+
+ssize_t TCPCom::read(int _fd, void* _buf, size_t _n, int _flags) {
+
+    if(resolving()) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if(resolve_failed_) return 0;
+
+    return ::recv(_fd, _buf, _n, _flags);
+}
+
+int TCPCom::connect_to(const char* host, const char* port, addrinfo* gai_result) {
+
+    struct addrinfo *rp;
+    int sfd = -1;
+
     /* getaddrinfo() returns a list of address structures.
     Try each address until we successfully connect(2).
     If socket(2) (or connect(2)) fails, we (close the socket
@@ -95,8 +170,20 @@ int TCPCom::connect(const char* host, const char* port) {
         if (not GLOBAL_IO_BLOCKING()) {
             unblock(sfd);
 
+            bool tfo = config_t::fastopen and so_fastopen_connect(sfd) == 0;
+            if(tfo) fastopen_stats_t::requested++;
+
             if (::connect(sfd, rp->ai_addr, rp->ai_addrlen) == 0) {
-                _deb("TCPCom::connect[%s:%s]: socket[%d]: connect successful", host, port, sfd);
+                if(tfo) {
+                    // no SYN sent yet, it will go out with first write
+                    _deb("TCPCom::connect[%s:%s]: socket[%d]: fastopen connect deferred", host, port, sfd);
+                    fastopen_stats_t::deferred++;
+                    fastopen_.mode = fastopen_state_t::mode_t::DEFERRED;
+                    fastopen_.since = std::chrono::steady_clock::now();
+                }
+                else {
+                    _deb("TCPCom::connect[%s:%s]: socket[%d]: connect successful", host, port, sfd);
+                }
                 connect_proven = true;
                 break;
             }
@@ -124,8 +211,7 @@ int TCPCom::connect(const char* host, const char* port) {
         _err("TCPCom::connect[%s:%s]: socket[%d]: connect failed", host, port, sfd);
     }
 
-    return socket(sfd);
-
+    return sfd;
 }
 
 int TCPCom::bind(unsigned short port) {
@@ -198,6 +284,8 @@ bool TCPCom::is_connected(int s) {
     // we already **know** connection was established
     if(connect_proven) return true;
 
+    if(resolving() or resolve_failed_) return false;
+
     if(socket() == 0) {
         _deb("TCPCom::is_connected: called for non-connecting socket");
         return true;
@@ -284,3 +372,166 @@ void TCPCom::on_new_socket(int _fd) {
 
     baseCom::on_new_socket(_fd);
 }
+
+
+int TCPCom::so_fastopen_connect(int sock) const {
+    constexpr int optval = 1;
+    int sso = setsockopt(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &optval, sizeof optval);
+    if(sso != 0) err_errno(string_format("TCPCom::so_fastopen_connect: setsockopt[%d]", sock).c_str(),
+                           "IPPROTO_TCP/TCP_FASTOPEN_CONNECT", sso);
+    return sso;
+}
+
+void TCPCom::cleanup() {
+
+    // find out if server took payload from our SYN
+    if(fastopen_.mode != fastopen_state_t::mode_t::NONE and socket() > 0) {
+        tcp_info ti {};
+        socklen_t len = sizeof(ti);
+
+        if(getsockopt(socket(), IPPROTO_TCP, TCP_INFO, &ti, &len) == 0 and (ti.tcpi_options & TCPI_OPT_SYN_DATA)) {
+            fastopen_stats_t::accepted++;
+            _dia("TCPCom::cleanup[%d]: fastopen data accepted by server", socket());
+        }
+        fastopen_.mode = fastopen_state_t::mode_t::NONE;
+    }
+}
+
+ssize_t TCPCom::write(int _fd, const void* _buf, size_t _n, int _flags) {
+
+    if(resolving()) return 0;
+    if(resolve_failed_) return -1;
+
+    if(fastopen_.mode == fastopen_state_t::mode_t::DEFERRED) {
+
+        auto waiting = std::chrono::steady_clock::now() - fastopen_.since;
+        if(_n == 0 and waiting < std::chrono::milliseconds(config_t::fastopen_wait_ms)) {
+            // nothing to put into SYN yet: don't spin on always-writable deferred socket, check again later
+            change_monitor(_fd, EPOLLIN);
+            rescan_write(_fd);
+            return 0;
+        }
+
+        fastopen_.mode = fastopen_state_t::mode_t::SENT;
+        if(_n > 0) {
+            fastopen_.syn_data = true;
+            fastopen_stats_t::syn_data++;
+            _deb("TCPCom::write[%d]: fastopen SYN with %d bytes", _fd, _n);
+        }
+        else {
+            fastopen_stats_t::syn_empty++;
+            _deb("TCPCom::write[%d]: fastopen SYN without data", _fd);
+        }
+    }
+
+    bool zc = _flags & MSG_ZEROCOPY;
+    auto r = ::send(_fd, _buf, _n, _flags);
+
+    if(r < 0 and zc and errno == ENOBUFS) {
+        // out of optmem for notifications: send it usual way
+        _dia("TCPCom::write[%d]: zerocopy send not possible, copying", _fd);
+
+        zc = false;
+        r = ::send(_fd, _buf, _n, _flags & ~MSG_ZEROCOPY);
+    }
+
+    zerocopy_.last_write = zc and r > 0;
+
+    if(r < 0) {
+        // EINPROGRESS: fastopen SYN sent without data, handshake continues
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS) {
+            return 0;
+        }
+    }
+    return r;
+}
+
+bool TCPCom::zerocopy_wanted(int _fd, std::size_t len) {
+
+    auto zc_min = config_t::zerocopy_min.load();
+    if(zc_min == 0 or len < zc_min or _fd <= 0) return false;
+
+    using mode_t = zerocopy_state_t::mode_t;
+
+    if(zerocopy_.mode == mode_t::UNKNOWN) {
+        if(so_zerocopy(_fd) == 0) {
+            _dia("TCPCom::zerocopy_wanted[%d]: zerocopy enabled", _fd);
+            zerocopy_.mode = mode_t::ON;
+            master()->poller.errqueue_watch(_fd);
+        } else {
+            zerocopy_.mode = mode_t::OFF;
+        }
+    }
+
+    return zerocopy_.mode == mode_t::ON;
+}
+
+void TCPCom::zerocopy_pin(buffer&& sent) {
+
+    // not really sent zerocopy: no notification will come, release buffer right away
+    if(not zerocopy_.last_write) return;
+
+    zerocopy_.last_write = false;
+    zerocopy_.cnt_sent++;
+    zerocopy_.pinned.emplace_back(zerocopy_.next_id++, std::move(sent));
+
+    _deb("TCPCom::zerocopy_pin: %d buffers pinned", zerocopy_.pinned.size());
+}
+
+std::size_t TCPCom::zerocopy_reap(int _fd) {
+
+    if(zerocopy_.pinned.empty()) return 0L;
+
+    std::size_t released = 0L;
+
+    while(true) {
+        std::array<unsigned char, 128> control {};
+        msghdr msg {};
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+
+        if(::recvmsg(_fd, &msg, MSG_ERRQUEUE) < 0) {
+            // EAGAIN: no more notifications
+            break;
+        }
+
+        for(auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+
+            bool is_recverr = (cmsg->cmsg_level == SOL_IP and cmsg->cmsg_type == IP_RECVERR)
+                            or (cmsg->cmsg_level == SOL_IPV6 and cmsg->cmsg_type == IPV6_RECVERR);
+            if(not is_recverr) continue;
+
+            sock_extended_err serr {};
+            std::memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if(serr.ee_errno != 0 or serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+            // completion of zerocopy sends with ids in range <lo, hi>
+            uint32_t lo = serr.ee_info;
+            uint32_t hi = serr.ee_data;
+            auto range_len = hi - lo + 1;
+
+            zerocopy_.cnt_completed += range_len;
+
+            if(serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                // ie. loopback or device without scatter-gather: zerocopy only adds overhead
+                zerocopy_.cnt_copied += range_len;
+                if(zerocopy_.mode == zerocopy_state_t::mode_t::ON) {
+                    _dia("TCPCom::zerocopy_reap[%d]: kernel copied data, disabling zerocopy", _fd);
+                    zerocopy_.mode = zerocopy_state_t::mode_t::OFF;
+                }
+            }
+
+            auto before = zerocopy_.pinned.size();
+            zerocopy_.pinned.erase(std::remove_if(zerocopy_.pinned.begin(), zerocopy_.pinned.end(),
+                                                  [lo, range_len](auto const& p) { return p.first - lo < range_len; }),
+                                   zerocopy_.pinned.end());
+            released += before - zerocopy_.pinned.size();
+        }
+    }
+
+    if(released > 0) {
+        _deb("TCPCom::zerocopy_reap[%d]: %d buffers released, %d still pinned", _fd, released, zerocopy_.pinned.size());
+    }
+
+    return released;
+}
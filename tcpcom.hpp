@@ -31,9 +31,12 @@
 #include <unistd.h>
 
 #include <ctime>
+#include <chrono>
+#include <deque>
 
 #include <log/logger.hpp>
 #include <basecom.hpp>
+#include <resolver.hpp>
 #include <display.hpp>
 
 class TCPCom : public virtual baseCom {
@@ -47,39 +50,85 @@ public:
         unsigned char _x{0};
         static inline int listen_backlog = 50;
 
+        // writes of at least this size are sent with MSG_ZEROCOPY, 0 disables it
+        static inline std::atomic<std::size_t> zerocopy_min = 0;
+
+        // connect with TCP_FASTOPEN_CONNECT: SYN is deferred to the first write and carries its payload
+        static inline std::atomic_bool fastopen = false;
+        // how long to wait for payload before sending SYN without it (server-speaks-first protocols)
+        static inline std::atomic<unsigned int> fastopen_wait_ms = 50;
+
+        // resolve hostnames in connect() by inet::Resolver threads instead of blocking getaddrinfo()
+        static inline std::atomic_bool async_dns = false;
+
     } config;
+
+    struct fastopen_stats_t {
+        static inline std::atomic<std::size_t> requested {0};  // sockets with TCP_FASTOPEN_CONNECT set
+        static inline std::atomic<std::size_t> deferred {0};   // connects where kernel deferred SYN (cookie/sysctl allowed it)
+        static inline std::atomic<std::size_t> syn_data {0};   // first write carried payload in SYN
+        static inline std::atomic<std::size_t> syn_empty {0};  // no payload came in time, plain SYN sent
+        static inline std::atomic<std::size_t> accepted {0};   // server acknowledged payload in SYN
+    };
+
+    struct fastopen_state_t {
+        enum class mode_t { NONE, DEFERRED, SENT };
+        mode_t mode = mode_t::NONE;
+
+        std::chrono::steady_clock::time_point since {};
+        bool syn_data = false;
+    };
+    fastopen_state_t const& fastopen() const { return fastopen_; }
+
+    // MSG_ZEROCOPY state: sent buffers are pinned until kernel reports completion on socket error queue
+    struct zerocopy_state_t {
+        enum class mode_t { UNKNOWN, ON, OFF };
+        mode_t mode = mode_t::UNKNOWN;
+
+        bool last_write = false;   // last write was really sent with MSG_ZEROCOPY
+        uint32_t next_id = 0;      // kernel counts successful zerocopy sends per socket, starting at 0
+        std::deque<std::pair<uint32_t, buffer>> pinned;
+
+        std::size_t cnt_sent = 0L;
+        std::size_t cnt_completed = 0L;
+        std::size_t cnt_copied = 0L;   // completions where kernel had to copy anyway
+    };
+    zerocopy_state_t const& zerocopy() const { return zerocopy_; }
     
     void init(baseHostCX* owner) override;
     baseCom* replicate() override { return new TCPCom(); };
     
     int connect(const char* host, const char* port) override;
     bool make_transparent(int sfd);
+    int so_fastopen_connect(int sock) const;
+
+    // true while async hostname lookup is running; once done, connects and replaces placeholder socket
+    bool resolving() override;
+    // placeholder (eventfd) is always writable, only its EPOLLIN tells lookup is done
+    bool write_monitor_deferred(int s) const override { return resolving_ and s == socket(); }
 
     int bind(unsigned short port) override;
     int bind(const char* _path) override { return -1; };
     int accept (int sockfd, sockaddr* addr, socklen_t* addrlen_) override;
     
-    ssize_t read(int _fd, void* _buf, size_t _n, int _flags) override { return static_cast<int>(::recv(_fd, _buf, _n, _flags)); };
+    ssize_t read(int _fd, void* _buf, size_t _n, int _flags) override;
     ssize_t peek(int _fd, void* _buf, size_t _n, int _flags) override { return read(_fd, _buf, _n, _flags | MSG_PEEK );};
-    ssize_t write(int _fd, const void* _buf, size_t _n, int _flags) override {
-        auto r = ::send(_fd, _buf, _n, _flags);
-        if(r < 0) {
-            if(errno == EAGAIN || errno == EWOULDBLOCK) {
-                return 0;
-            }
-        }
-        return r;
-    };
+    ssize_t write(int _fd, const void* _buf, size_t _n, int _flags) override;
+
+    bool zerocopy_wanted(int _fd, std::size_t len) override;
+    void zerocopy_pin(buffer&& sent) override;
+    std::size_t zerocopy_reap(int _fd) override;
     void shutdown(int _fd) override {
         int r = ::shutdown(_fd, SHUT_RDWR);
         if(r > 0)
             _dia("%s::shutdown[%d]: %s", c_type(), _fd, string_error().c_str());
     };
     
-    void cleanup() override {};
+    void cleanup() override;
     
     bool is_connected(int s) override;
     bool com_status() override;
+    bool spliceable() const override { return true; }
 
     void on_new_socket(int _fd) override;
 
@@ -96,6 +145,15 @@ protected:
 
     bool connect_proven = false;
 
+    zerocopy_state_t zerocopy_;
+    fastopen_state_t fastopen_;
+
+    // async connect: lookup in progress, socket() is placeholder until it's done
+    inet::Resolver::request_ptr resolving_;
+    bool resolve_failed_ = false;
+
+    int connect_to(const char* host, const char* port, addrinfo* gai_result);
+
     TYPENAME_OVERRIDE("TCPCom")
     DECLARE_LOGGING(to_string)
 
@@ -0,0 +1,66 @@
+#include "test_util.hpp"
+
+#include <sslcertstore.hpp>
+#include <log/logger.hpp>
+
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+
+namespace test_util {
+
+    std::pair<int, int> tcp_pair(int client_rcvbuf) {
+
+        int lsock = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in sa {};
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(lsock, (sockaddr*)&sa, sizeof(sa));
+        ::listen(lsock, 1);
+        socklen_t sl = sizeof(sa);
+        ::getsockname(lsock, (sockaddr*)&sa, &sl);
+
+        int c = ::socket(AF_INET, SOCK_STREAM, 0);
+        if(client_rcvbuf > 0) ::setsockopt(c, SOL_SOCKET, SO_RCVBUF, &client_rcvbuf, sizeof(client_rcvbuf));
+        ::connect(c, (sockaddr*)&sa, sizeof(sa));
+        int s = ::accept(lsock, nullptr, nullptr);
+        ::close(lsock);
+
+        return { c, s };
+    }
+
+    void set_nonblocking(int fd) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    std::string make_certs(std::string const& dir, std::string const& extra_cmd) {
+        std::string cmd =
+                "mkdir -p " + dir + " && cd " + dir + " && "
+                "openssl req -x509 -newkey rsa:2048 -nodes -days 2 -subj /CN=socle-test-ca "
+                "-keyout ca-key.pem -out ca-cert.pem >/dev/null 2>&1 && "
+                "openssl req -x509 -newkey rsa:2048 -nodes -days 2 -subj /CN=socle-test-srv "
+                "-keyout srv-key.pem -out srv-cert.pem >/dev/null 2>&1 && "
+                "cp srv-key.pem cl-key.pem && cp srv-cert.pem cl-cert.pem";
+
+        if(not extra_cmd.empty()) cmd += " && " + extra_cmd;
+
+        return std::system(cmd.c_str()) == 0 ? dir : std::string();
+    }
+
+    SSLFactory* init_factory(std::string const& dir, std::string const& ca_file) {
+        if(dir.empty()) return nullptr;
+
+        Log::init();
+        Log::get()->level(loglevel(iNOT));
+
+        auto& fac = SSLFactory::factory();
+        fac.certs_path() = dir;
+        fac.ca_file() = dir + ca_file;
+        fac.init();
+
+        return &fac;
+    }
+}
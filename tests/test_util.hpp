@@ -0,0 +1,27 @@
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include <string>
+#include <utility>
+
+class SSLFactory;
+
+// fixtures shared by tests, compiled once in test_util.cpp
+namespace test_util {
+
+    // connected loopback TCP sockets: connecting (client) end first, accepted end second.
+    // Non-zero client_rcvbuf fixes client's receive buffer (no autotuning), so the other end can be filled up.
+    std::pair<int, int> tcp_pair(int client_rcvbuf = 0);
+
+    void set_nonblocking(int fd);
+
+    // create CA, server and client certificates with openssl CLI in dir, then run extra_cmd there.
+    // Returns dir, or empty string if openssl CLI failed.
+    std::string make_certs(std::string const& dir, std::string const& extra_cmd = "");
+
+    // point factory to certificates made by make_certs() and trust ca_file from that directory;
+    // nullptr if dir is empty
+    SSLFactory* init_factory(std::string const& dir, std::string const& ca_file);
+}
+
+#endif //TEST_UTIL_HPP
@@ -0,0 +1,80 @@
+#include <tcpcom.hpp>
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+
+// loopback listener, returns listening socket and its port
+static std::pair<int, std::string> listener() {
+
+    int lsock = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in sa {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(lsock, (sockaddr*)&sa, sizeof(sa));
+    ::listen(lsock, 4);
+
+    socklen_t sl = sizeof(sa);
+    ::getsockname(lsock, (sockaddr*)&sa, &sl);
+
+    return { lsock, std::to_string(ntohs(sa.sin_port)) };
+}
+
+// events registered for fd in com's epoll, as kernel reports them
+static unsigned int epoll_events(TCPCom const& com, int fd) {
+
+    std::ifstream info("/proc/self/fdinfo/" + std::to_string(com.poller.poller->epoll_socket()));
+    std::string line;
+    while(std::getline(info, line)) {
+        std::istringstream ls(line);
+        std::string tag;
+        int tfd = -1;
+        std::string events_tag;
+        unsigned int events = 0;
+        if(ls >> tag >> tfd >> events_tag >> std::hex >> events and tag == "tfd:" and tfd == fd) return events;
+    }
+    return 0;
+}
+
+
+TEST(AsyncConnect, PlaceholderNotWriteMonitored) {
+
+    auto [ lsock, port ] = listener();
+    TCPCom::config_t::async_dns = true;
+
+    TCPCom com;
+    int fd = com.connect("localhost", port.c_str());
+    ASSERT_GT(fd, 0);
+    ASSERT_TRUE(com.write_monitor_deferred(fd));
+
+    // owner wants to know when connect finishes, as with any non-blocking connect
+    com.set_write_monitor(fd);
+
+    // placeholder is an eventfd, which is always writable: only EPOLLIN, or the worker would spin
+    auto events = epoll_events(com, fd);
+    ASSERT_TRUE(events & EPOLLIN);
+    ASSERT_FALSE(events & EPOLLOUT);
+
+    for(int i = 0; i < 500 and com.resolving(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // lookup finished: socket is connecting and monitored for writing
+    ASSERT_FALSE(com.resolving());
+    ASSERT_FALSE(com.write_monitor_deferred(fd));
+    ASSERT_TRUE(epoll_events(com, fd) & EPOLLOUT);
+
+    int s = ::accept(lsock, nullptr, nullptr);
+    ASSERT_GT(s, 0);
+
+    TCPCom::config_t::async_dns = false;
+    com.cleanup();
+    ::close(s);
+    ::close(lsock);
+}
@@ -0,0 +1,178 @@
+#include <sslcrlfetch.hpp>
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+
+// empty CRL signed by a throw-away key, DER encoded
+static std::string make_crl() {
+    auto* key = EVP_EC_gen("P-256");
+    auto* crl = X509_CRL_new();
+
+    auto* name = X509_NAME_new();
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"socle-test-crl", -1, -1, 0);
+    X509_CRL_set_issuer_name(crl, name);
+
+    auto* t = ASN1_TIME_new();
+    X509_gmtime_adj(t, 0);
+    X509_CRL_set1_lastUpdate(crl, t);
+    X509_gmtime_adj(t, 3600);
+    X509_CRL_set1_nextUpdate(crl, t);
+    X509_CRL_sign(crl, key, EVP_sha256());
+
+    unsigned char* der = nullptr;
+    int len = i2d_X509_CRL(crl, &der);
+    std::string ret((const char*)der, len);
+
+    OPENSSL_free(der);
+    ASN1_TIME_free(t);
+    X509_NAME_free(name);
+    X509_CRL_free(crl);
+    EVP_PKEY_free(key);
+
+    return ret;
+}
+
+// minimal HTTP/1.0 server answering every request with the same body after a delay
+struct http_server {
+    int lsock = -1;
+    unsigned short port = 0;
+    std::atomic<int> requests = 0;
+    std::atomic_bool stop = false;
+    std::thread th;
+
+    http_server(std::string body, std::chrono::milliseconds delay) {
+        lsock = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in sa {};
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(lsock, (sockaddr*)&sa, sizeof(sa));
+        ::listen(lsock, 16);
+        socklen_t sl = sizeof(sa);
+        ::getsockname(lsock, (sockaddr*)&sa, &sl);
+        port = ntohs(sa.sin_port);
+
+        th = std::thread([this, body, delay]() {
+            while(not stop) {
+                int s = ::accept(lsock, nullptr, nullptr);
+                if(s < 0) break;
+                ++requests;
+
+                std::array<char, 1024> req {};
+                ::recv(s, req.data(), req.size(), 0);
+                std::this_thread::sleep_for(delay);
+
+                auto resp = "HTTP/1.0 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+                ::send(s, resp.data(), resp.size(), MSG_NOSIGNAL);
+                ::close(s);
+            }
+        });
+    }
+    ~http_server() {
+        stop = true;
+        ::shutdown(lsock, SHUT_RDWR);
+        ::close(lsock);
+        th.join();
+    }
+    std::string url(const char* path) const { return "http://127.0.0.1:" + std::to_string(port) + path; }
+};
+
+static bool wait_done(std::string const& url) {
+    for(int i = 0; i < 500 and CrlFetcher::get().pending(url); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return not CrlFetcher::get().pending(url);
+}
+
+
+TEST(CrlFetcher, SingleFlight) {
+
+    Log::init();
+    Log::get()->level(loglevel(iNOT));
+
+    http_server srv(make_crl(), std::chrono::milliseconds(300));
+    auto url = srv.url("/test.crl");
+    auto& cache = SSLFactory::factory().crl_cache();
+
+    // requests don't wait for the download
+    auto joined = CrlFetcher::stats_t::joined.load();
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < 5; ++i) CrlFetcher::get().request(url);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    ASSERT_EQ(CrlFetcher::stats_t::joined, joined + 4);
+
+    ASSERT_TRUE(wait_done(url));
+    ASSERT_EQ(srv.requests, 1);
+
+    auto entry = cache.get(url);
+    ASSERT_NE(entry, nullptr);
+    ASSERT_NE(entry->value()->ptr, nullptr);
+
+    // failure is cached as empty entry
+    auto bad = "http://127.0.0.1:1/none.crl";
+    CrlFetcher::get().request(bad);
+    ASSERT_TRUE(wait_done(bad));
+    auto bad_entry = cache.get(bad);
+    ASSERT_NE(bad_entry, nullptr);
+    ASSERT_EQ(bad_entry->value()->ptr, nullptr);
+}
+
+
+TEST(CrlFetcher, RefreshAhead) {
+
+    http_server srv(make_crl(), std::chrono::milliseconds(0));
+    auto url = srv.url("/refresh.crl");
+
+    auto ttl = SSLFactory::options::crl_status_ttl;
+    auto ahead = CrlFetcher::params_t::refresh_ahead.load();
+    SSLFactory::options::crl_status_ttl = 3;
+    CrlFetcher::params_t::refresh_ahead = 2;
+
+    auto refreshed = CrlFetcher::stats_t::refreshed.load();
+    CrlFetcher::get().request(url);
+
+    // used URL is downloaded again before its entry expires
+    for(int i = 0; i < 40 and srv.requests < 2; ++i) {
+        CrlFetcher::get().touch(url);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_GE(srv.requests, 2);
+    ASSERT_GT(CrlFetcher::stats_t::refreshed, refreshed);
+
+    auto entry = SSLFactory::factory().crl_cache().get(url);
+    ASSERT_NE(entry, nullptr);
+    ASSERT_FALSE(entry->expired());
+
+    SSLFactory::options::crl_status_ttl = ttl;
+    CrlFetcher::params_t::refresh_ahead = ahead;
+    ASSERT_TRUE(wait_done(url));
+}
+
+
+// runs last: stopped fetcher stays stopped
+TEST(CrlFetcher, StopAbortsDownload) {
+
+    http_server srv(make_crl(), std::chrono::milliseconds(2000));
+    auto url = srv.url("/slow.crl");
+
+    CrlFetcher::get().request(url);
+    for(int i = 0; i < 100 and srv.requests == 0; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(srv.requests, 1);
+    ASSERT_TRUE(CrlFetcher::get().pending(url));
+
+    // doesn't wait for the server, nor for download_timeout
+    auto start = std::chrono::steady_clock::now();
+    CrlFetcher::get().stop();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+    // aborted download is not a failure to be cached
+    ASSERT_EQ(SSLFactory::factory().crl_cache().get(url), nullptr);
+
+    CrlFetcher::get().request(url);
+    ASSERT_FALSE(CrlFetcher::get().pending(url));
+}
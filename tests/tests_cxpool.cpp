@@ -0,0 +1,130 @@
+#include <cxpool.hpp>
+#include <sslcom.hpp>
+#include <tcpcom.hpp>
+
+#include <gtest/gtest.h>
+#include "test_util.hpp"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+
+// upstream connection as it looks at the end of a session
+static std::unique_ptr<baseHostCX> upstream(baseCom* com, int fd) {
+    auto cx = std::make_unique<baseHostCX>(com, fd);
+    cx->host("192.0.2.1");
+    cx->port("443");
+    cx->opening(false);
+    cx->unblock();
+    return cx;
+}
+
+// client side com has no peer to report problems to: trust server's self-signed certificate
+static SSLFactory* init_factory() {
+    static auto dir = test_util::make_certs("/tmp/socle_cxpool_certs/");
+    return test_util::init_factory(dir, "srv-cert.pem");
+}
+
+
+TEST(CxPool, ReleaseAcquireResets) {
+
+    auto [ c, s ] = test_util::tcp_pair();
+    auto cx = upstream(new TCPCom(), c);
+
+    // first session is done with it
+    ::send(s, "response", 8, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(cx->read(), 8);
+    cx->finish();
+    cx->reusable(true);
+
+    auto& pool = CxPool::pool();
+    auto parked = pool.stats().parked;
+    ASSERT_TRUE(pool.release(cx));
+    ASSERT_EQ(cx, nullptr);
+    ASSERT_EQ(pool.stats().parked, parked + 1);
+
+    auto again = pool.acquire("192.0.2.1", "443");
+    ASSERT_NE(again, nullptr);
+    ASSERT_EQ(again->socket(), c);
+    ASSERT_EQ(pool.size(), 0);
+
+    // next session starts from scratch and must decide about reuse on its own
+    ASSERT_FALSE(again->reusable());
+    ASSERT_EQ(again->meter_read_bytes, 0);
+    ASSERT_EQ(again->meter_read_count, 0);
+
+    // nothing else parked for this target
+    ASSERT_EQ(pool.acquire("192.0.2.1", "443"), nullptr);
+
+    ::close(s);
+}
+
+TEST(CxPool, UnhealthyDropped) {
+
+    auto& pool = CxPool::pool();
+    auto unhealthy = pool.stats().unhealthy;
+
+    auto [ c1, s1 ] = test_util::tcp_pair();
+    auto [ c2, s2 ] = test_util::tcp_pair();
+    auto closed = upstream(new TCPCom(), c1);
+    auto talking = upstream(new TCPCom(), c2);
+    ASSERT_TRUE(pool.release(closed));
+    ASSERT_TRUE(pool.release(talking));
+
+    // server closes one, sends unsolicited data on the other
+    ::close(s1);
+    ::send(s2, "x", 1, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    ASSERT_EQ(pool.acquire("192.0.2.1", "443"), nullptr);
+    ASSERT_EQ(pool.stats().unhealthy, unhealthy + 2);
+    ASSERT_EQ(pool.size(), 0);
+
+    ::close(s2);
+}
+
+TEST(CxPool, TlsSessionTicketsAreHealthy) {
+
+    auto* fac = init_factory();
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    auto [ c, s ] = test_util::tcp_pair();
+    int one = 1;
+    ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // server sends TLS 1.3 session tickets right after the handshake
+    auto* srv = SSL_new(fac->default_tls_server_cx());
+    SSL_set_fd(srv, s);
+    auto server = std::thread([srv]() { SSL_accept(srv); });
+
+    auto* com = new SSLCom();
+    auto cx = std::make_unique<baseHostCX>(com, c);
+    com->upgrade_client_socket(c);
+    server.join();
+    ASSERT_TRUE(SSL_is_init_finished(com->get_SSL()));
+    if(SSL_version(com->get_SSL()) != TLS1_3_VERSION) GTEST_SKIP() << "TLS 1.3 not negotiated";
+
+    cx->host("192.0.2.1");
+    cx->port("443");
+    cx->opening(false);
+    cx->unblock();
+
+    // tickets are waiting in socket, yet connection is idle
+    unsigned char b = 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_GT(::recv(c, &b, 1, MSG_PEEK | MSG_DONTWAIT), 0);
+    ASSERT_TRUE(CxPool::healthy(cx.get()));
+
+    // application data is not
+    ASSERT_GT(SSL_write(srv, "x", 1), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(CxPool::healthy(cx.get()));
+
+    SSL_free(srv);
+    ::close(s);
+}
@@ -0,0 +1,157 @@
+#include <udpcom.hpp>
+#include <openhashmap.hpp>
+#include <socketinfo.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+// random insert/erase churn checked against std::map
+TEST(DatagramTable, OpenHashMapChurn) {
+
+    open_hash_map<uint32_t, int> m;
+    std::map<uint32_t, int> ref;
+    std::mt19937 rng(1);
+
+    for(int i = 0; i < 200000; ++i) {
+        uint32_t k = rng() % 4096;
+        if(rng() % 3) {
+            m.insert_or_assign(k, i);
+            ref[k] = i;
+        } else {
+            ASSERT_EQ(m.erase(k), ref.erase(k));
+        }
+    }
+
+    ASSERT_EQ(m.size(), ref.size());
+    for(auto const& [k, v]: ref) {
+        auto const* f = m.find(k);
+        ASSERT_NE(f, nullptr);
+        ASSERT_EQ(*f, v);
+    }
+
+    std::size_t visited = 0;
+    m.for_each([&](auto const&, auto const&) { ++visited; });
+    ASSERT_EQ(visited, ref.size());
+}
+
+TEST(DatagramTable, FindSetErase) {
+    DatagramTable t;
+    auto d = std::make_shared<Datagram>();
+
+    uint32_t key = 0x80001234;
+    ASSERT_EQ(t.find(key), nullptr);
+
+    t.set(key, d);
+    ASSERT_EQ(t.find(key), d);
+    ASSERT_EQ(t.size(), 1);
+
+    ASSERT_EQ(t.erase(key), 1);
+    ASSERT_EQ(t.find(key), nullptr);
+    ASSERT_EQ(t.size(), 0);
+}
+
+// flow probed past a colliding record must stay reachable once that record is gone
+TEST(DatagramTable, ProbedRecordLeavesTombstone) {
+    DatagramTable t;
+    auto home = std::make_shared<Datagram>();
+    auto probed = std::make_shared<Datagram>();
+
+    uint32_t key = 0x80001234;
+    auto next = SocketInfo::next_session_key(key);
+
+    home->probed = true;
+    t.set(key, home);
+    t.set(next, probed);
+    ASSERT_EQ(t.size(), 2);
+
+    ASSERT_EQ(t.erase(key), 1);
+    ASSERT_EQ(t.find(key), nullptr);
+    ASSERT_TRUE(t.tombstone(key));
+    ASSERT_EQ(t.size(), 1);
+    ASSERT_EQ(t.find(next), probed);
+
+    // erasing a tombstone is a no-op, reusing it isn't
+    ASSERT_EQ(t.erase(key), 0);
+    t.set(key, home);
+    ASSERT_FALSE(t.tombstone(key));
+    ASSERT_EQ(t.size(), 2);
+
+    // record nobody probed past is erased for good
+    ASSERT_EQ(t.erase(next), 1);
+    ASSERT_FALSE(t.tombstone(next));
+    ASSERT_EQ(t.size(), 1);
+}
+
+
+// Stress benchmark: threads doing session lookups with some session churn.
+// Compares sharded table with former single lock + std::map.
+TEST(DatagramTable, StressBenchmark) {
+
+    constexpr std::size_t ops_per_thread = 200000;
+    constexpr uint32_t sessions = 8192;
+
+    auto make_key = [](uint32_t i) { return SocketInfo::session_key_sign(i * 2654435761U, true); };
+
+    struct single_lock_table {
+        std::recursive_mutex lock;
+        std::map<uint64_t, std::shared_ptr<Datagram>> map;
+
+        std::shared_ptr<Datagram> find(uint32_t k) {
+            auto l_ = std::scoped_lock(lock);
+            auto it = map.find(k);
+            return it != map.end() ? it->second : nullptr;
+        }
+        void set(uint32_t k, std::shared_ptr<Datagram> v) { auto l_ = std::scoped_lock(lock); map[k] = std::move(v); }
+        void erase(uint32_t k) { auto l_ = std::scoped_lock(lock); map.erase(k); }
+    };
+
+    auto run = [&](auto& table, unsigned int threads) -> double {
+        auto proto = std::make_shared<Datagram>();
+        for(uint32_t i = 0; i < sessions; ++i) table.set(make_key(i), proto);
+
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+
+        for(unsigned int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                std::mt19937 rng(t);
+                for(std::size_t i = 0; i < ops_per_thread; ++i) {
+                    auto k = make_key(rng() % sessions);
+
+                    // mostly lookups (every read/write of virtual socket), occasional session replacement
+                    if(i % 64 == 0) {
+                        table.erase(k);
+                        table.set(k, proto);
+                    }
+                    else {
+                        auto r = table.find(k);
+                        (void) r;
+                    }
+                }
+            });
+        }
+        for(auto& w: workers) w.join();
+
+        auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(ops_per_thread * threads) / secs / 1e6;
+    };
+
+    std::cout << "threads   single lock Mops/s   sharded Mops/s\n";
+    for(unsigned int threads: { 1U, 2U, 4U, 8U }) {
+        single_lock_table single;
+        DatagramTable sharded;
+
+        auto a = run(single, threads);
+        auto b = run(sharded, threads);
+        std::cout << string_format("%7d %20.2f %16.2f\n", threads, a, b);
+
+        ASSERT_EQ(sharded.size(), sessions);
+    }
+}
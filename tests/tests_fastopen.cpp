@@ -0,0 +1,91 @@
+#include <tcpcom.hpp>
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <array>
+#include <fstream>
+
+
+// loopback listener accepting fastopen SYNs, returns listening socket and its port
+static std::pair<int, unsigned short> tfo_listener() {
+
+    int lsock = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in sa {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ::bind(lsock, (sockaddr*)&sa, sizeof(sa));
+
+    int qlen = 16;
+    ::setsockopt(lsock, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen));
+    ::listen(lsock, 16);
+
+    socklen_t sl = sizeof(sa);
+    ::getsockname(lsock, (sockaddr*)&sa, &sl);
+
+    return { lsock, ntohs(sa.sin_port) };
+}
+
+static bool tfo_sysctl_enabled() {
+    std::ifstream f("/proc/sys/net/ipv4/tcp_fastopen");
+    int val = 0;
+    f >> val;
+
+    // both client (1) and server (2) support are needed on loopback
+    return (val & 3) == 3;
+}
+
+// connect with TCPCom, send payload and return what server received
+static std::string tfo_exchange(unsigned short port, int lsock, std::string const& payload) {
+
+    TCPCom com;
+    int fd = com.connect("127.0.0.1", std::to_string(port).c_str());
+    if(fd <= 0) return {};
+
+    while(com.write(fd, payload.data(), payload.size(), MSG_NOSIGNAL) == 0) {}
+
+    int s = ::accept(lsock, nullptr, nullptr);
+    std::array<char, 256> rcv {};
+    auto r = ::recv(s, rcv.data(), rcv.size(), 0);
+
+    // let the client see the handshake finished, then collect stats
+    std::array<char, 4> ack { 'a', 'c', 'k', '\n' };
+    ::send(s, ack.data(), ack.size(), 0);
+    while(::recv(fd, rcv.data() + 128, 4, 0) <= 0) {}
+
+    com.cleanup();
+    ::close(s);
+    ::close(fd);
+
+    return r > 0 ? std::string(rcv.data(), r) : std::string();
+}
+
+
+TEST(FastOpen, DataInSyn) {
+
+    if(not tfo_sysctl_enabled()) {
+        GTEST_SKIP() << "net.ipv4.tcp_fastopen must be 3";
+    }
+
+    auto [ lsock, port ] = tfo_listener();
+    TCPCom::config_t::fastopen = true;
+
+    // first connection only obtains the cookie
+    ASSERT_EQ(tfo_exchange(port, lsock, "first"), "first");
+    ASSERT_GE(TCPCom::fastopen_stats_t::requested, 1);
+
+    auto deferred = TCPCom::fastopen_stats_t::deferred.load();
+    auto accepted = TCPCom::fastopen_stats_t::accepted.load();
+
+    // second one has the cookie: SYN is deferred and carries payload
+    ASSERT_EQ(tfo_exchange(port, lsock, "second"), "second");
+    ASSERT_EQ(TCPCom::fastopen_stats_t::deferred, deferred + 1);
+    ASSERT_GE(TCPCom::fastopen_stats_t::syn_data, 1);
+    ASSERT_EQ(TCPCom::fastopen_stats_t::accepted, accepted + 1);
+
+    TCPCom::config_t::fastopen = false;
+    ::close(lsock);
+}
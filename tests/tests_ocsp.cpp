@@ -0,0 +1,181 @@
+#include <sslocspcache.hpp>
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+// loopback OCSP responder replaying a response prepared by 'openssl ocsp' after a delay
+struct ocsp_responder {
+    int lsock = -1;
+    unsigned short port = 0;
+    std::atomic<int> requests = 0;
+    std::atomic_bool stop = false;
+    std::thread th;
+
+    ocsp_responder() {
+        lsock = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in sa {};
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(lsock, (sockaddr*)&sa, sizeof(sa));
+        ::listen(lsock, 16);
+        socklen_t sl = sizeof(sa);
+        ::getsockname(lsock, (sockaddr*)&sa, &sl);
+        port = ntohs(sa.sin_port);
+    }
+
+    void serve(std::string body, std::chrono::milliseconds delay) {
+        th = std::thread([this, body, delay]() {
+            while(not stop) {
+                int s = ::accept(lsock, nullptr, nullptr);
+                if(s < 0) break;
+                ++requests;
+
+                std::array<char, 4096> req {};
+                ::recv(s, req.data(), req.size(), 0);
+                std::this_thread::sleep_for(delay);
+
+                auto resp = "HTTP/1.0 200 OK\r\nContent-Type: application/ocsp-response\r\nContent-Length: "
+                            + std::to_string(body.size()) + "\r\n\r\n" + body;
+                ::send(s, resp.data(), resp.size(), MSG_NOSIGNAL);
+                ::close(s);
+            }
+        });
+    }
+
+    ~ocsp_responder() {
+        stop = true;
+        ::shutdown(lsock, SHUT_RDWR);
+        ::close(lsock);
+        if(th.joinable()) th.join();
+    }
+};
+
+static std::string read_file(std::string const& fnm) {
+    std::ifstream f(fnm, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+static X509* read_cert(std::string const& fnm) {
+    auto* f = fopen(fnm.c_str(), "r");
+    if(not f) return nullptr;
+    auto* x = PEM_read_X509(f, nullptr, nullptr, nullptr);
+    fclose(f);
+    return x;
+}
+
+// CA, leaf pointing to the responder and 'good' response for it, valid for 'minutes'
+static bool make_pki(std::string const& dir, unsigned short port, int minutes) {
+    auto cmd = "(rm -rf " + dir + " && mkdir -p " + dir + " && cd " + dir
+            + " && openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes -keyout ca.key -out ca.pem"
+              " -subj /CN=socle-test-ocsp-ca -days 2 -addext basicConstraints=critical,CA:TRUE"
+              " -addext keyUsage=keyCertSign,cRLSign,digitalSignature"
+              " && openssl req -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes -keyout leaf.key -out leaf.csr -subj /CN=leaf"
+              " && echo 'authorityInfoAccess=OCSP;URI:http://127.0.0.1:" + std::to_string(port) + "/' > ext.cnf"
+              " && openssl x509 -req -in leaf.csr -CA ca.pem -CAkey ca.key -set_serial 0x1234 -days 1 -extfile ext.cnf -out leaf.pem"
+              " && printf 'V\\t301231235959Z\\t\\t1234\\tunknown\\t/CN=leaf\\n' > index.txt"
+              " && openssl ocsp -issuer ca.pem -cert leaf.pem -no_nonce -reqout req.der"
+              " && openssl ocsp -index index.txt -rsigner ca.pem -rkey ca.key -CA ca.pem -reqin req.der -respout resp.der"
+              " -nmin " + std::to_string(minutes) +
+              ") > /dev/null 2>&1";
+
+    return ::system(cmd.c_str()) == 0;
+}
+
+struct OcspCacheTest : public ::testing::Test {
+    std::string const dir = "/tmp/socle_test_ocsp";
+    ocsp_responder responder;
+    X509* leaf = nullptr;
+    X509* ca = nullptr;
+
+    void SetUp() override {
+        ASSERT_TRUE(make_pki(dir, responder.port, 1));
+        // responder is the CA itself, it must be trusted
+        ::setenv("SSL_CERT_FILE", (dir + "/ca.pem").c_str(), 1);
+
+        leaf = read_cert(dir + "/leaf.pem");
+        ca = read_cert(dir + "/ca.pem");
+        ASSERT_TRUE(leaf and ca);
+
+        OcspCache::get().clear();
+    }
+
+    void TearDown() override {
+        X509_free(leaf);
+        X509_free(ca);
+    }
+};
+
+
+TEST_F(OcspCacheTest, KeyIsCertId) {
+    auto key = OcspCache::cert_key(leaf, ca);
+
+    // serial, then 20 bytes of SHA1
+    ASSERT_EQ(key.find("1234:"), 0);
+    ASSERT_EQ(key.size(), 5 + 40);
+    ASSERT_NE(key, OcspCache::cert_key(ca, ca));
+}
+
+
+TEST_F(OcspCacheTest, ConcurrentQueriesDeduplicated) {
+    responder.serve(read_file(dir + "/resp.der"), std::chrono::milliseconds(300));
+
+    auto& cache = OcspCache::get();
+    ASSERT_FALSE(cache.lookup(leaf, ca).has_value());
+
+    auto joined = OcspCache::stats_t::joined.load();
+
+    std::vector<std::thread> workers;
+    std::vector<int> results(4, -2);
+    for(unsigned i = 0; i < results.size(); ++i) {
+        workers.emplace_back([&, i]() { results[i] = cache.query(leaf, ca).revoked; });
+    }
+    for(auto& t: workers) t.join();
+
+    for(auto r: results) ASSERT_EQ(r, 0);
+    ASSERT_EQ(responder.requests, 1);
+    ASSERT_EQ(OcspCache::stats_t::joined, joined + results.size() - 1);
+
+    // valid until nextUpdate
+    auto cached = cache.lookup(leaf, ca);
+    ASSERT_TRUE(cached.has_value());
+    ASSERT_EQ(cached->revoked, 0);
+    ASSERT_GT(cached->ttl, 0);
+    ASSERT_LE(cached->ttl, 60);
+    ASSERT_EQ(responder.requests, 1);
+}
+
+
+TEST_F(OcspCacheTest, HotEntryRefreshed) {
+    responder.serve(read_file(dir + "/resp.der"), std::chrono::milliseconds(0));
+
+    OcspCache::params_t::hot_uses = 2;
+    OcspCache::params_t::refresh_interval = 1;
+
+    auto& cache = OcspCache::get();
+    auto refreshed = OcspCache::stats_t::refreshed.load();
+
+    ASSERT_EQ(cache.query(leaf, ca).revoked, 0);
+    ASSERT_TRUE(cache.lookup(leaf, ca).has_value());
+    ASSERT_EQ(responder.requests, 1);
+
+    // whole one-minute validity is within refresh_ahead: popular entry is queried again in background
+    for(int i = 0; i < 50 and responder.requests < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_GE(responder.requests, 2);
+    ASSERT_GT(OcspCache::stats_t::refreshed, refreshed);
+    ASSERT_TRUE(cache.lookup(leaf, ca).has_value());
+
+    OcspCache::params_t::refresh_interval = 60;
+}
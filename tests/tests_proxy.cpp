@@ -0,0 +1,317 @@
+#include <lrproxy.hpp>
+#include <tcpcom.hpp>
+
+#include <gtest/gtest.h>
+#include "test_util.hpp"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <array>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+// proxy copying bytes between one left and one right socket, driven by the test
+struct test_proxy : public SimpleLRProxy {
+
+    baseHostCX* left = nullptr;
+    baseHostCX* right = nullptr;
+
+    int left_peer = -1;
+    int right_peer = -1;
+
+    explicit test_proxy(int right_peer_rcvbuf = 0) : SimpleLRProxy(new TCPCom()) {
+        pollroot(true);
+
+        // peers connect, proxy gets accepted ends
+        auto [ lp, l ] = test_util::tcp_pair();
+        auto [ rp, r ] = test_util::tcp_pair(right_peer_rcvbuf);
+        left_peer = lp;
+        right_peer = rp;
+
+        left = new baseHostCX(com()->slave(), l);
+        right = new baseHostCX(com()->slave(), r);
+        for(auto* cx: { left, right }) {
+            cx->opening(false);
+            cx->on_accept_socket(cx->socket());
+        }
+
+        ladd(left);
+        radd(right);
+    }
+
+    ~test_proxy() override {
+        ::close(left_peer);
+        ::close(right_peer);
+    }
+
+    // one event loop iteration
+    void turn(int timeout_ms = 10) {
+        auto saved = baseCom::poll_msec;
+        baseCom::poll_msec = timeout_ms;
+        com()->poll();
+        run_poll();
+        baseCom::poll_msec = saved;
+    }
+
+    // read everything available at the peer socket, returns bytes read and sets eof if the peer closed
+    static std::size_t drain(int peer, bool& eof) {
+        std::array<char, 65536> buf {};
+        std::size_t total = 0;
+        while(true) {
+            auto r = ::recv(peer, buf.data(), buf.size(), MSG_DONTWAIT);
+            if(r > 0) { total += r; continue; }
+            if(r == 0) eof = true;
+            break;
+        }
+        return total;
+    }
+};
+
+
+TEST(ProxySplice, EofWithFullTarget) {
+
+    baseProxy::params_t::splice_enabled = true;
+    test_proxy px(65536);
+    ASSERT_TRUE(px.splice_start());
+
+    // make the right side socket full: its peer doesn't read yet
+    int small = 16384;
+    ::setsockopt(px.right->socket(), SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    std::vector<char> chunk(65536, 'f');
+    std::size_t filler = 0;
+    for(bool progress = true; progress; ) {
+        progress = false;
+        while(true) {
+            auto w = ::send(px.right->socket(), chunk.data(), chunk.size(), MSG_DONTWAIT);
+            if(w <= 0) break;
+            filler += w;
+            progress = true;
+        }
+        // loopback moves queued bytes to the receive buffer meanwhile
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    // left peer sends a tail and closes
+    std::vector<char> tail(60000, 't');
+    ASSERT_EQ(::send(px.left_peer, tail.data(), tail.size(), 0), static_cast<ssize_t>(tail.size()));
+    ::shutdown(px.left_peer, SHUT_WR);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // readiness events on the left: tail goes to the pipe, then eof is seen while the pipe is not empty
+    ASSERT_EQ(px.handle_cx_read('l', px.left), true);
+    ASSERT_EQ(px.handle_cx_read('l', px.left), true);
+    ASSERT_GT(px.left->socket(), 0);
+
+    // right peer starts reading: everything is delivered, followed by close
+    test_util::set_nonblocking(px.right_peer);
+    bool eof = false;
+    std::size_t received = 0;
+    for(int i = 0; i < 500 and not eof; ++i) {
+        received += test_proxy::drain(px.right_peer, eof);
+        px.turn(1);
+    }
+    received += test_proxy::drain(px.right_peer, eof);
+
+    ASSERT_EQ(received, filler + tail.size());
+    ASSERT_TRUE(eof);
+    ASSERT_TRUE(px.state().error_on_left_read);
+
+    baseProxy::params_t::splice_enabled = false;
+}
+
+
+// session switched back to userspace (kTLS control record) is spliced again once it qualifies
+TEST(ProxySplice, StartsAgainAfterStop) {
+
+    baseProxy::params_t::splice_enabled = true;
+    test_proxy px;
+    px.left->meter_read_bytes = baseHostCX::params_t::fast_copy_start + 1;
+
+    ASSERT_TRUE(px.splice_eligible());
+    ASSERT_TRUE(px.splice_start());
+    ASSERT_FALSE(px.splice_eligible());
+
+    px.splice_stop();
+    ASSERT_FALSE(px.spliced());
+
+    // userspace data in flight keeps it in userspace
+    px.right->writebuf()->append("x", 1);
+    ASSERT_FALSE(px.splice_eligible());
+    px.right->writebuf()->clear();
+
+    // next iteration starts splicing before it forwards
+    ASSERT_TRUE(px.splice_eligible());
+    ASSERT_EQ(::send(px.left_peer, "abc", 3, 0), 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    px.turn();
+    ASSERT_TRUE(px.spliced());
+    ASSERT_EQ(px.left->meter_read_bytes, baseHostCX::params_t::fast_copy_start + 1 + 3);
+
+    std::array<char, 8> rcv {};
+    ASSERT_EQ(::recv(px.right_peer, rcv.data(), rcv.size(), MSG_DONTWAIT), 3);
+
+    baseProxy::params_t::splice_enabled = false;
+}
+
+
+// receive everything the peer sends in bulk, consuming it like a proxy would
+static void pump(baseHostCX& cx, int peer, std::size_t total) {
+    std::vector<char> chunk(total, 'b');
+    ASSERT_EQ(::send(peer, chunk.data(), chunk.size(), 0), static_cast<ssize_t>(total));
+
+    std::size_t got = 0;
+    for(int i = 0; i < 1000 and got < total; ++i) {
+        auto r = cx.read();
+        if(r > 0) {
+            got += r;
+            cx.readbuf()->size(0);
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    ASSERT_EQ(got, total);
+}
+
+TEST(HostCXBuffers, IdleShrinksBusyKeeps) {
+
+    auto saved_idle = baseHostCX::params_t::shrink_idle.load();
+    baseHostCX::params_t::shrink_idle = 1;
+
+    auto [ peer, mine ] = test_util::tcp_pair();
+    baseHostCX cx(new TCPCom(), mine);
+    cx.opening(false);
+    cx.unblock();
+
+    for(int i = 0; i < 16; ++i) pump(cx, peer, 256*1024);
+
+    auto const grown = cx.readbuf()->capacity();
+    ASSERT_GT(grown, baseHostCX::params_t::buffsize.load());
+
+    // traffic just happened: capacity matches what reads need, keep it
+    cx.adjust_buffers();
+    ASSERT_EQ(cx.readbuf()->capacity(), grown);
+    ASSERT_EQ(cx.buffer_shrinks(), 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+    // no I/O for shrink_idle seconds: back to the initial size
+    cx.adjust_buffers();
+    ASSERT_LT(cx.readbuf()->capacity(), grown);
+    // pool may round up to its size class
+    ASSERT_EQ(cx.readbuf()->capacity(), buffer(baseHostCX::params_t::buffsize).capacity());
+    ASSERT_GT(cx.buffer_shrinks(), 0);
+    ASSERT_EQ(cx.read_ewma(), 0);
+
+    baseHostCX::params_t::shrink_idle = saved_idle;
+    ::close(peer);
+}
+
+
+// count sends to the left socket when both right connections answer in the same iteration
+static unsigned int left_sends(bool coalesce) {
+
+    baseHostCX::params_t::write_coalesce = coalesce;
+
+    test_proxy px;
+    auto [ y_peer, y ] = test_util::tcp_pair();
+    auto* pc = new baseHostCX(px.com()->slave(), y);
+    pc->opening(false);
+    pc->unblock();
+    pc->on_accept_socket(y);
+    px.rpcadd(pc);
+
+    ::send(px.right_peer, "aaaa", 4, 0);
+    ::send(y_peer, "bbbb", 4, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    px.turn();
+    px.turn();
+
+    bool eof = false;
+    EXPECT_EQ(test_proxy::drain(px.left_peer, eof), 8);
+
+    baseHostCX::params_t::write_coalesce = false;
+    ::close(y_peer);
+
+    return px.left->meter_write_count;
+}
+
+TEST(ProxyCoalesce, OneSendPerIteration) {
+
+    // permanent connections are read after plain sockets were written
+    ASSERT_EQ(left_sends(false), 2);
+    ASSERT_EQ(left_sends(true), 1);
+}
+
+
+// left reads into right's writebuf: watermarks pause and resume left's reading
+struct flow_proxy : public test_proxy {
+
+    std::size_t saved_full = baseHostCX::params_t::write_full;
+    std::size_t saved_low = baseHostCX::params_t::write_low;
+
+    flow_proxy() {
+        baseHostCX::params_t::write_full = 65536;
+        baseHostCX::params_t::write_low = 16384;
+
+        left->peer(right);
+        right->peer(left);
+    }
+    ~flow_proxy() override {
+        baseHostCX::params_t::write_full = saved_full;
+        baseHostCX::params_t::write_low = saved_low;
+    }
+
+    // poll without running the proxy, true if cx's socket is reported readable
+    bool polled_readable(baseHostCX const* cx) {
+        auto saved = baseCom::poll_msec;
+        baseCom::poll_msec = 10;
+        com()->poll();
+        baseCom::poll_msec = saved;
+        return com()->in_readset(cx->socket());
+    }
+
+    // queue more than high watermark in right's writebuf, with data waiting on left
+    void congest() {
+        ::send(left_peer, "data", 4, 0);
+        std::vector<unsigned char> queued(100000, 'q');
+        right->to_write(queued.data(), queued.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+};
+
+TEST(ProxyFlowControl, WatermarkPauseResume) {
+
+    flow_proxy px;
+    px.congest();
+
+    ASSERT_EQ(px.left->read(), -1);
+    ASSERT_TRUE(px.left->flow_paused());
+    ASSERT_FALSE(px.polled_readable(px.left));
+
+    // right drains under low watermark and resumes left
+    ASSERT_GT(px.right->write(), 0);
+    ASSERT_LE(px.right->writebuf()->size(), baseHostCX::params_t::write_low.load());
+    ASSERT_FALSE(px.left->flow_paused());
+    ASSERT_TRUE(px.polled_readable(px.left));
+    ASSERT_EQ(px.left->read(), 4);
+}
+
+TEST(ProxyFlowControl, ResumeKeepsProxyPause) {
+
+    flow_proxy px;
+    px.congest();
+
+    ASSERT_EQ(px.left->read(), -1);
+    ASSERT_TRUE(px.left->flow_paused());
+
+    // proxy paused the side meanwhile: draining must not re-arm reading
+    px.left->read_waiting_for_peercom(true);
+    ASSERT_GT(px.right->write(), 0);
+    ASSERT_FALSE(px.left->flow_paused());
+    ASSERT_FALSE(px.polled_readable(px.left));
+}
@@ -0,0 +1,150 @@
+#include <sslrecord.hpp>
+#include <sslcom.hpp>
+#include <hostcx.hpp>
+
+#include <gtest/gtest.h>
+#include "test_util.hpp"
+
+#include <sys/socket.h>
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+TEST(RecordSizer, RampToFullRecords) {
+
+    RecordSizer rs;
+    auto now = RecordSizer::clock::now();
+
+    std::vector<std::size_t> sizes;
+    for(int i = 0; i < 6; ++i) {
+        auto sz = rs.record_size(now);
+        sizes.push_back(sz);
+        rs.on_record(sz, now);
+    }
+
+    ASSERT_EQ(sizes, std::vector<std::size_t>({ 1369, 2738, 5476, 10952, 16384, 16384 }));
+}
+
+TEST(RecordSizer, ShortWritesDontGrow) {
+
+    RecordSizer rs;
+    auto now = RecordSizer::clock::now();
+
+    for(int i = 0; i < 10; ++i) {
+        ASSERT_EQ(rs.record_size(now), 1369);
+        rs.on_record(100, now);
+    }
+}
+
+TEST(RecordSizer, SmallAgainAfterIdle) {
+
+    RecordSizer rs;
+    auto now = RecordSizer::clock::now();
+
+    for(int i = 0; i < 5; ++i) rs.on_record(rs.record_size(now), now);
+    ASSERT_EQ(rs.record_size(now), 16384);
+
+    // still busy
+    now += std::chrono::milliseconds(RecordSizer::params_t::idle_reset_ms / 2);
+    ASSERT_EQ(rs.record_size(now), 16384);
+    rs.on_record(16384, now);
+
+    now += std::chrono::milliseconds(RecordSizer::params_t::idle_reset_ms + 1);
+    ASSERT_EQ(rs.record_size(now), 1369);
+}
+
+TEST(RecordSizer, FixedSize) {
+
+    RecordSizer::params_t::small_record = 16384;
+
+    RecordSizer rs;
+    auto now = RecordSizer::clock::now();
+    ASSERT_EQ(rs.record_size(now), 16384);
+    rs.on_record(16384, now);
+    ASSERT_EQ(rs.record_size(now), 16384);
+
+    RecordSizer::params_t::small_record = 1369;
+}
+
+
+// burst of records interrupted by full socket: rest is written by next calls from a moved buffer
+TEST(SSLComWrite, WantWriteMidBurst) {
+
+    static auto dir = test_util::make_certs("/tmp/socle_record_certs/");
+    auto* fac = test_util::init_factory(dir, "srv-cert.pem");
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    int sp[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, sp), 0);
+    int c = sp[0];
+    int s = sp[1];
+
+    auto* srv = SSL_new(fac->default_tls_server_cx());
+    SSL_set_fd(srv, s);
+    auto server = std::thread([srv]() { SSL_accept(srv); });
+
+    auto* com = new SSLCom();
+    baseHostCX cx(com, c);
+    com->upgrade_client_socket(c);
+    server.join();
+    ASSERT_TRUE(SSL_is_init_finished(com->get_SSL()));
+
+    cx.opening(false);
+    cx.unblock();
+    int sndbuf = 4096;
+    ::setsockopt(c, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    std::vector<unsigned char> sent(1024*1024);
+    for(std::size_t i = 0; i < sent.size(); ++i) sent[i] = static_cast<unsigned char>(i * 7 + i / 4099);
+
+    // peer starts reading only once the writer got stuck
+    std::atomic_bool go = false;
+    std::vector<unsigned char> received;
+    auto reader = std::thread([&]() {
+        while(not go) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::vector<unsigned char> b(64*1024);
+        while(received.size() < sent.size()) {
+            int r = SSL_read(srv, b.data(), static_cast<int>(b.size()));
+            if(r <= 0) break;
+            received.insert(received.end(), b.begin(), b.begin() + r);
+        }
+    });
+
+    // data not written yet is moved to the front of a buffer after each call, as writebuf does
+    std::vector<unsigned char> pending = sent;
+    bool partial_burst = false;
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while(not pending.empty() and std::chrono::steady_clock::now() < until) {
+        auto requested = std::min(pending.size(), RecordSizer::params_t::write_burst.load());
+        auto n = com->write(c, pending.data(), pending.size(), 0);
+
+        if(n > 0) {
+            if(static_cast<std::size_t>(n) < requested) partial_burst = true;
+            pending.erase(pending.begin(), pending.begin() + n);
+        }
+        else if(n < 0) {
+            break;
+        }
+        else {
+            go = true;
+            pollfd pfd { c, POLLOUT, 0 };
+            ::poll(&pfd, 1, 100);
+        }
+    }
+    go = true;
+    reader.join();
+
+    ASSERT_TRUE(partial_burst);
+    ASSERT_TRUE(pending.empty());
+    ASSERT_EQ(received.size(), sent.size());
+    ASSERT_TRUE(received == sent);
+
+    SSL_free(srv);
+    ::close(s);
+}
@@ -0,0 +1,126 @@
+#include <sslresume.hpp>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+
+static SSL_SESSION* make_session(int version, long timeout = 300) {
+    auto* sess = SSL_SESSION_new();
+
+    std::array<unsigned char, 48> master {};
+    master.fill(0xAA);
+
+    SSL_SESSION_set1_master_key(sess, master.data(), master.size());
+    SSL_SESSION_set_protocol_version(sess, version);
+    SSL_SESSION_set_time(sess, time(nullptr));
+    SSL_SESSION_set_timeout(sess, timeout);
+
+    return sess;
+}
+
+
+TEST(ResumptionStore, SingleUseTickets) {
+
+    ResumptionStore store;
+
+    std::string alpn("\x02h2\x08http/1.1", 12);
+    auto a = ResumptionStore::make_key("192.0.2.1", "443", "www.example.test", alpn);
+    auto b = ResumptionStore::make_key("192.0.2.1", "443", "www.example.test", "");
+    ASSERT_EQ(a, "192.0.2.1:443/www.example.test/h2,http/1.1");
+
+    std::set<SSL_SESSION*> tickets;
+    for(int i = 0; i < 3; ++i) {
+        auto* s = make_session(TLS1_3_VERSION);
+        tickets.insert(s);
+        store.put(a, s);
+    }
+    store.put(a, make_session(TLS1_3_VERSION, 0));   // already expired
+
+    // other ALPN is another destination
+    ASSERT_EQ(store.take(b), nullptr);
+
+    std::set<SSL_SESSION*> taken;
+    for(int i = 0; i < 3; ++i) {
+        auto* s = store.take(a);
+        ASSERT_NE(s, nullptr);
+        taken.insert(s);
+        SSL_SESSION_free(s);
+    }
+    ASSERT_EQ(taken, tickets);
+    ASSERT_EQ(store.take(a), nullptr);
+
+    // TLS 1.2 session is resumed repeatedly
+    store.put(b, make_session(TLS1_2_VERSION));
+    for(int i = 0; i < 3; ++i) {
+        auto* s = store.take(b);
+        ASSERT_NE(s, nullptr);
+        SSL_SESSION_free(s);
+    }
+
+    auto r = store.report();
+    ASSERT_EQ(r.size(), 2);
+    ASSERT_EQ(r[0].destination, a);
+    ASSERT_EQ(r[0].lookups, 4);
+    ASSERT_EQ(r[0].hits, 3);
+    ASSERT_DOUBLE_EQ(r[0].hit_rate(), 0.75);
+    ASSERT_EQ(r[1].available, 1);
+}
+
+
+TEST(ResumptionStore, ConcurrentTake) {
+
+    ResumptionStore store;
+
+    std::vector<std::string> keys;
+    for(int i = 0; i < 100; ++i) {
+        keys.push_back(ResumptionStore::make_key("192.0.2." + std::to_string(i), "443", "", ""));
+        for(std::size_t t = 0; t < ResumptionStore::max_tickets; ++t) store.put(keys.back(), make_session(TLS1_3_VERSION));
+    }
+
+    std::atomic<std::size_t> hits = 0;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]() {
+            for(int round = 0; round < 10; ++round) {
+                for (auto const& k: keys) {
+                    if (auto* s = store.take(k); s) {
+                        ++hits;
+                        SSL_SESSION_free(s);
+                    }
+                }
+            }
+        });
+    }
+    for(auto& t: threads) t.join();
+
+    // each ticket used exactly once
+    ASSERT_EQ(hits, keys.size() * ResumptionStore::max_tickets);
+}
+
+
+TEST(ResumptionStore, Reclaim) {
+
+    ResumptionStore::params_t::destinations = 4;
+    ResumptionStore::params_t::probe = 1;
+    ResumptionStore store;
+
+    auto reclaimed = ResumptionStore::stats_t::reclaimed.load();
+    for(int i = 0; i < 20; ++i) {
+        store.put(ResumptionStore::make_key("192.0.2." + std::to_string(i), "443", "", ""), make_session(TLS1_3_VERSION));
+    }
+
+    ASSERT_LE(store.report().size(), 4);
+    ASSERT_GT(ResumptionStore::stats_t::reclaimed, reclaimed);
+
+    // last one is always there
+    auto* s = store.take(ResumptionStore::make_key("192.0.2.19", "443", "", ""));
+    ASSERT_NE(s, nullptr);
+    SSL_SESSION_free(s);
+
+    ResumptionStore::params_t::destinations = 4096;
+    ResumptionStore::params_t::probe = 8;
+}
@@ -0,0 +1,96 @@
+#include <socketinfo.hpp>
+#include <siphash.hpp>
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+
+
+static sockaddr_storage ss4(const char* ip, unsigned short port) {
+    sockaddr_storage ss {};
+    auto* sa = reinterpret_cast<sockaddr_in*>(&ss);
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons(port);
+    inet_pton(AF_INET, ip, &sa->sin_addr);
+    return ss;
+}
+
+// reference vector from SipHash paper: key 00..0f, message 00..0e
+TEST(SessionKey, SipHashVector) {
+    socle::tools::siphash::key_type key { 0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL };
+
+    std::array<unsigned char, 15> msg {};
+    for(unsigned char i = 0; i < msg.size(); ++i) msg[i] = i;
+
+    ASSERT_EQ(socle::tools::siphash::compute(key, msg.data(), msg.size()), 0xa129ca6149be45e5ULL);
+}
+
+TEST(SessionKey, SignAndProbe) {
+    auto from = ss4("192.168.1.1", 40000);
+    auto to = ss4("8.8.8.8", 53);
+
+    auto k = SocketInfo::create_session_key4(&from, &to, true);
+    ASSERT_EQ(k, SocketInfo::create_session_key4(&from, &to, true));
+    ASSERT_TRUE(k & (1UL << 31));
+    ASSERT_FALSE(SocketInfo::create_session_key4(&from, &to, false) & (1UL << 31));
+
+    // probing keeps the sign bit, also on wrap-around
+    ASSERT_TRUE(SocketInfo::next_session_key(0xffffffff) & (1UL << 31));
+    ASSERT_NE(SocketInfo::next_session_key(k), k);
+
+    ASSERT_TRUE(SockOps::ss_same(&from, &from));
+    ASSERT_FALSE(SockOps::ss_same(&from, &to));
+}
+
+// Benchmark: keys/sec of the former mt19937 based key vs. siphash, and collisions in a set of flows
+TEST(SessionKey, Benchmark) {
+
+    constexpr std::size_t count = 1000000;
+
+    std::vector<std::pair<sockaddr_storage, sockaddr_storage>> flows;
+    flows.reserve(1024);
+    for(unsigned short i = 0; i < 1024; ++i) {
+        flows.emplace_back(ss4("10.0.0.1", 10000 + i), ss4("1.1.1.1", 443));
+    }
+
+    auto old_key = [](sockaddr_storage* from, sockaddr_storage* orig) -> uint32_t {
+        uint32_t s = reinterpret_cast<sockaddr_in*>(from)->sin_addr.s_addr;
+        uint32_t d = reinterpret_cast<sockaddr_in*>(orig)->sin_addr.s_addr;
+        uint32_t sp = ntohs(reinterpret_cast<sockaddr_in*>(from)->sin_port);
+        uint32_t sd = ntohs(reinterpret_cast<sockaddr_in*>(orig)->sin_port);
+
+        std::seed_seq seed1{ s, d, sp, sd };
+        std::mt19937 e(seed1);
+        std::uniform_int_distribution<> dist;
+        return dist(e) | (1UL << 31);
+    };
+
+    auto measure = [&](std::size_t n, auto fn) {
+        uint32_t acc = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < n; ++i) {
+            auto& f = flows[i % flows.size()];
+            acc ^= fn(&f.first, &f.second);
+        }
+        auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_NE(acc, 1U);     // keep the loop
+        return static_cast<double>(n) / secs / 1e6;
+    };
+
+    // former key is slow, measure it on fewer samples
+    auto mt = measure(count / 100, old_key);
+    auto sip = measure(count, [](sockaddr_storage* a, sockaddr_storage* b) { return SocketInfo::create_session_key4(a, b, true); });
+
+    std::set<uint32_t> keys;
+    for(auto& f: flows) keys.insert(SocketInfo::create_session_key4(&f.first, &f.second, true));
+
+    std::cout << string_format("mt19937: %.2f Mkeys/s, siphash: %.2f Mkeys/s, %d flows -> %d distinct keys\n",
+                               mt, sip, flows.size(), keys.size());
+    ASSERT_GT(sip, mt);
+}
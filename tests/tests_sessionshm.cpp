@@ -0,0 +1,229 @@
+#include <sslcertstore.hpp>
+#include <sslsessionshm.hpp>
+
+#include <gtest/gtest.h>
+#include "test_util.hpp"
+
+#include <sys/wait.h>
+
+#include <cstdlib>
+#include <string>
+
+
+static std::string shm_name() {
+    return "/socle_test_sessions_" + std::to_string(getpid());
+}
+
+static SSL_SESSION* make_session(unsigned char id) {
+    auto* sess = SSL_SESSION_new();
+
+    std::array<unsigned char, 32> sid {};
+    sid.fill(id);
+    std::array<unsigned char, 48> master {};
+    master.fill(0xAA);
+
+    SSL_SESSION_set1_id(sess, sid.data(), sid.size());
+    SSL_SESSION_set1_master_key(sess, master.data(), master.size());
+    SSL_SESSION_set_protocol_version(sess, TLS1_2_VERSION);
+    SSL_SESSION_set_time(sess, time(nullptr));
+    SSL_SESSION_set_timeout(sess, 300);
+
+    // session without cipher can't be serialized
+    auto* ctx = SSL_CTX_new(TLS_method());
+    auto* ssl = SSL_new(ctx);
+    SSL_SESSION_set_cipher(sess, sk_SSL_CIPHER_value(SSL_get_ciphers(ssl), 0));
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+
+    return sess;
+}
+
+// handshake between client and server over a BIO pair, pass one byte to get also post-handshake tickets
+static bool handshake(SSL* c, SSL* s) {
+    BIO* bc = nullptr;
+    BIO* bs = nullptr;
+    BIO_new_bio_pair(&bc, 0, &bs, 0);
+    SSL_set_bio(c, bc, bc);
+    SSL_set_bio(s, bs, bs);
+    SSL_set_connect_state(c);
+    SSL_set_accept_state(s);
+
+    int rc = 0;
+    int rs = 0;
+    for(int i = 0; i < 100 and (rc != 1 or rs != 1); ++i) {
+        if(rc != 1) rc = SSL_do_handshake(c);
+        if(rs != 1) rs = SSL_do_handshake(s);
+    }
+    if(rc != 1 or rs != 1) return false;
+
+    char b = 'x';
+    SSL_write(s, &b, 1);
+    return SSL_read(c, &b, 1) == 1;
+}
+
+
+TEST(SharedSessionCache, TwoWorkers) {
+
+    Log::init();
+    Log::get()->level(loglevel(iNOT));
+
+    auto name = shm_name() + "_w";
+    SharedSessionCache::unlink(name);
+
+    SharedSessionCache a(name);
+    SharedSessionCache b(name);
+    ASSERT_TRUE(a.attach());
+    ASSERT_TRUE(b.attach());
+
+    auto* sess = make_session(1);
+    ASSERT_TRUE(a.store(sess));
+
+    unsigned int sid_len = 0;
+    auto const* sid = SSL_SESSION_get_id(sess, &sid_len);
+
+    auto* loaded = b.load(sid, sid_len);
+    ASSERT_NE(loaded, nullptr);
+    unsigned int loaded_len = 0;
+    auto const* loaded_sid = SSL_SESSION_get_id(loaded, &loaded_len);
+    ASSERT_EQ(std::string((const char*)sid, sid_len), std::string((const char*)loaded_sid, loaded_len));
+    SSL_SESSION_free(loaded);
+
+    ASSERT_TRUE(b.remove(sid, sid_len));
+    ASSERT_EQ(a.load(sid, sid_len), nullptr);
+    SSL_SESSION_free(sess);
+
+    // worker with different geometry must not use the memory
+    auto ways = SharedSessionCache::params_t::ways.load();
+    SharedSessionCache::params_t::ways = ways * 2;
+    SharedSessionCache c(name);
+    ASSERT_FALSE(c.attach());
+    SharedSessionCache::params_t::ways = ways;
+
+    SharedSessionCache::unlink(name);
+}
+
+
+// worker killed while holding the lock must not block the others
+TEST(SharedSessionCache, OwnerDeathRecovered) {
+
+    Log::init();
+    Log::get()->level(loglevel(iNOT));
+
+    struct locking_cache : public SharedSessionCache {
+        using SharedSessionCache::SharedSessionCache;
+        using SharedSessionCache::lock;
+    };
+
+    auto name = shm_name() + "_d";
+    SharedSessionCache::unlink(name);
+
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+    if(pid == 0) {
+        locking_cache dying(name);
+        _exit(dying.attach() and dying.lock() ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) and WEXITSTATUS(status) == 0);
+
+    auto died = SharedSessionCache::stats_t::owner_died.load();
+    auto timeouts = SharedSessionCache::stats_t::lock_timeouts.load();
+
+    SharedSessionCache a(name);
+    ASSERT_TRUE(a.attach());
+    ASSERT_EQ(SharedSessionCache::stats_t::owner_died, died + 1);
+
+    auto* sess = make_session(2);
+    ASSERT_TRUE(a.store(sess));
+
+    unsigned int sid_len = 0;
+    auto const* sid = SSL_SESSION_get_id(sess, &sid_len);
+    auto* loaded = a.load(sid, sid_len);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_EQ(SharedSessionCache::stats_t::lock_timeouts, timeouts);
+
+    SSL_SESSION_free(loaded);
+    SSL_SESSION_free(sess);
+    SharedSessionCache::unlink(name);
+}
+
+TEST(SharedSessionCache, ResumeOnOtherContext) {
+
+    auto dir = test_util::make_certs("/tmp/socle_session_certs/");
+    if(dir.empty()) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    Log::init();
+    Log::get()->level(loglevel(iNOT));
+
+    SharedSessionCache::params_t::name = shm_name();
+    SharedSessionCache::unlink(SharedSessionCache::params_t::name);
+    SSLFactory::options::shared_sessions = true;
+
+    auto& fac = SSLFactory::factory();
+    fac.certs_path() = dir;
+    fac.ca_file() = dir + "ca-cert.pem";
+    fac.init();
+    ASSERT_NE(fac.shared_sessions(), nullptr);
+
+    // two server contexts stand for two workers, each would have its own ticket keys and cache otherwise
+    auto run = [&fac](int max_version, bool no_ticket) -> bool {
+        auto* s1 = fac.server_ctx_setup();
+        auto* s2 = fac.server_ctx_setup();
+        if(no_ticket) {
+            SSL_CTX_set_options(s1, SSL_OP_NO_TICKET);
+            SSL_CTX_set_options(s2, SSL_OP_NO_TICKET);
+        }
+
+        auto* cl = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_max_proto_version(cl, max_version);
+        SSL_CTX_set_verify(cl, SSL_VERIFY_NONE, nullptr);
+
+        auto* c = SSL_new(cl);
+        auto* s = SSL_new(s1);
+        bool ret = handshake(c, s);
+        auto* sess = SSL_get1_session(c);
+
+        // unclean close would invalidate the session
+        SSL_shutdown(c);
+        SSL_shutdown(s);
+        SSL_free(c);
+        SSL_free(s);
+
+        c = SSL_new(cl);
+        s = SSL_new(s2);
+        SSL_set_session(c, sess);
+        ret = ret and handshake(c, s) and SSL_session_reused(c) == 1;
+
+        SSL_SESSION_free(sess);
+        SSL_free(c);
+        SSL_free(s);
+        SSL_CTX_free(cl);
+        SSL_CTX_free(s1);
+        SSL_CTX_free(s2);
+
+        return ret;
+    };
+
+    using stats = SharedSessionCache::stats_t;
+
+    auto tickets = stats::tickets_decrypted.load();
+    ASSERT_TRUE(run(TLS1_3_VERSION, false));
+    ASSERT_TRUE(run(TLS1_2_VERSION, false));
+    ASSERT_EQ(stats::tickets_decrypted, tickets + 2);
+
+    auto hits = stats::hits.load();
+    ASSERT_TRUE(run(TLS1_3_VERSION, true));
+    ASSERT_TRUE(run(TLS1_2_VERSION, true));
+    ASSERT_EQ(stats::hits, hits + 2);
+
+    // key is rotated at each ticket, all contexts follow it
+    auto rotations = stats::key_rotations.load();
+    SharedSessionCache::params_t::ticket_key_lifetime = 0;
+    ASSERT_TRUE(run(TLS1_3_VERSION, false));
+    SharedSessionCache::params_t::ticket_key_lifetime = 3600;
+    ASSERT_GT(stats::key_rotations, rotations);
+
+    SSLFactory::options::shared_sessions = false;
+    SharedSessionCache::unlink(SharedSessionCache::params_t::name);
+}
@@ -0,0 +1,127 @@
+#include <splicer.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+
+
+struct SocketPair {
+    int fd[2] = { -1, -1 };
+
+    SocketPair() { ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fd); }
+    ~SocketPair() { ::close(fd[0]); ::close(fd[1]); }
+};
+
+
+TEST(SplicerTest, ForwardBytes) {
+
+    SocketPair from;
+    SocketPair to;
+
+    Splicer sp;
+    ASSERT_TRUE(sp.init());
+
+    const char msg[] = "hello splice";
+    ASSERT_EQ(::send(from.fd[0], msg, sizeof(msg), 0), static_cast<ssize_t>(sizeof(msg)));
+
+    auto pulled = sp.pull(from.fd[1]);
+    ASSERT_EQ(pulled, static_cast<ssize_t>(sizeof(msg)));
+    ASSERT_EQ(sp.pending(), sizeof(msg));
+
+    auto pushed = sp.push(to.fd[0]);
+    ASSERT_EQ(pushed, static_cast<ssize_t>(sizeof(msg)));
+    ASSERT_EQ(sp.pending(), 0);
+
+    std::array<char, 64> rcv {};
+    ASSERT_EQ(::recv(to.fd[1], rcv.data(), rcv.size(), 0), static_cast<ssize_t>(sizeof(msg)));
+    ASSERT_EQ(std::memcmp(rcv.data(), msg, sizeof(msg)), 0);
+
+    ASSERT_EQ(sp.pulled_total(), sp.pushed_total());
+}
+
+TEST(SplicerTest, EagainAndEof) {
+
+    SocketPair from;
+    SocketPair to;
+
+    Splicer sp;
+    ASSERT_TRUE(sp.init());
+
+    // nothing to read yet
+    ASSERT_EQ(sp.pull(from.fd[1]), -1);
+
+    // nothing to push
+    ASSERT_EQ(sp.push(to.fd[0]), 0);
+
+    ::shutdown(from.fd[0], SHUT_WR);
+    ASSERT_EQ(sp.pull(from.fd[1]), 0);
+}
+
+TEST(SplicerTest, PendingWhenTargetFull) {
+
+    SocketPair from;
+    SocketPair to;
+
+    Splicer sp;
+    ASSERT_TRUE(sp.init());
+
+    // fill target socket
+    std::array<char, 4096> chunk {};
+    while(::send(to.fd[0], chunk.data(), chunk.size(), 0) > 0) {}
+
+    ASSERT_GT(::send(from.fd[0], chunk.data(), chunk.size(), 0), 0);
+    auto pulled = sp.pull(from.fd[1]);
+    ASSERT_GT(pulled, 0);
+
+    ASSERT_EQ(sp.push(to.fd[0]), 0);
+    ASSERT_EQ(sp.pending(), static_cast<std::size_t>(pulled));
+
+    // drain the target and retry
+    while(::recv(to.fd[1], chunk.data(), chunk.size(), 0) > 0) {}
+
+    ASSERT_EQ(sp.push(to.fd[0]), pulled);
+    ASSERT_EQ(sp.pending(), 0);
+}
+
+TEST(SplicerTest, DrainToUserspace) {
+
+    SocketPair from;
+
+    Splicer sp;
+    ASSERT_TRUE(sp.init());
+
+    const char msg[] = "back to userspace";
+    ASSERT_EQ(::send(from.fd[0], msg, sizeof(msg), 0), static_cast<ssize_t>(sizeof(msg)));
+    ASSERT_EQ(sp.pull(from.fd[1]), static_cast<ssize_t>(sizeof(msg)));
+
+    // pending bytes are read out in pieces
+    std::array<unsigned char, 64> rcv {};
+    ASSERT_EQ(sp.drain(rcv.data(), 4), 4);
+    ASSERT_EQ(sp.drain(rcv.data() + 4, rcv.size() - 4), static_cast<ssize_t>(sizeof(msg) - 4));
+    ASSERT_EQ(std::memcmp(rcv.data(), msg, sizeof(msg)), 0);
+
+    ASSERT_EQ(sp.pending(), 0);
+    ASSERT_EQ(sp.drain(rcv.data(), rcv.size()), 0);
+}
+
+// splice refusal means a control record only on kernel TLS sockets, elsewhere it's an error
+TEST(SplicerTest, RefusedOnlyControlRecordWithKtls) {
+
+    // directories can't be spliced from, splice() fails with EINVAL
+    int dir = ::open("/", O_RDONLY | O_DIRECTORY);
+    ASSERT_GE(dir, 0);
+
+    Splicer sp;
+    ASSERT_TRUE(sp.init());
+
+    ASSERT_EQ(sp.pull(dir), -2);
+    ASSERT_EQ(sp.pull(dir, true), -3);
+    ASSERT_EQ(sp.pending(), 0);
+
+    ::close(dir);
+}
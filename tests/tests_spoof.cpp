@@ -0,0 +1,343 @@
+#include <sslcertstore.hpp>
+#include <sslspoofpool.hpp>
+#include <sslkeypool.hpp>
+#include <sslmitmcom.hpp>
+#include <hostcx.hpp>
+
+#include <gtest/gtest.h>
+#include "test_util.hpp"
+
+#include <netinet/in.h>
+#include <poll.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+
+// default certificates, plus original server certificate to spoof and custom SNI chain
+static SSLFactory* init_factory() {
+    static auto dir = test_util::make_certs("/tmp/socle_spoof_certs/",
+            "openssl req -x509 -newkey rsa:2048 -nodes -days 2 -subj /CN=www.example.test "
+            "-addext subjectAltName=DNS:www.example.test -keyout orig-key.pem -out orig-cert.pem >/dev/null 2>&1 && "
+            "mkdir -p sni/www.custom.test && cd sni/www.custom.test && "
+            "printf 'basicConstraints=critical,CA:TRUE\\nkeyUsage=keyCertSign,cRLSign\\n' > ca.ext && "
+            "openssl req -newkey rsa:2048 -nodes -subj /CN=socle-test-intermediate -keyout int-key.pem -out int-req.pem >/dev/null 2>&1 && "
+            "openssl x509 -req -in int-req.pem -CA ../../ca-cert.pem -CAkey ../../ca-key.pem -CAcreateserial -days 2 "
+            "-extfile ca.ext -out issuer.pem >/dev/null 2>&1 && "
+            "openssl req -newkey rsa:2048 -nodes -subj /CN=www.custom.test -keyout key.pem -out req.pem >/dev/null 2>&1 && "
+            "openssl x509 -req -in req.pem -CA issuer.pem -CAkey int-key.pem -CAcreateserial -days 2 "
+            "-out cert.pem >/dev/null 2>&1 && cp ../../ca-cert.pem issuer2.pem");
+    return test_util::init_factory(dir, "ca-cert.pem");
+}
+
+static X509* load_orig() {
+    auto* f = fopen("/tmp/socle_spoof_certs/orig-cert.pem", "r");
+    if(not f) return nullptr;
+    auto* x = PEM_read_X509(f, nullptr, nullptr, nullptr);
+    fclose(f);
+    return x;
+}
+
+
+TEST(SpoofPool, SingleFlight) {
+
+    auto* fac = init_factory();
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    auto* orig = load_orig();
+    ASSERT_NE(orig, nullptr);
+
+    std::string const key = "subj:/CN=www.example.test+single-flight";
+    fac->erase_mitm(key);
+
+    auto spoofed = SpoofPool::stats_t::spoofed.load();
+    auto joined = SpoofPool::stats_t::joined.load();
+
+    // concurrent handshakes for the same certificate
+    std::vector<SpoofPool::job_ptr> jobs(8);
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i < jobs.size(); ++i) {
+        threads.emplace_back([&, i]() { jobs[i] = SpoofPool::get().submit(key, orig, false, {}); });
+    }
+    for(auto& t: threads) t.join();
+
+    for(auto const& j: jobs) {
+        ASSERT_NE(j, nullptr);
+        // job signals completion on its notify fd
+        pollfd pfd { j->notify_fd(), POLLIN, 0 };
+        ASSERT_EQ(::poll(&pfd, 1, 10000), 1);
+        ASSERT_TRUE(j->ready());
+        ASSERT_EQ(j->state, SpoofPool::job_t::state_t::DONE);
+        ASSERT_NE(j->result.chain.cert, nullptr);
+    }
+
+    // all waited on at most few jobs (ones submitted after first finished hit the cache)
+    ASSERT_EQ(SpoofPool::stats_t::spoofed, spoofed + 1);
+    ASSERT_GE(SpoofPool::stats_t::joined - joined + SpoofPool::stats_t::cache_hits, jobs.size() - 1);
+    ASSERT_TRUE(fac->find_mitm(key).has_value());
+
+    // result outlives cache entry
+    auto* cert = jobs[0]->result.chain.cert;
+    fac->erase_mitm(key);
+    ASSERT_FALSE(SSLFactory::print_cn(cert).empty());
+
+    X509_free(orig);
+}
+
+
+TEST(CertStore, CustomChainWithoutContext) {
+
+    auto* fac = init_factory();
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    auto entry = fac->find_custom("sni:www.custom.test");
+    ASSERT_TRUE(entry.has_value());
+
+    // chain is applied per connection on top of default context
+    ASSERT_EQ(entry->ctx, nullptr);
+    ASSERT_NE(entry->chain.issuers[0], nullptr);
+    ASSERT_EQ(SSLFactory::print_cn(entry->chain.issuers[0]), "socle-test-intermediate");
+    ASSERT_EQ(entry->chain.issuers[1], nullptr);   // root is not sent
+
+    // server side com picks the entry by SNI, as MitmProxy does
+    auto [ c, s ] = test_util::tcp_pair();
+    auto* com = new SSLMitmCom();
+    auto cx = std::make_unique<baseHostCX>(com, s);
+
+    SpoofOptions spo;
+    spo.sni = "www.custom.test";
+    ASSERT_TRUE(com->use_cert_sni(spo));
+    com->upgrade_server_socket(s);
+
+    STACK_OF(X509)* ssl_chain = nullptr;
+    SSL_get0_chain_certs(com->get_SSL(), &ssl_chain);
+    ASSERT_EQ(sk_X509_num(ssl_chain), 1);
+
+    // plain client receives the chain on the wire
+    auto* cl_ctx = SSL_CTX_new(TLS_client_method());
+    auto* cl = SSL_new(cl_ctx);
+    SSL_set_fd(cl, c);
+    SSL_set_tlsext_host_name(cl, "www.custom.test");
+    int connected = 0;
+    auto client = std::thread([&]() { connected = SSL_connect(cl); });
+
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(SSL_accept(com->get_SSL()) != 1 and std::chrono::steady_clock::now() < until) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    client.join();
+    ASSERT_EQ(connected, 1);
+
+    auto* sent = SSL_get_peer_cert_chain(cl);
+    ASSERT_EQ(sk_X509_num(sent), 2);
+    ASSERT_EQ(SSLFactory::print_cn(sk_X509_value(sent, 0)), "www.custom.test");
+    ASSERT_EQ(SSLFactory::print_cn(sk_X509_value(sent, 1)), "socle-test-intermediate");
+
+    // shared default context is untouched
+    STACK_OF(X509)* ctx_chain = nullptr;
+    SSL_CTX_get0_chain_certs(fac->default_tls_server_cx(), &ctx_chain);
+    ASSERT_TRUE(ctx_chain == nullptr or sk_X509_num(ctx_chain) == 0);
+
+    SSL_free(cl);
+    SSL_CTX_free(cl_ctx);
+    ::close(c);
+}
+
+
+TEST(CertDiskCache, Restart) {
+
+    auto* fac = init_factory();
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    auto* orig = load_orig();
+    ASSERT_NE(orig, nullptr);
+
+    std::string const path = "/tmp/socle_spoof_certs/disk-test.db";
+    ::unlink(path.c_str());
+
+    auto spoofed = fac->spoof(orig);
+    ASSERT_TRUE(spoofed.has_value());
+    auto* cert = spoofed->chain.cert;
+
+    {
+        CertDiskCache disk(path, "gen-1");
+        ASSERT_TRUE(disk.store("a", cert));
+        ASSERT_TRUE(disk.store("b", cert));
+        ASSERT_EQ(disk.size(), 2);
+    }
+
+    // restart: index is rebuilt from file
+    {
+        CertDiskCache disk(path, "gen-1");
+        EVP_PKEY* k = nullptr;
+        auto* x = disk.load("b", &k);
+        ASSERT_NE(x, nullptr);
+        ASSERT_EQ(k, nullptr);
+        ASSERT_EQ(X509_cmp(x, cert), 0);
+        X509_free(x);
+        ASSERT_EQ(disk.load("c", &k), nullptr);
+    }
+
+    // killed while writing: damaged tail is dropped, good records stay
+    {
+        auto* f = fopen(path.c_str(), "a");
+        fwrite("\x05\x00\x00\x00\xff\x00", 1, 6, f);
+        fclose(f);
+
+        CertDiskCache disk(path, "gen-1");
+        ASSERT_EQ(disk.size(), 2);
+
+        // with own private key
+        auto* own = KeyPool::generate(KeyPool::key_type_t::EC_P256);
+        ASSERT_TRUE(disk.store("c", cert, own));
+        EVP_PKEY_free(own);
+    }
+    {
+        CertDiskCache disk(path, "gen-1");
+        ASSERT_EQ(disk.size(), 3);
+
+        EVP_PKEY* k = nullptr;
+        auto* x = disk.load("c", &k);
+        ASSERT_NE(x, nullptr);
+        ASSERT_NE(k, nullptr);
+        ASSERT_EQ(EVP_PKEY_base_id(k), EVP_PKEY_EC);
+        X509_free(x);
+        EVP_PKEY_free(k);
+    }
+
+    // CA changed
+    {
+        CertDiskCache disk(path, "gen-2");
+        ASSERT_EQ(disk.size(), 0);
+
+        EVP_PKEY* k = nullptr;
+        ASSERT_EQ(disk.load("a", &k), nullptr);
+    }
+
+    spoofed->release();
+
+    // factory stores spoofed certificate and finds it again by original cert fingerprint
+    SSLFactory::options::disk_cache = true;
+
+    auto hits = CertDiskCache::stats_t::hits.load();
+    std::string const key = "subj:/CN=www.example.test+disk";
+
+    auto first = fac->spoof_or_load(key, orig);
+    auto second = fac->spoof_or_load(key, orig);
+    ASSERT_TRUE(first.has_value() and second.has_value());
+    ASSERT_EQ(CertDiskCache::stats_t::hits, hits + 1);
+    ASSERT_EQ(X509_cmp(first->chain.cert, second->chain.cert), 0);
+
+    first->release();
+    second->release();
+
+    SSLFactory::options::disk_cache = false;
+    X509_free(orig);
+}
+
+
+TEST(KeyPool, UniqueKeys) {
+
+    auto* fac = init_factory();
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    auto* orig = load_orig();
+    ASSERT_NE(orig, nullptr);
+
+    KeyPool::params_t::type = KeyPool::key_type_t::EC_P256;
+    KeyPool::params_t::size = 4;
+    while(KeyPool::get().available() < 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    SSLFactory::options::unique_keys = true;
+    auto a = fac->spoof(orig);
+    auto b = fac->spoof(orig);
+    SSLFactory::options::unique_keys = false;
+
+    ASSERT_TRUE(a.has_value() and b.has_value());
+    ASSERT_EQ(EVP_PKEY_base_id(a->chain.key), EVP_PKEY_EC);
+    ASSERT_NE(EVP_PKEY_eq(a->chain.key, b->chain.key), 1);
+
+    // certificate carries the key
+    ASSERT_EQ(X509_check_private_key(a->chain.cert, a->chain.key), 1);
+
+    a->release();
+    b->release();
+    X509_free(orig);
+}
+
+
+// Benchmark: spoofs per second with RSA and ECDSA CA, shared default leaf key or own pooled keys.
+// Disabled by default, run with --gtest_also_run_disabled_tests --gtest_filter=KeyPool.DISABLED_Benchmark
+TEST(KeyPool, DISABLED_Benchmark) {
+
+    auto* fac = init_factory();
+    if(not fac) GTEST_SKIP() << "openssl CLI needed to create test certificates";
+
+    auto* orig = load_orig();
+    ASSERT_NE(orig, nullptr);
+
+    // factory and key pool are process-wide: put them back even if an assertion bails out early
+    struct restore_t {
+        SSLFactory* fac;
+        std::string certs_path = fac->certs_path();
+        bool unique_keys = SSLFactory::options::unique_keys;
+        std::size_t size = KeyPool::params_t::size;
+        KeyPool::key_type_t type = KeyPool::params_t::type;
+
+        ~restore_t() {
+            SSLFactory::options::unique_keys = unique_keys;
+            KeyPool::params_t::size = size;
+            KeyPool::params_t::type = type;
+
+            fac->certs_path() = certs_path;
+            fac->load_from_files();
+        }
+    } restore { fac };
+
+    auto const base = fac->certs_path();
+    constexpr std::size_t count = 50;
+
+    std::vector<std::pair<std::string, std::string>> cas = {
+            { "rsa-2048", "-newkey rsa:2048" },
+            { "rsa-4096", "-newkey rsa:4096" },
+            { "ec-p256", "-newkey ec -pkeyopt ec_paramgen_curve:P-256" } };
+
+    std::cout << "CA         leaf key        spoofs/s\n";
+    for(auto const& [ ca_name, ca_opt ]: cas) {
+
+        auto dir = base + "bench-" + ca_name + "/";
+        auto cmd = "mkdir -p " + dir + " && cd " + dir + " && cp ../srv-* ../cl-* . && "
+                   "openssl req -x509 " + ca_opt + " -nodes -days 2 -subj /CN=socle-bench-ca "
+                   "-keyout ca-key.pem -out ca-cert.pem >/dev/null 2>&1";
+        ASSERT_EQ(std::system(cmd.c_str()), 0);
+
+        fac->certs_path() = dir;
+        ASSERT_TRUE(fac->load_from_files());
+
+        for(auto leaf: { std::string("default"), std::string("rsa-2048"), std::string("ec-p256") }) {
+
+            SSLFactory::options::unique_keys = (leaf != "default");
+            if(SSLFactory::options::unique_keys) {
+                KeyPool::params_t::type = leaf == "ec-p256" ? KeyPool::key_type_t::EC_P256 : KeyPool::key_type_t::RSA2048;
+                KeyPool::params_t::size = count;
+
+                // keys are generated ahead, outside of measured time
+                while(KeyPool::get().available() < count) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for(std::size_t i = 0; i < count; ++i) {
+                auto r = fac->spoof(orig);
+                ASSERT_TRUE(r.has_value());
+                r->release();
+            }
+            auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::cout << string_format("%-10s %-15s %8.1f\n", ca_name.c_str(), leaf.c_str(), count / secs);
+        }
+    }
+
+    X509_free(orig);
+}
@@ -0,0 +1,226 @@
+#include <udpcom.hpp>
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+// loopback UDP receiver: returns socket and its port
+static std::pair<int, unsigned short> udp_receiver() {
+
+    int s = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in sa {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int rcvbuf = 16*1024*1024;
+    ::setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    ::bind(s, (sockaddr*)&sa, sizeof(sa));
+
+    socklen_t sl = sizeof(sa);
+    ::getsockname(s, (sockaddr*)&sa, &sl);
+
+    return { s, ntohs(sa.sin_port) };
+}
+
+// receive datagrams until timeout, return their sizes
+static std::vector<ssize_t> udp_collect(int s, std::size_t max) {
+    timeval tv { 0, 200000 };
+    ::setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::vector<ssize_t> ret;
+    std::vector<unsigned char> b(65536);
+    while(ret.size() < max) {
+        auto r = ::recv(s, b.data(), b.size(), 0);
+        if(r < 0) break;
+        ret.push_back(r);
+    }
+    return ret;
+}
+
+static void set_blocking(int fd) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+}
+
+
+TEST(UDPBatch, BoundariesKept) {
+
+    auto [ rs, port ] = udp_receiver();
+
+    UDPCom::config_t::tx_batch = true;
+    UDPCom::config_t::tx_batch_max = 64;
+
+    UDPCom com;
+    int fd = com.connect("127.0.0.1", std::to_string(port).c_str());
+    ASSERT_GT(fd, 0);
+
+    // 10 equal datagrams (GSO candidates), a short tail, then a differently sized one
+    std::vector<unsigned char> data(1200, 'x');
+    for(int i = 0; i < 10; ++i) ASSERT_EQ(com.write(fd, data.data(), 1200, 0), 1200);
+    ASSERT_EQ(com.write(fd, data.data(), 300, 0), 300);
+    ASSERT_EQ(com.write(fd, data.data(), 700, 0), 700);
+
+    ASSERT_EQ(com.tx_queued(), 12);
+    ASSERT_EQ(com.flush_writes(), 10*1200 + 300 + 700);
+    ASSERT_EQ(com.tx_queued(), 0);
+
+    auto got = udp_collect(rs, 12);
+    ASSERT_EQ(got.size(), 12);
+    for(int i = 0; i < 10; ++i) ASSERT_EQ(got[i], 1200);
+    ASSERT_EQ(got[10], 300);
+    ASSERT_EQ(got[11], 700);
+
+    UDPCom::config_t::tx_batch = false;
+    com.shutdown(fd);
+    ::close(rs);
+}
+
+
+TEST(UDPBatch, GroSplit) {
+
+    auto [ rs, port ] = udp_receiver();
+
+    UDPCom::config_t::rx_gro = true;
+    UDPCom::config_t::tx_batch = true;
+
+    // receiving side: connected socket with UDP_GRO
+    UDPCom com;
+    int fd = com.connect("127.0.0.1", std::to_string(port).c_str());
+    ASSERT_GT(fd, 0);
+
+    sockaddr_in local {};
+    socklen_t sl = sizeof(local);
+    ::getsockname(fd, (sockaddr*)&local, &sl);
+    ::connect(rs, (sockaddr*)&local, sizeof(local));
+
+    // sending side: GSO produces one super-datagram, which GRO socket gets coalesced.
+    // tx com's own socket is used only to set its destination; data must come from rs, com is connected to it.
+    UDPCom tx;
+    ::close(tx.connect("127.0.0.1", std::to_string(ntohs(local.sin_port)).c_str()));
+    int txfd = rs;
+
+    std::vector<unsigned char> data(1000, 'x');
+    for(int i = 0; i < 8; ++i) tx.write(txfd, data.data(), data.size(), 0);
+    tx.write(txfd, data.data(), 200, 0);
+    tx.flush_writes();
+
+    auto gro_reads = UDPCom::rx_stats_t::gro_reads.load();
+
+    std::vector<ssize_t> got;
+    std::array<unsigned char, 4096> b {};
+    for(int i = 0; i < 100 and got.size() < 9; ++i) {
+        auto r = com.read(fd, b.data(), b.size(), 0);
+        if(r > 0) got.push_back(r);
+        else std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    ASSERT_EQ(got.size(), 9);
+    for(int i = 0; i < 8; ++i) ASSERT_EQ(got[i], 1000);
+    ASSERT_EQ(got[8], 200);
+
+    std::cout << "gro coalesced reads: " << UDPCom::rx_stats_t::gro_reads - gro_reads << "\n";
+
+    UDPCom::config_t::rx_gro = false;
+    UDPCom::config_t::tx_batch = false;
+    com.shutdown(fd);
+    ::close(rs);
+}
+
+
+TEST(PacketRing, BoundedWithDrops) {
+
+    Datagram::params_t::rx_queue_size = 4;
+    Datagram d;
+    auto dropped = Datagram::stats_t::rx_dropped.load();
+
+    std::array<unsigned char, 100> pkt {};
+    for(unsigned char i = 0; i < 6; ++i) {
+        pkt[0] = i;
+        d.enqueue(pkt.data(), 10 + i);
+    }
+
+    ASSERT_EQ(d.rx_queue.size(), 4);
+    ASSERT_EQ(d.rx_dropped, 2);
+    ASSERT_EQ(Datagram::stats_t::rx_dropped, dropped + 2);
+    ASSERT_EQ(d.queue_bytes(), 10 + 11 + 12 + 13);
+
+    // FIFO order, ring wraps around after pop
+    std::array<unsigned char, 100> out {};
+    ASSERT_EQ(d.rx_queue.consume(out.data(), out.size(), true), 10);
+    ASSERT_EQ(d.rx_queue.consume(out.data(), out.size(), false), 10);
+    ASSERT_EQ(out[0], 0);
+
+    pkt[0] = 9;
+    ASSERT_EQ(d.enqueue(pkt.data(), 50), 50);
+
+    for(unsigned char expected: { 1, 2, 3, 9 }) {
+        d.rx_queue.consume(out.data(), out.size(), false);
+        ASSERT_EQ(out[0], expected);
+    }
+    ASSERT_TRUE(d.empty());
+
+    Datagram::params_t::rx_queue_size = 32;
+}
+
+
+// Benchmark: sending rate of one sendto() per datagram vs. sendmmsg vs. UDP_SEGMENT on loopback
+TEST(UDPBatch, Benchmark) {
+
+    constexpr std::size_t count = 200000;
+
+    auto run = [&](std::size_t dgram_size, bool batch, bool gso) -> double {
+        auto [ rs, port ] = udp_receiver();
+
+        UDPCom::config_t::tx_batch = batch;
+        UDPCom::config_t::tx_gso = gso;
+
+        UDPCom com;
+        int fd = com.connect("127.0.0.1", std::to_string(port).c_str());
+        set_blocking(fd);
+
+        std::atomic_bool done = false;
+        auto rx = std::thread([&rs, &done]() {
+            std::vector<unsigned char> b(65536);
+            while(not done) ::recv(rs, b.data(), b.size(), MSG_DONTWAIT);
+        });
+
+        std::vector<unsigned char> data(dgram_size, 'x');
+
+        auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < count; ++i) {
+            com.write(fd, data.data(), data.size(), 0);
+        }
+        com.flush_writes();
+        auto stop = std::chrono::steady_clock::now();
+
+        done = true;
+        rx.join();
+        com.shutdown(fd);
+        ::close(rs);
+
+        auto secs = std::chrono::duration<double>(stop - start).count();
+        return static_cast<double>(count) / secs / 1000.0;
+    };
+
+    auto gso_calls = UDPCom::tx_stats_t::gso_calls.load();
+
+    std::cout << "dgram size   sendto kpps   sendmmsg kpps   gso kpps\n";
+    for(std::size_t sz: { 64, 512, 1200, 1400 }) {
+        auto one = run(sz, false, false);
+        auto mm = run(sz, true, false);
+        auto gso = run(sz, true, true);
+        std::cout << string_format("%10d %13.1f %15.1f %10.1f\n", sz, one, mm, gso);
+        ASSERT_GT(one, 0.0);
+    }
+
+    std::cout << "gso sends: " << UDPCom::tx_stats_t::gso_calls - gso_calls
+              << ", fallbacks: " << UDPCom::tx_stats_t::gso_fallbacks << "\n";
+
+    UDPCom::config_t::tx_batch = false;
+    UDPCom::config_t::tx_gso = true;
+}
@@ -26,6 +26,7 @@
 #include <vector>
 #include <thread>
 #include <random>
+#include <algorithm>
 
 #include <internet.hpp>
 #include <display.hpp>
@@ -152,7 +153,7 @@ std::optional<SocketInfo> ThreadedReceiver<Worker>::process_anc_data(int sock, m
 
 
 template<class Worker>
-int ThreadedReceiver<Worker>::add_first_datagrams(int sock, SocketInfo& pinfo) {
+int ThreadedReceiver<Worker>::add_first_datagrams(int sock, SocketInfo& pinfo, unsigned char* data, std::size_t len) {
 
     auto session_key = pinfo.create_session_key(true);
 
@@ -170,47 +171,78 @@ int ThreadedReceiver<Worker>::add_first_datagrams(int sock, SocketInfo& pinfo) {
 
 
 
-    // locks shared early datagram pool
-
     auto udpc = UDPCom::datagram_com_static();
-    auto lc_ = std::scoped_lock(udpc->lock);
+    auto& table = udpc->datagrams_received;
 
-    std::shared_ptr<Datagram> entry;
-    auto it = udpc->datagrams_received.find(session_key);
-    bool new_entry = 1;
+    // session key is a hash: occupied key may belong to a different flow, probe for ours or a free one
+    auto same_flow = [&pinfo](Datagram const& d) {
+        return SockOps::ss_same(&d.src, pinfo.src.as_ss()) and SockOps::ss_same(&d.dst, pinfo.dst.as_ss());
+    };
 
-    if(it != udpc->datagrams_received.end()) {
+    auto home_key = session_key;
+    std::unique_lock<std::recursive_mutex> lc_;
+    std::shared_ptr<Datagram> entry;
 
-        _dia("existing datagram");
+    // locks early datagram pool shard of the session key; find and insert must be atomic. Never hold two shards at once.
+    auto lock_key = [&](uint32_t key) {
+        if(lc_.owns_lock()) lc_.unlock();
+        lc_ = std::unique_lock<std::recursive_mutex>(table.shard_lock(key));
+        entry = table.find(key);
+    };
 
-        if(! it->second) {
-            _deb("existing datagram - null");
-            it->second = create_new_entry(sock, pinfo);
+    bool placed = false;
+    while(not placed) {
+        session_key = home_key;
+        std::optional<uint32_t> free_key;
+        lock_key(session_key);
+
+        // probe for our flow until the end of chain; tombstones of erased records don't end it
+        while(entry ? not same_flow(*entry) : table.tombstone(session_key)) {
+            if(entry)
+                entry->probed = true;
+            else if(not free_key)
+                free_key = session_key;
+
+            session_key = SocketInfo::next_session_key(session_key);
+            lock_key(session_key);
         }
-        entry = it->second;
-        new_entry = 0;
-    } else {
 
-        _dia("new datagram");
+        placed = true;
 
-        entry = create_new_entry(sock, pinfo);
-        udpc->datagrams_received[session_key] = entry;
+        // new flow takes first tombstone in the chain, unless it was taken meanwhile
+        if(not entry and free_key) {
+            lock_key(free_key.value());
+            placed = (not entry and table.tombstone(free_key.value()));
+            session_key = free_key.value();
+        }
     }
 
+    bool new_entry = not entry;
+    if(new_entry) {
+        _dia("new datagram");
 
-    // receiving data
+        if(session_key != home_key) {
+            stats_t::key_collisions++;
+            _not("ThreadedReceiver::add_first_datagrams[%d]: session key 0x%x collision, %s -> %s stored as 0x%x", sock,
+                 home_key, pinfo.src_ss_str().c_str(), pinfo.dst_ss_str().c_str(), session_key);
+        }
 
-    constexpr int buff_sz = 2048;
-    unsigned char buff[buff_sz];
-    memset(buff, 0, buff_sz);
+        // new record is complete before other threads can see it
+        entry = create_new_entry(sock, pinfo);
+        // tombstone reused: chain continues past it
+        entry->probed = table.tombstone(session_key);
+        entry->socket_left = pinfo.create_socket_left(com()->l4_proto());
+        if(UDPCom::config_t::rx_gro) {
+            com()->so_udp_gro(entry->socket_left.value());
+        }
+    } else {
+        _dia("existing datagram");
+    }
 
-    auto red = com()->read(sock, buff, buff_sz, 0);
 
+    // data was already received by the caller, just account it
+    auto red = static_cast<int>(len);
     _dia("red: %d bytes from socket %d", red, sock);
-    if(red < 0) {
-        _err("read returned %d", red);
-        return -1;
-    }
 
     int enk = 0;
 
@@ -219,18 +251,18 @@ int ThreadedReceiver<Worker>::add_first_datagrams(int sock, SocketInfo& pinfo) {
         // enqueue them to entry (new or existing)
 
         auto lc1_ = std::scoped_lock(entry->rx_queue_lock);
-        enk = entry->enqueue(buff, red);
+        enk = entry->enqueue(data, len);
 
         _dia("enk: %d bytes from socket %d", enk, sock);
     }
 
     if (red != enk) {
-        _err("ThreadedReceiver::add_first_datagrams[%d]: cannot enqueue data of size %d", sock, red);
+        _err("ThreadedReceiver::add_first_datagrams[%d]: session queue full, %dB dropped (%d drops in session)", sock, red, entry->rx_dropped);
     }
 
-    // crate sockets only for new entries
+    // publish new entries and hint workers
     if(new_entry) {
-        entry->socket_left = pinfo.create_socket_left(com()->l4_proto());
+        table.set(session_key, entry);
         hint_push_all(session_key);
     }
 
@@ -248,93 +280,57 @@ void ThreadedReceiver<Worker>::on_left_new_raw(int sock) {
 
     _dia("ThreadedReceiver::on_left_new_raw[%d]: start", sock);
 
-    constexpr unsigned int recv_buff_sz = 2048;
-    constexpr unsigned int cmbuf_sz = 2048;
+    // each datagram is received exactly once together with its IP_ORIGDSTADDR control data,
+    // up to recv_batch of them per syscall
+    auto batch = std::max(1U, params_t::recv_batch.load());
+    rx_batch_.resize(batch);
 
-    unsigned char dummy_buffer[32];
     int iter = 0;
 
-
-
-    do {
+    while(true) {
         _deb("receiver read iteration %d", iter++);
 
-        unsigned char recv_buf_[recv_buff_sz];
-        char cmbuf[cmbuf_sz];
-        sockaddr_storage from{};
-        iovec io{};
-
-        msghdr msg{};
+        for(unsigned int i = 0; i < batch; ++i) rx_batch_.reset(i);
 
-        auto clear_state = [&]() {
-            memset(recv_buf_, 0, recv_buff_sz);
-            memset(cmbuf, 0, cmbuf_sz);
-            memset(&from, 0, sizeof(sockaddr_storage));
-            memset(&msg, 0, sizeof(msg));
-            memset(&io, 0, sizeof(iovec));
-
-            msg.msg_name = &from;
-            msg.msg_namelen = sizeof(from);
-            msg.msg_control = cmbuf;
-            msg.msg_controllen = sizeof(cmbuf);
-
-            io.iov_base = recv_buf_;
-            io.iov_len = sizeof(recv_buf_);
-
-            msg.msg_iov = &io;
-            msg.msg_iovlen = 1;
-
-            _deb(" receiver state cleared");
-        };
-
-        auto dummy_read = [&]() {
-            int l = ::recvmsg(sock, &msg, O_NONBLOCK);
-            _deb("receiver dummy read");
-
-            clear_state();
-
-            return l;
-        };
-
-
-        clear_state();
-
-
-        int len = ::recvmsg(sock, &msg, MSG_PEEK);
-        if (len < 0) {
-            _dia("[0x%x] new_raw: inner peek returned %d (return)", std::this_thread::get_id(), len);
+        int cnt = ::recvmmsg(sock, rx_batch_.msgs.data(), batch, MSG_DONTWAIT, nullptr);
+        if (cnt <= 0) {
+            _dia("[0x%x] new_raw: recvmmsg returned %d (return)", std::this_thread::get_id(), cnt);
             return;
-        } else {
-            _dia("[0x%x] new_raw: inner peek returned %d", std::this_thread::get_id(), len);
         }
 
-        try {
-            auto creds = process_anc_data(sock, &msg);
+        stats_t::batches++;
+        stats_t::datagrams += cnt;
+        _dia("[0x%x] new_raw: recvmmsg returned %d datagrams", std::this_thread::get_id(), cnt);
 
-            if (creds.has_value()) {
-                _dia("packet headers processing finished");
+        for(int i = 0; i < cnt; ++i) {
+            auto* msg = &rx_batch_.msgs[i].msg_hdr;
+            auto len = rx_batch_.msgs[i].msg_len;
 
-                // NOTE:
-                // keeping it here for reference: this is proof we can bind and create sockets with matching tuples, all can be used
-                // to send data (but obviously only one is selected by OS to deliver data from network
+            if(msg->msg_flags & MSG_TRUNC) {
+                stats_t::truncated++;
+                _war("ThreadedReceiver::on_left_new_raw[%d]: datagram truncated to %dB", sock, len);
+            }
 
-                // int fd2 = creds.value().create_client_socket(com()->l4_proto());
-                // ::send(fd2, "post2", 5, MSG_DONTWAIT);
+            try {
+                auto creds = process_anc_data(sock, msg);
 
+                if (creds.has_value()) {
+                    _dia("packet headers processing finished");
 
-                if(add_first_datagrams(sock, creds.value()) < 0) break;
+                    add_first_datagrams(sock, creds.value(), rx_batch_.slots[i].data.data(), len);
 
-            } else {
-                int l = dummy_read();
-                _err("packet headers processing failed, %d bytes flushed out", l);
+                } else {
+                    _err("packet headers processing failed, %d bytes flushed out", len);
+                }
+            }
+            catch(socket_info_error const& e) {
+                _err("socket error: %s", e.what());
             }
-        }
-        catch(socket_info_error const& e) {
-            _err("socket error: %s", e.what());
-            // _cons(string_format("socket error: %s", e.what()).c_str());
         }
 
-    } while(::recv(sock, dummy_buffer,32,O_NONBLOCK|MSG_PEEK) > 0);
+        // partial batch: socket is drained
+        if(static_cast<unsigned int>(cnt) < batch) break;
+    }
 }
 
 template<class Worker>
@@ -422,20 +418,19 @@ int ThreadedReceiverProxy<SubWorker>::handle_sockets_once(baseCom* xcom) {
     // datagram lock
     {
     auto udpc = UDPCom::datagram_com_static();
-    auto l_ = std::scoped_lock(udpc->lock);
-
+    // size() locks all shards, call it before holding one of them
     _dia("ThreadedReceiverProxy::handle_sockets_once: DatagramCom::datagrams_received.size() = %d",
             udpc->datagrams_received.size());
 
-    auto it_record = udpc->datagrams_received.find(virtual_socket);
-    found = (it_record != udpc->datagrams_received.end());
+    auto l_ = std::scoped_lock(udpc->datagrams_received.shard_lock(virtual_socket));
+
+    auto record = udpc->datagrams_received.find(virtual_socket);
+    found = (record != nullptr);
 
     if (found) {
 
         _dia("ThreadedReceiverProxy::handle_sockets_once[%d]: found in datagram pool", virtual_socket);
 
-        auto record = it_record->second;
-
         if(record->socket_left.has_value())
             _record_socket_left = record->socket_left.value();
 
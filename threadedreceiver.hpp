@@ -32,6 +32,10 @@
 #include <thread>
 #include <mutex>
 #include <map>
+#include <array>
+#include <atomic>
+
+#include <sys/socket.h>
 
 
 
@@ -40,6 +44,18 @@ template<class Worker>
 class ThreadedReceiver : public baseProxy, public FdQueueHandler, public hasWorkers<Worker> {
 public:
 
+    struct params_t {
+        // how many datagrams are pulled from catch-all socket by single recvmmsg() call
+        static inline std::atomic_uint recv_batch = 32;
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> batches = 0;
+        static inline std::atomic<std::size_t> datagrams = 0;
+        static inline std::atomic<std::size_t> truncated = 0;
+        static inline std::atomic<std::size_t> key_collisions = 0;
+    };
+
     ThreadedReceiver(std::shared_ptr<FdQueue> fdq, baseCom* c, proxyType t);
     ~ThreadedReceiver() override;
     
@@ -50,13 +66,9 @@ public:
     // get original IP, etc
     std::optional<SocketInfo> process_anc_data(int sock, msghdr* msg);
 
-    // enqueue new data to early received packets from catch-all socket
-    // return  tuple:
-    // 0: true if the session is new
-    // 1: session key
-
-
-    int add_first_datagrams(int sock, SocketInfo& pinfo);
+    // enqueue already received datagram to early received packets from catch-all socket
+    // returns 1 if the session is new, 0 if existing, -1 on error
+    int add_first_datagrams(int sock, SocketInfo& pinfo, unsigned char* data, std::size_t len);
     void on_left_new_raw(int) override;
     void on_right_new_raw(int) override;
     
@@ -73,6 +85,48 @@ private:
     proxyType proxy_type_;
     mp::vector<int>* quick_list_ = nullptr;
 
+    // preallocated recvmmsg() state, reused across on_left_new_raw calls
+    struct rx_batch_t {
+        static constexpr std::size_t buff_sz = 2048;
+        static constexpr std::size_t cmbuf_sz = 512;
+
+        struct slot_t {
+            std::array<unsigned char, buff_sz> data;
+            std::array<char, cmbuf_sz> cmbuf;
+            sockaddr_storage from;
+            iovec io;
+        };
+
+        std::vector<mmsghdr> msgs;
+        std::vector<slot_t> slots;
+
+        void resize(std::size_t n) {
+            if(slots.size() == n) return;
+            slots.resize(n);
+            msgs.resize(n);
+        }
+
+        // prepare slot i for the next receive
+        void reset(std::size_t i) {
+            auto& sl = slots[i];
+            auto& hdr = msgs[i].msg_hdr;
+
+            sl.from = {};
+            sl.io.iov_base = sl.data.data();
+            sl.io.iov_len = sl.data.size();
+
+            hdr = {};
+            hdr.msg_name = &sl.from;
+            hdr.msg_namelen = sizeof(sl.from);
+            hdr.msg_control = sl.cmbuf.data();
+            hdr.msg_controllen = sl.cmbuf.size();
+            hdr.msg_iov = &sl.io;
+            hdr.msg_iovlen = 1;
+            msgs[i].msg_len = 0;
+        }
+    };
+    rx_batch_t rx_batch_;
+
     logan_lite log {"com.udp.acceptor"};
 };
 
@@ -17,6 +17,8 @@
 */
 
 
+#include <netinet/udp.h>
+
 #include <udpcom.hpp>
 #include <display.hpp>
 #include <socketinfo.hpp>
@@ -63,12 +65,8 @@ int UDPCom::translate_socket(int vsock) const {
     } else {
         
         
-        auto lc = std::scoped_lock(datagram_com()->lock);
-        
-        auto it_dgram = datagram_com()->datagrams_received.find((unsigned int)vsock);
-        if(it_dgram != datagram_com()->datagrams_received.end())  {
-            auto d = it_dgram->second;
-            
+        auto d = datagram_com()->datagrams_received.find((unsigned int)vsock);
+        if(d)  {
             _dia("UDPCom::translate_socket[%d]: found in table",vsock);
             if(d->socket_left.has_value()) {
                 _dia("UDPCom::translate_socket[%d]: translated to real %d", vsock, d->socket_left.value_or(-1));
@@ -303,6 +301,10 @@ int UDPCom::connect(const char* host, const char* port) {
         }
 
 
+        if(config_t::rx_gro and not from_cache) {
+            so_udp_gro(sfd);
+        }
+
         if(! GLOBAL_IO_BLOCKING() ) {
             unblock(sfd);
         }
@@ -338,11 +340,8 @@ bool UDPCom::is_connected(int s) {
 
 bool UDPCom::resolve_nonlocal_socket(int sock) {
 
-    std::lock_guard<std::recursive_mutex> l(datagram_com()->lock);
-    
-    auto it_record = datagram_com()->datagrams_received.find((unsigned int)sock);
-    if(it_record != datagram_com()->datagrams_received.end()) {
-        auto record = (*it_record).second;
+    auto record = datagram_com()->datagrams_received.find((unsigned int)sock);
+    if(record) {
         char b[64]; memset(b,0,64);
         
         _dia("UDPCom::resolve_nonlocal_socket[%x]: found datagram pool entry",sock);
@@ -389,11 +388,8 @@ bool UDPCom::in_readset(int s) {
 
     if(s < 0) {
 
-        std::lock_guard<std::recursive_mutex> l(datagram_com()->lock);
-
-        auto it_record = datagram_com()->datagrams_received.find((unsigned int) s);
-        if (it_record != datagram_com()->datagrams_received.end()) {
-            auto record = (*it_record).second;
+        auto record = datagram_com()->datagrams_received.find((unsigned int) s);
+        if (record) {
 
             if (record->socket_left.has_value()) {
                 _deb("UDPCom::in_readset[%d]: fyi - record contains real socket %d", s, record->socket_left.value());
@@ -405,14 +401,8 @@ bool UDPCom::in_readset(int s) {
             {
                 auto l_ = std::scoped_lock(record->rx_queue_lock);
 
-                int elem = 0;
-                int elem_bytes = 0;
-                for (auto const &r: record->rx_queue) {
-                    if (!r.empty()) {
-                        elem_bytes += r.size();
-                        _deb("UDPCom::in_readset[%d]: record found, data size %dB at pos #%d", s, r.size(), elem);
-                    }
-                }
+                auto elem_bytes = record->queue_bytes();
+                _deb("UDPCom::in_readset[%d]: record found, %d datagrams, %dB queued", s, record->rx_queue.size(), elem_bytes);
 
                 bool ret = (elem_bytes > 0);
                 if (ret) {
@@ -439,6 +429,8 @@ bool UDPCom::in_readset(int s) {
             return false;
         }
     } else if (s > 0) {
+        if(not gro_rest_.empty()) return true;
+
         bool r = baseCom::in_readset(s);
         _deb("UDPCom::in_readset[%d]: real socket, returning %d", s, r);
         return r;
@@ -451,10 +443,7 @@ bool UDPCom::in_readset(int s) {
 
 bool UDPCom::in_writeset(int s) {
     
-    std::lock_guard<std::recursive_mutex> l(datagram_com()->lock);
-
-    auto it_record = datagram_com()->datagrams_received.find((unsigned int)s);
-    if(it_record != datagram_com()->datagrams_received.end()) {
+    if(datagram_com()->datagrams_received.find((unsigned int)s)) {
         _ext("UDPCom::in_writeset: found data for %d (thus virtual socket is writable)",s);
         return true;
     } else {
@@ -465,14 +454,6 @@ bool UDPCom::in_writeset(int s) {
 }
 
 bool UDPCom::in_exset(int s) {
-    
-    std::lock_guard<std::recursive_mutex> l(datagram_com()->lock);
-    
-    auto it_record = datagram_com()->datagrams_received.find((unsigned int)s);
-    if(it_record != datagram_com()->datagrams_received.end()) {
-        return false;
-    } 
-
     return false;
 }
 
@@ -511,93 +492,122 @@ ssize_t UDPCom::read(int _fd, void* _buf, size_t _n, int _flags) {
     if (_fd < 0) {
         return read_from_pool(_fd, _buf, _n, _flags);
     } else {
-        return recv(_fd, _buf, _n, _flags);
+        auto r = recv_gro(_fd, _buf, _n, _flags, gro_rest_);
+
+        // socket won't signal again for segments already received
+        if(not gro_rest_.empty()) rescan_read(_fd);
+
+        return r;
     }
 }
 
-int UDPCom::read_from_pool(int _fd, void* _buf, size_t _n, int _flags) {
-
-    auto lc_ =  std::scoped_lock(datagram_com()->lock);
-    
-    auto it_record = datagram_com()->datagrams_received.find((unsigned int)_fd);
-    if(it_record != datagram_com()->datagrams_received.end()) {
-        auto record = (*it_record).second;
+ssize_t UDPCom::recv_gro(int _fd, void* _buf, size_t _n, int _flags, gro_rest_t& rest) {
 
-        if(record->socket_left.has_value() && record->queue_bytes() == 0) {
-            _dia("UDPCom::read_from_pool[%d]: pool empty, reading  from real socket %d", _fd, record->socket_left.value());
-            return recv(record->socket_left.value(), _buf, _n, _flags);
-        }
-        
-        auto dl_ = std::scoped_lock(record->rx_queue_lock);
-        
-        if(! record->empty()) {
+    bool peek = (_flags & MSG_PEEK);
 
+    if(not rest.empty()) {
+        return static_cast<ssize_t>(rest.take(_buf, _n, peek));
+    }
 
-            int copied = 0;
+    if(not config_t::rx_gro) {
+        return recv(_fd, _buf, _n, _flags);
+    }
 
-            int elem_index = -1;
-            for(auto& queue_elem : record->rx_queue) {
-                elem_index++;
+    // super-datagram can be up to 64kB, it's received whole and split here
+    thread_local std::array<unsigned char, 65536> gro_buf;
 
-                _dia("UDPCom::read_from_pool[%d]: pool entry %d", _fd, elem_index);
+    std::array<char, CMSG_SPACE(sizeof(int))> cmbuf {};
+    iovec io { gro_buf.data(), gro_buf.size() };
 
-                int elem_size = queue_elem.size();
-                if(elem_size <= 0) continue;
+    msghdr msg {};
+    msg.msg_iov = &io;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cmbuf.data();
+    msg.msg_controllen = cmbuf.size();
 
-                int to_copy = std::min<int>(_n, elem_size);
+    auto len = ::recvmsg(_fd, &msg, _flags);
+    if(len < 0) return len;
 
-                memcpy(_buf, queue_elem.data(), to_copy);
-                copied += to_copy;
+    std::size_t segment = len;
+    for(auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO) {
+            int gso_size = 0;
+            memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+            if(gso_size > 0) segment = gso_size;
+        }
+    }
 
-                //_cons(string_format("read_from_pool: copying %dB from buffer of size %d", to_copy, elem_size).c_str());
+    auto cp = std::min({ _n, segment, static_cast<size_t>(len) });
+    memcpy(_buf, gro_buf.data(), cp);
 
-                if(! (_flags & MSG_PEEK)) {
+    if(segment < static_cast<size_t>(len) and not peek) {
+        rest.data.append(gro_buf.data() + segment, len - segment);
+        rest.segment = segment;
 
-                    queue_elem.flush(to_copy);
-                    _dia("UDPCom::read_from_pool[%d]: retrieved %d bytes from receive pool, in buffer left %d bytes", _fd, copied, queue_elem.size());
+        rx_stats_t::gro_reads++;
+        rx_stats_t::gro_segments += (len + segment - 1) / segment;
+        _deb("UDPCom::recv_gro[%d]: %dB received coalesced, segment size %d", _fd, len, segment);
+    }
 
-                    if(copied >= elem_size) {
+    return static_cast<ssize_t>(cp);
+}
 
-                        int rem_count = 0;
-                        {
-                            auto ul_ = std::scoped_lock(datagram_com()->lock);
-                            rem_count = datagram_com()->in_virt_set.erase(_fd);
-                        }
+int UDPCom::read_from_pool(int _fd, void* _buf, size_t _n, int _flags) {
 
-                        if(rem_count > 0) {
-                            _dia("buffer read to zero, erased %d entries in in_virt_set", rem_count);
-                        }
-                    }
+    // record data are protected by its rx_queue_lock, table shard doesn't need to stay locked
+    auto record = datagram_com()->datagrams_received.find((unsigned int)_fd);
+    if(record) {
 
-                } else {
-                    _dia("UDPCom::read_from_pool[%x]: peek %d bytes from receive pool, in buffer is %d bytes", _fd, copied, queue_elem.size());
-                }
+        if(record->socket_left.has_value() && record->queue_bytes_l() == 0) {
+            _dia("UDPCom::read_from_pool[%d]: pool empty, reading  from real socket %d", _fd, record->socket_left.value());
 
-                // perform only one read to 'packetized' behaviour
-                break;
+            if(not config_t::rx_gro) {
+                return recv(record->socket_left.value(), _buf, _n, _flags);
             }
 
-            // because we did not necessarily traversed all entries, we need to make sure there is nothing left
-            // if more data, we *must* add it back to in_set - expect timeouts and delays otherwise.
+            auto dl_ = std::scoped_lock(record->rx_queue_lock);
+            auto r = recv_gro(record->socket_left.value(), _buf, _n, _flags, record->gro_rest);
+
+            // coalesced segments left behind are served as pool data
+            if(not record->gro_rest.empty()) datagram_com()->in_virt_set.insert(_fd);
+
+            return r;
+        }
+        
+        auto dl_ = std::scoped_lock(record->rx_queue_lock);
+        
+        if(! record->empty()) {
+
 
-            int bytes_left = 0;
-            int elems_left = 0;
-            for(auto& queue_elem : record->rx_queue) {
-                if(! queue_elem.empty()) {
-                    bytes_left += queue_elem.size();
-                    elems_left++;
+            int copied = 0;
+
+            if(not record->gro_rest.empty()) {
+                copied = static_cast<int>(record->gro_rest.take(_buf, _n, _flags & MSG_PEEK));
+                if(record->empty()) {
+                    datagram_com()->in_virt_set.erase(_fd);
                 }
+                return copied;
             }
 
-            // keeping for debug
-            //_cons(string_format("read_from_pool: %dB in %d entries has been left behind", bytes_left, elems_left).c_str());
-            if(bytes_left > 0) {
+            bool peek = (_flags & MSG_PEEK);
+            copied = static_cast<int>(record->rx_queue.consume(_buf, _n, peek));
 
-                //_cons(string_format("adding %d to inset", _fd).c_str());
-                auto ul_ = std::scoped_lock(datagram_com()->lock);
-                datagram_com()->in_virt_set.insert(_fd);
+            // perform only one read to 'packetized' behaviour
+            if(! peek) {
+                _dia("UDPCom::read_from_pool[%d]: retrieved %d bytes from receive pool, left %d datagrams, %dB", _fd, copied,
+                     record->rx_queue.size(), record->rx_queue.bytes());
+            } else {
+                _dia("UDPCom::read_from_pool[%x]: peek %d bytes from receive pool, in pool is %dB", _fd, copied, record->rx_queue.bytes());
             }
 
+            // if more data, we *must* keep it in in_set - expect timeouts and delays otherwise.
+            if(record->empty()) {
+                if(datagram_com()->in_virt_set.erase(_fd) > 0) {
+                    _dia("pool read to zero, erased entry in in_virt_set");
+                }
+            } else {
+                datagram_com()->in_virt_set.insert(_fd);
+            }
 
             return copied;
         }
@@ -618,6 +628,10 @@ ssize_t UDPCom::write(int _fd, const void* _buf, size_t _n, int _flags)
         return write_to_pool(_fd, _buf, _n, _flags);
     } else {
 
+        if(config_t::tx_batch) {
+            return tx_enqueue(_fd, true, _buf, _n);
+        }
+
         std::string rps;
         unsigned short port;
         int fa = SockOps::ss_address_unpack(&udpcom_addr, &rps, &port);
@@ -636,14 +650,14 @@ ssize_t UDPCom::write(int _fd, const void* _buf, size_t _n, int _flags)
 
 ssize_t UDPCom::write_to_pool(int _fd, const void* _buf, size_t _n, int _flags) {
     
-    auto lc_ = std::scoped_lock(datagram_com()->lock);
-    
-    auto it_record = datagram_com()->datagrams_received.find((unsigned int)_fd);
-    if(it_record != datagram_com()->datagrams_received.end()) {
-        auto record = (*it_record).second;
-
+    auto record = datagram_com()->datagrams_received.find((unsigned int)_fd);
+    if(record) {
 
         if(record->socket_left.has_value()) {
+            if(config_t::tx_batch) {
+                return tx_enqueue(record->socket_left.value(), false, _buf, _n);
+            }
+
             _dia("UDPCom::write_to_pool[%d]: about to write %d bytes into real socket %d", _fd, _n, record->socket_left.value());
             ssize_t l = ::send(record->socket_left.value(), _buf, _n, 0);
 
@@ -806,14 +820,190 @@ ssize_t UDPCom::write_to_pool(int _fd, const void* _buf, size_t _n, int _flags)
     }
 }
 
+ssize_t UDPCom::tx_enqueue(int fd, bool addressed, const void* _buf, size_t _n) {
+
+    tx_queue_.push_back({ .fd = fd, .addressed = addressed, .offset = tx_data_.size(), .len = _n });
+    tx_data_.append(_buf, _n);
+    tx_stats_t::queued++;
+
+    _ext("UDPCom::tx_enqueue[%d]: %dB queued, %d datagrams pending", fd, _n, tx_queue_.size());
+
+    if(tx_queue_.size() >= config_t::tx_batch_max) {
+        flush_writes();
+    }
+
+    return static_cast<ssize_t>(_n);
+}
+
+ssize_t UDPCom::flush_writes() {
+
+    if(tx_queue_.empty()) return 0;
+
+    // UDP_MAX_SEGMENTS in kernel and max size of one super-datagram
+    constexpr std::size_t gso_max_segs = 64;
+    constexpr std::size_t gso_max_bytes = 65000;
+
+    ssize_t total = 0;
+    std::size_t pending = 0;     // start of datagrams not sent yet, to go out by sendmmsg
+
+    auto same_target = [this](std::size_t a, std::size_t b) {
+        return tx_queue_[a].fd == tx_queue_[b].fd and tx_queue_[a].addressed == tx_queue_[b].addressed;
+    };
+
+    for(std::size_t i = 0; i < tx_queue_.size(); ) {
+
+        // one sendmmsg call can't mix sockets
+        if(i > pending and not same_target(pending, i)) {
+            total += tx_send_mmsg(pending, i);
+            pending = i;
+        }
+
+        std::size_t j = i + 1;
+        if(config_t::tx_gso and not tx_gso_unsupported_) {
+
+            // GSO run: same target, same size, only the last segment may be shorter
+            auto seg = tx_queue_[i].len;
+            auto bytes = seg;
+            while(j < tx_queue_.size() and j - i < gso_max_segs and same_target(i, j)
+                  and tx_queue_[j].len <= seg and bytes + tx_queue_[j].len <= gso_max_bytes) {
+
+                bytes += tx_queue_[j].len;
+                if(tx_queue_[j++].len < seg) break;
+            }
+        }
+
+        if(j - i > 1) {
+            if(i > pending) {
+                total += tx_send_mmsg(pending, i);
+                pending = i;
+            }
+
+            // if not sent, the run stays pending for sendmmsg
+            if(auto r = tx_send_gso(i, j); r >= 0) {
+                total += r;
+                pending = j;
+            }
+        }
+        i = j;
+    }
+
+    if(pending < tx_queue_.size()) {
+        total += tx_send_mmsg(pending, tx_queue_.size());
+    }
+
+    _deb("UDPCom::flush_writes: %d datagrams, %dB sent", tx_queue_.size(), total);
+
+    tx_queue_.clear();
+    tx_data_.clear();
+
+    return total;
+}
+
+ssize_t UDPCom::tx_send_gso(std::size_t from, std::size_t to) {
+
+    auto const& first = tx_queue_[from];
+    auto const& last = tx_queue_[to - 1];
+
+    // payloads are stored back to back, the whole run is one iovec
+    iovec io {};
+    io.iov_base = tx_data_.data() + first.offset;
+    io.iov_len = last.offset + last.len - first.offset;
+
+    std::array<char, CMSG_SPACE(sizeof(uint16_t))> cmbuf {};
+
+    msghdr msg {};
+    msg.msg_iov = &io;
+    msg.msg_iovlen = 1;
+    if(first.addressed) {
+        msg.msg_name = &udpcom_addr;
+        msg.msg_namelen = sizeof(sockaddr_storage);
+    }
+    msg.msg_control = cmbuf.data();
+    msg.msg_controllen = cmbuf.size();
+
+    auto* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t seg = first.len;
+    memcpy(CMSG_DATA(cmsg), &seg, sizeof(seg));
+
+    auto l = ::sendmsg(first.fd, &msg, MSG_NOSIGNAL);
+    if(l < 0) {
+        if(errno == EINVAL or errno == EMSGSIZE) {
+            // segment doesn't fit into path MTU, send this run datagram by datagram
+            _deb("UDPCom::tx_send_gso[%d]: segment size %d refused: %s", first.fd, first.len, string_error().c_str());
+            tx_stats_t::gso_fallbacks++;
+            return -1;
+        }
+        else if(errno == EIO or errno == ENOPROTOOPT or errno == EOPNOTSUPP) {
+            // no GSO on this kernel/device, don't try again
+            _not("UDPCom::tx_send_gso[%d]: UDP_SEGMENT not supported, falling back to sendmmsg: %s", first.fd, string_error().c_str());
+            tx_gso_unsupported_ = true;
+            tx_stats_t::gso_fallbacks++;
+            return -1;
+        }
+
+        _err("UDPCom::tx_send_gso[%d]: %d datagrams dropped: %s", first.fd, to - from, string_error().c_str());
+        tx_stats_t::dropped += to - from;
+        return 0;
+    }
+
+    tx_stats_t::gso_calls++;
+    _ext("UDPCom::tx_send_gso[%d]: %d segments of %dB, sent %d bytes", first.fd, to - from, seg, l);
+
+    return l;
+}
+
+ssize_t UDPCom::tx_send_mmsg(std::size_t from, std::size_t to) {
+
+    auto cnt = to - from;
+    tx_msgs_.resize(cnt);
+    tx_iov_.resize(cnt);
+
+    for(std::size_t k = 0; k < cnt; ++k) {
+        auto const& e = tx_queue_[from + k];
+
+        tx_iov_[k].iov_base = tx_data_.data() + e.offset;
+        tx_iov_[k].iov_len = e.len;
+
+        tx_msgs_[k] = {};
+        tx_msgs_[k].msg_hdr.msg_iov = &tx_iov_[k];
+        tx_msgs_[k].msg_hdr.msg_iovlen = 1;
+        if(e.addressed) {
+            tx_msgs_[k].msg_hdr.msg_name = &udpcom_addr;
+            tx_msgs_[k].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        }
+    }
+
+    int fd = tx_queue_[from].fd;
+    ssize_t total = 0;
+    std::size_t done = 0;
+
+    while(done < cnt) {
+        auto r = ::sendmmsg(fd, &tx_msgs_[done], cnt - done, MSG_NOSIGNAL);
+        tx_stats_t::sendmmsg_calls++;
+
+        if(r <= 0) {
+            // datagram semantics: what doesn't fit into socket now is lost, as it would be in a full send queue
+            _err("UDPCom::tx_send_mmsg[%d]: %d datagrams dropped: %s", fd, cnt - done, string_error().c_str());
+            tx_stats_t::dropped += cnt - done;
+            break;
+        }
+
+        for(int k = 0; k < r; ++k) total += tx_msgs_[done + k].msg_len;
+        done += r;
+    }
+
+    _ext("UDPCom::tx_send_mmsg[%d]: %d datagrams, sent %d bytes", fd, done, total);
+
+    return total;
+}
+
 bool UDPCom::resolve_socket(bool source, int s, std::string* target_host, std::string* target_port, sockaddr_storage* target_storage) {
     
-    auto lc_ = std::scoped_lock(datagram_com()->lock);
-    
-    auto it_record = datagram_com()->datagrams_received.find((unsigned int)s);
-    if(it_record != datagram_com()->datagrams_received.end()) {
-        auto record = it_record->second;
-        
+    auto record = datagram_com()->datagrams_received.find((unsigned int)s);
+    if(record) {
         char b[64]; memset(b,0,64);
         
         _deb("UDPCom::resolve_socket: found in datagrams");
@@ -915,16 +1105,14 @@ std::optional<std::string> UDPCom::ConnectionsCache::gen_cache_key(int fd) {
 int UDPCom::remove_datagram_entry(int fd) {
     std::size_t count = 0;
 
-    auto lc_ = std::scoped_lock(datagram_com()->lock);
-
     auto& db = datagram_com()->datagrams_received;
     auto key = (unsigned int)fd;
     _deb("UDPCom::remove_datagram_entry[%d]: socket mapped to %d", fd, key);
 
-    auto it_record = db.find(key);
+    // reuse flag check and erase must be atomic
+    auto lc_ = std::scoped_lock(db.shard_lock(key));
 
-    if(it_record != db.end()) {
-        auto it = db[key];
+    if(auto it = db.find(key); it) {
 
         if(not it->reuse) {
             if(it->socket_left.has_value() && it->socket_left.value() > 0) {
@@ -1012,6 +1200,9 @@ void UDPCom::shutdown(int _fd) {
 
     _dia("UDPCom::shutdown[%d]: request to shutdown socket", _fd);
 
+    // don't lose datagrams written just before close
+    flush_writes();
+
     if(_fd > 0) {
 
         size_t killed_from_cache = 0;
@@ -22,6 +22,9 @@
 #include <string>
 #include <array>
 #include <optional>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 #include <cstring>
 #include <ctime>
@@ -36,6 +39,7 @@
 
 
 #include <buffer.hpp>
+#include <openhashmap.hpp>
 #include <log/logger.hpp>
 #include <basecom.hpp>
 #include <baseproxy.hpp>
@@ -49,11 +53,102 @@
 //#define IPV6_RECVORIGDSTADDR    IPV6_ORIGDSTADDR
 
 
+// rest of UDP_GRO super-datagram received from real socket, handed out one segment per read
+struct gro_rest_t {
+    buffer data;
+    std::size_t offset = 0;
+    std::size_t segment = 0;
+
+    std::size_t bytes() const { return data.size() - offset; }
+    bool empty() const { return bytes() == 0; }
+
+    // copy out next segment (truncated to n), returns copied bytes
+    std::size_t take(void* buf, std::size_t n, bool peek) {
+        auto seg_len = std::min(segment, bytes());
+        auto cp = std::min(n, seg_len);
+        std::memcpy(buf, data.data() + offset, cp);
+
+        if(not peek) {
+            offset += seg_len;
+            if(empty()) {
+                data.clear();
+                offset = 0;
+            }
+        }
+        return cp;
+    }
+};
+
+// bounded FIFO of received datagrams. Slot buffers are kept after pop, so steady state
+// enqueue/dequeue reuses already allocated (pooled) memory.
+class packet_ring {
+public:
+    explicit packet_ring(std::size_t cap): slots_(std::max<std::size_t>(cap, 1)) {}
+
+    std::size_t capacity() const { return slots_.size(); }
+    std::size_t size() const { return count_; }
+    std::size_t bytes() const { return bytes_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == slots_.size(); }
+
+    // returns false (and nothing is stored) if ring is full
+    bool push(unsigned char const* data, std::size_t len) {
+        if(full()) return false;
+
+        auto& slot = slots_[(head_ + count_) % slots_.size()];
+        slot.clear();
+        slot.append(data, len);
+
+        ++count_;
+        bytes_ += len;
+        return true;
+    }
+
+    // copy front datagram (truncated to n) into buf, returns copied bytes. Unless peeking, copied
+    // bytes are removed and datagram is popped once fully read.
+    std::size_t consume(void* buf, std::size_t n, bool peek) {
+        if(empty()) return 0;
+
+        auto& slot = slots_[head_];
+        auto cp = std::min<std::size_t>(n, slot.size());
+        std::memcpy(buf, slot.data(), cp);
+
+        if(not peek) {
+            bytes_ -= cp;
+            if(cp >= slot.size()) {
+                slot.clear();
+                head_ = (head_ + 1) % slots_.size();
+                --count_;
+            }
+            else {
+                slot.flush(cp);
+            }
+        }
+        return cp;
+    }
+
+private:
+    std::vector<buffer> slots_;
+    std::size_t head_ = 0;
+    std::size_t count_ = 0;
+    std::size_t bytes_ = 0;
+};
+
 struct Datagram {
 
+    struct params_t {
+        // how many early datagrams can wait for its session to read them
+        static inline std::atomic<std::size_t> rx_queue_size = 32;
+    };
+
+    struct stats_t {
+        static inline std::atomic<std::size_t> rx_enqueued = 0;
+        static inline std::atomic<std::size_t> rx_dropped = 0;
+    };
+
     Datagram() = default;
 
-    Datagram(Datagram const& r): dst(r.dst), src(r.src), socket_left(r.socket_left), reuse(r.reuse), cx(r.cx), rx_queue(r.rx_queue) {}
+    Datagram(Datagram const& r): dst(r.dst), src(r.src), socket_left(r.socket_left), reuse(r.reuse), cx(r.cx), rx_queue(r.rx_queue), rx_dropped(r.rx_dropped), gro_rest(r.gro_rest), probed(r.probed) {}
 
     Datagram& operator=(Datagram const& r)  {
         assign(r);
@@ -68,6 +163,9 @@ struct Datagram {
         reuse = r.reuse;
         cx = r.cx;
         rx_queue = r.rx_queue;
+        rx_dropped = r.rx_dropped;
+        gro_rest = r.gro_rest;
+        probed = r.probed;
     }
 
     sockaddr_storage dst{};
@@ -82,20 +180,16 @@ struct Datagram {
 
 
     baseHostCX* cx = nullptr;
-    std::array<buffer,5> rx_queue;
+    packet_ring rx_queue { params_t::rx_queue_size };
+    std::size_t rx_dropped = 0;     // datagrams which didn't fit into rx_queue
+    gro_rest_t gro_rest;    // segments received coalesced from socket_left, protected by rx_queue_lock
+    bool probed = false;    // other flow's session key was probed past this one, erasing it leaves a tombstone.
+                            // Protected by table shard lock.
 
     mutable std::mutex rx_queue_lock;
 
     inline size_t queue_bytes() const {
-        size_t elem_bytes = 0;
-
-        for(auto const& r: rx_queue) {
-            if (!r.empty()) {
-                elem_bytes += r.size();
-            }
-        }
-
-        return elem_bytes;
+        return gro_rest.bytes() + rx_queue.bytes();
     }
 
     size_t queue_bytes_l() const {
@@ -111,14 +205,16 @@ struct Datagram {
         return (queue_bytes_l() == 0);
     }
 
+    // returns len if enqueued, 0 if queue is full and datagram was dropped
     inline size_t enqueue(unsigned char* data, size_t len) {
-        for(auto& elem: rx_queue) {
-            if(elem.empty()) {
-                elem.append(data, len);
-                return len;
-            }
+        if(not rx_queue.push(data, len)) {
+            ++rx_dropped;
+            ++stats_t::rx_dropped;
+            return 0;
         }
-        return 0;
+
+        ++stats_t::rx_enqueued;
+        return len;
     }
 
 
@@ -146,10 +242,85 @@ struct Datagram {
     
 };    
 
+// UDP sessions by their (virtual socket) key. Table is sharded, each shard has own lock and open addressing
+// map, so workers handling different sessions don't serialize on a single lock.
+class DatagramTable {
+public:
+    static constexpr unsigned int shard_bits = 5;
+    static constexpr std::size_t shard_count = 1U << shard_bits;
+    using value_type = std::shared_ptr<Datagram>;
+
+    // record for the key, nullptr if not found
+    value_type find(uint32_t key) const {
+        auto const& sh = shard(key);
+        auto l_ = std::scoped_lock(sh.lock);
+
+        auto const* v = sh.map.find(key);
+        return v ? *v : nullptr;
+    }
+
+    // key of an erased record other flows were probed past: no record, but probing must continue
+    bool tombstone(uint32_t key) const {
+        auto const& sh = shard(key);
+        auto l_ = std::scoped_lock(sh.lock);
+
+        auto const* v = sh.map.find(key);
+        return v and not *v;
+    }
+
+    void set(uint32_t key, value_type v) {
+        auto& sh = shard(key);
+        auto l_ = std::scoped_lock(sh.lock);
+
+        if(tombstone(key)) --sh.tombstones;
+        sh.map.insert_or_assign(key, std::move(v));
+    }
+
+    // erased probed record leaves a tombstone, so flows stored past it are still found
+    std::size_t erase(uint32_t key) {
+        auto& sh = shard(key);
+        auto l_ = std::scoped_lock(sh.lock);
+
+        auto* v = sh.map.find(key);
+        if(not v or not *v) return 0;
+
+        if((*v)->probed) {
+            v->reset();
+            ++sh.tombstones;
+            return 1;
+        }
+        return sh.map.erase(key);
+    }
+
+    std::size_t size() const {
+        std::size_t total = 0;
+        for(auto const& sh: shards_) {
+            auto l_ = std::scoped_lock(sh.lock);
+            total += sh.map.size() - sh.tombstones;
+        }
+        return total;
+    }
+
+    // lock guarding the key's shard: hold it to make find + modify sequences atomic
+    std::recursive_mutex& shard_lock(uint32_t key) const { return shard(key).lock; }
+
+private:
+    struct shard_t {
+        mutable std::recursive_mutex lock;
+        open_hash_map<uint32_t, value_type> map;
+        std::size_t tombstones = 0;
+    };
+    std::array<shard_t, shard_count> shards_;
+
+    // keys are hashes or small negative numbers, fibonacci hashing spreads both
+    static std::size_t shard_index(uint32_t key) { return (key * 0x9E3779B1U) >> (32 - shard_bits); }
+    shard_t& shard(uint32_t key) { return shards_[shard_index(key)]; }
+    shard_t const& shard(uint32_t key) const { return shards_[shard_index(key)]; }
+};
+
 class DatagramCom {
 public:
-    std::recursive_mutex lock;
-    std::map<uint64_t,std::shared_ptr<Datagram>> datagrams_received;
+    DatagramTable datagrams_received;
   
     // set with all virtual sockets which have data to read
     epoll::set_type in_virt_set;
@@ -162,6 +333,31 @@ class UDPCom : public virtual baseCom {
     mutable std::shared_ptr<DatagramCom> datagram_com_;
 
 public:
+    struct config_t {
+        // queue written datagrams and send them together by flush_writes() (called by proxy after write pass)
+        static inline std::atomic_bool tx_batch = false;
+        // flush immediately when this many datagrams are queued
+        static inline std::atomic<unsigned int> tx_batch_max = 32;
+        // send runs of equally sized datagrams as one UDP_SEGMENT (GSO) send, if kernel supports it
+        static inline std::atomic_bool tx_gso = true;
+
+        // enable UDP_GRO on connected sockets; coalesced datagrams are split back by read()
+        static inline std::atomic_bool rx_gro = false;
+    };
+
+    struct tx_stats_t {
+        static inline std::atomic<std::size_t> queued = 0;
+        static inline std::atomic<std::size_t> sendmmsg_calls = 0;
+        static inline std::atomic<std::size_t> gso_calls = 0;
+        static inline std::atomic<std::size_t> gso_fallbacks = 0;
+        static inline std::atomic<std::size_t> dropped = 0;
+    };
+
+    struct rx_stats_t {
+        static inline std::atomic<std::size_t> gro_reads = 0;
+        static inline std::atomic<std::size_t> gro_segments = 0;
+    };
+
     // if someone needs external access, create reference!
     static std::shared_ptr<DatagramCom> datagram_com_static();
     std::shared_ptr<DatagramCom> datagram_com() const;
@@ -183,11 +379,15 @@ public:
     ssize_t read(int _fd, void* _buf, size_t _n, int _flags) override;
     virtual int read_from_pool(int _fd, void* _buf, size_t _n, int _flags);
     virtual ssize_t recv(int _fd, void* _buf, size_t _n, int _flags) { return ::recv(_fd, _buf, _n, _flags); }
+    // recv() one datagram, splitting UDP_GRO super-datagram: first segment is returned, others are kept in rest
+    ssize_t recv_gro(int _fd, void* _buf, size_t _n, int _flags, gro_rest_t& rest);
     ssize_t peek(int _fd, void* _buf, size_t _n, int _flags) override { return read(_fd, _buf, _n, static_cast<uint8_t>(_flags) | MSG_PEEK );};
     
     
     ssize_t write(int _fd, const void* _buf, size_t _n, int _flags) override;
     virtual ssize_t write_to_pool(int _fd, const void* _buf, size_t _n, int _flags);
+    ssize_t flush_writes() override;
+    std::size_t tx_queued() const { return tx_queue_.size(); }
 
     int kill_socket(int fd);
     size_t kill_and_deref_from_connnect(std::string const& key);
@@ -222,6 +422,28 @@ protected:
     sockaddr_storage udpcom_addr {};
     socklen_t udpcom_addrlen {0};
 
+    // datagrams waiting for flush_writes(), payloads are stored back to back in tx_data_
+    struct tx_entry_t {
+        int fd;
+        bool addressed;     // send to udpcom_addr, otherwise socket is connected
+        std::size_t offset;
+        std::size_t len;
+    };
+    std::vector<tx_entry_t> tx_queue_;
+    buffer tx_data_;
+    std::vector<mmsghdr> tx_msgs_;
+    std::vector<iovec> tx_iov_;
+
+    // GRO segments not read yet from our own real socket
+    gro_rest_t gro_rest_;
+
+    // set when kernel refuses UDP_SEGMENT, GSO is not tried again
+    static inline std::atomic_bool tx_gso_unsupported_ = false;
+
+    ssize_t tx_enqueue(int fd, bool addressed, const void* _buf, size_t _n);
+    ssize_t tx_send_gso(std::size_t from, std::size_t to);
+    ssize_t tx_send_mmsg(std::size_t from, std::size_t to);
+
 public:
     // Connection socket pool
     //